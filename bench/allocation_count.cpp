@@ -0,0 +1,52 @@
+// bench/allocation_count.cpp
+//
+// See allocation_count.h. Kept out of json_bench.cpp: with the replacement
+// operator new inlined next to its callers, GCC pairs std::free in operator
+// delete with a new expression and warns -Wmismatched-new-delete.
+
+#include "allocation_count.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// atomic since the migration checks allocate from several threads
+static std::atomic<size_t> g_allocations{0};
+
+size_t allocationCount()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,13 @@
+// bench/allocation_count.h
+//
+// Allocation counting for bench-json: allocation_count.cpp replaces the global
+// operator new and delete of the program it is linked into.
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Number of global operator new calls so far, from every thread
+ */
+size_t allocationCount();
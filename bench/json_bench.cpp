@@ -0,0 +1,1098 @@
+// bench/json_bench.cpp
+//
+// Throughput of the serializer/ JSON code over locally generated corpora, and of
+// the binary encoding next to JSON for the same rows and models.
+// Built and run by `make bench-json`, see the makefile for BENCH_ARGS.
+//
+//   bench_json [--json] [--seconds S] [--corpus NAME]
+//
+// parse_legacy is the parser JSONNode::parse replaced (legacy_json.h), for the
+// corpora it can read. match_push evaluates a wildcard JSON pointer while push
+// parsing, building only the matches. index is stage one of parse_2stage alone
+// (buildStructuralIndex, the kernel in use is printed first).
+//
+// Prints a table by default, one JSON object per line with --json. Exits
+// non-zero if any parser fails the conformance cases, the number or UTF-8 fuzzing,
+// the JSON Pointer cases or a round trip check, or if a migration check fails
+// (migration_checks.h).
+
+#include "allocation_count.h"
+#include "binaryserializer.h"
+#include "jsonparser.h"
+#include "jsonpointer.h"
+#include "jsonstructural.h"
+#include "jsonstream.h"
+#include "jsonwriter.h"
+#include "legacy_json.h"
+#include "migration_checks.h"
+#include "ModelMacros.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <regex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+    struct Corpus
+    {
+        std::string name;
+        std::string text;
+        bool legacyReadable; ///< The pre-rewrite parser (legacy_json.h) can read it
+        const char *pointer; ///< Wildcard pointer evaluated by match_push
+    };
+
+    /* Corpus generators, deterministic so runs are comparable */
+
+    std::string randomWord(std::mt19937 &rng, size_t minLength, size_t maxLength)
+    {
+        static const char letters[] = "abcdefghijklmnopqrstuvwxyz";
+        std::string word(minLength + rng() % (maxLength - minLength + 1), ' ');
+        for (char &c : word)
+            c = letters[rng() % 26];
+        return word;
+    }
+
+    /// Result-set shaped: many objects with the same 40 keys
+    std::string wideObjects(std::mt19937 &rng)
+    {
+        std::string out;
+        JSONWriter writer(out);
+        writer.beginArray();
+        for (int row = 0; row < 4000; row++)
+        {
+            writer.beginObject();
+            for (int column = 0; column < 40; column++)
+            {
+                writer.key("column_" + std::to_string(column));
+                switch (column % 4)
+                {
+                case 0:
+                    writer.value(static_cast<int64_t>(rng() % 1000000));
+                    break;
+                case 1:
+                    writer.value(randomWord(rng, 4, 16));
+                    break;
+                case 2:
+                    writer.value(rng() % 2 == 0);
+                    break;
+                default:
+                    writer.value(nullptr);
+                }
+            }
+            writer.endObject();
+        }
+        writer.endArray();
+        return out;
+    }
+
+    /// Nested objects and arrays close to the parser's depth limit
+    std::string deepNesting(std::mt19937 &rng)
+    {
+        std::string out;
+        JSONWriter writer(out);
+        writer.beginArray();
+        for (int tree = 0; tree < 400; tree++)
+        {
+            int depth = 100 + rng() % 400;
+            for (int level = 0; level < depth; level++)
+            {
+                if (level % 2)
+                {
+                    writer.beginArray();
+                    writer.value(static_cast<int64_t>(level));
+                }
+                else
+                {
+                    writer.beginObject();
+                    writer.key("id").value(static_cast<int64_t>(level));
+                    writer.key("child");
+                }
+            }
+            writer.value(nullptr);
+            for (int level = depth - 1; level >= 0; level--)
+            {
+                if (level % 2)
+                    writer.endArray();
+                else
+                    writer.endObject();
+            }
+        }
+        writer.endArray();
+        return out;
+    }
+
+    /// Integers, doubles, exponents and extremes
+    std::string numberArrays(std::mt19937 &rng)
+    {
+        std::string out;
+        JSONWriter writer(out);
+        std::uniform_real_distribution<double> real(-1e6, 1e6);
+        writer.beginArray();
+        for (int row = 0; row < 1000; row++)
+        {
+            writer.beginArray();
+            for (int i = 0; i < 200; i++)
+            {
+                switch (i % 5)
+                {
+                case 0:
+                    writer.value(static_cast<int64_t>(rng()) - (1ll << 31));
+                    break;
+                case 1:
+                    writer.value(real(rng));
+                    break;
+                case 2:
+                    writer.value(real(rng) * 1e-200);
+                    break;
+                case 3:
+                    // wraps past int64, multiply unsigned so that is defined
+                    writer.value(static_cast<int64_t>(static_cast<uint64_t>(rng()) * rng()));
+                    break;
+                default:
+                    writer.value(static_cast<double>(rng() % 1000) / 8);
+                }
+            }
+            writer.endArray();
+        }
+        writer.endArray();
+        return out;
+    }
+
+    /// Log lines with quotes, escapes, control characters and non-ASCII text
+    std::string stringLogs(std::mt19937 &rng)
+    {
+        static const char *fragments[] = {
+            "GET /api/users?id=42 HTTP/1.1", "path \"C:\\\\temp\\\\file.txt\"", "tab\tseparated\tvalues",
+            "line one\nline two", "caf\xC3\xA9 cr\xC3\xA8me br\xC3\xBBl\xC3\xA9" "e", "\xE2\x82\xAC 12,50",
+            "\xF0\x9F\x9A\x80 deployed", "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E", "bell\x07", "{\"nested\":\"json\"}"};
+        std::string out;
+        JSONWriter writer(out);
+        writer.beginArray();
+        for (int row = 0; row < 40000; row++)
+        {
+            std::string message;
+            for (int i = 0; i < 4; i++)
+            {
+                message += fragments[rng() % (sizeof(fragments) / sizeof(fragments[0]))];
+                message += ' ';
+            }
+            writer.beginObject();
+            writer.key("ts").value("2024-05-01T12:" + std::to_string(10 + rng() % 50) + ":00Z");
+            writer.key("level").value(rng() % 10 ? "info" : "error");
+            writer.key("message").value(message);
+            writer.endObject();
+        }
+        writer.endArray();
+        return out;
+    }
+
+    /// Migration history: schema JSON as written by MigrationManager
+    std::string schemaHistory(std::mt19937 &rng)
+    {
+        std::string out;
+        JSONWriter writer(out);
+        writer.beginArray();
+        for (int version = 0; version < 2000; version++)
+        {
+            writer.beginObject();
+            writer.key("fields").beginArray();
+            int fields = 4 + rng() % 20;
+            for (int f = 0; f < fields; f++)
+            {
+                writer.beginObject();
+                writer.key("name").value(f == 0 ? std::string("id") : randomWord(rng, 3, 12));
+                writer.key("type").value(static_cast<int64_t>(rng() % 7));
+                writer.key("primary_key").value(f == 0);
+                writer.key("auto_increment").value(f == 0);
+                writer.key("default_value").value(rng() % 4 ? "" : "CURRENT_TIMESTAMP");
+                writer.key("max_length").value(static_cast<int64_t>(rng() % 4 ? 0 : 255));
+                writer.key("nullable").value(rng() % 2 == 0);
+                writer.key("unique").value(rng() % 8 == 0);
+                writer.endObject();
+            }
+            writer.endArray();
+            writer.key("indexes").beginArray();
+            writer.beginObject();
+            writer.key("name").value("idx_" + randomWord(rng, 3, 10));
+            writer.key("columns").beginArray().value("id").value(randomWord(rng, 3, 12)).endArray();
+            writer.key("unique").value(false);
+            writer.endObject();
+            writer.endArray();
+            writer.endObject();
+        }
+        writer.endArray();
+        return out;
+    }
+
+    /// Result set as returned by fetchAllFromQuery: strings, SQL NULL as "NULL"
+    std::vector<std::map<std::string, std::string>> resultRows(std::mt19937 &rng)
+    {
+        std::vector<std::map<std::string, std::string>> rows(4000);
+        for (auto &row : rows)
+        {
+            for (int column = 0; column < 20; column++)
+            {
+                std::string value;
+                switch (column % 5)
+                {
+                case 0:
+                    value = std::to_string(rng() % 1000000);
+                    break;
+                case 1:
+                    value = randomWord(rng, 4, 16);
+                    break;
+                case 2:
+                    value = std::to_string(rng() % 100000 / 100.0);
+                    break;
+                case 3:
+                    value = "2024-05-01 12:" + std::to_string(10 + rng() % 50) + ":00";
+                    break;
+                default:
+                    value = rng() % 3 ? "NULL" : randomWord(rng, 1, 8);
+                }
+                row["column_" + std::to_string(column)] = value;
+            }
+        }
+        return rows;
+    }
+
+    JSON rowsToJSON(const std::vector<std::map<std::string, std::string>> &rows)
+    {
+        JSON array(JSONType::ARRAY);
+        for (const auto &row : rows)
+        {
+            JSON object(JSONType::OBJECT);
+            for (const auto &[column, value] : row)
+                object[column] = value == "NULL" ? JSON() : JSON(value);
+            array.appendArray(std::move(object));
+        }
+        return array;
+    }
+
+    BEGIN_MODEL_DEFINITION(BenchUser, "bench_users")
+    FIELD(id, INTEGER, .primary_key = true, .auto_increment = true)
+    FIELD(username, STRING, .nullable = false, .max_length = 50)
+    FIELD(score, DOUBLE)
+    FIELD(active, BOOLEAN)
+    FIELD(created_at, DATETIME)
+    FIELD(bio, TEXT)
+    END_MODEL_DEFINITION()
+
+    /// Users with every field kind, including values the compact encodings can't take
+    std::vector<BenchUser> benchUsers(std::mt19937 &rng)
+    {
+        std::vector<BenchUser> users(2000);
+        for (size_t i = 0; i < users.size(); i++)
+        {
+            BenchUser &user = users[i];
+            user.setFieldValue("id", i % 100 ? std::to_string(i) : "-9223372036854775808");
+            user.setFieldValue("username", randomWord(rng, 3, 20));
+            user.setFieldValue("score", i % 50 ? std::to_string(rng() % 10000 / 8.0) : "1e400");
+            user.setFieldValue("active", i % 3 ? "1" : "0");
+            user.setFieldValue("created_at", "2024-05-01 12:00:00");
+            if (i % 4)
+                user.setFieldValue("bio", "caf\xC3\xA9 \"" + randomWord(rng, 10, 60) + "\"\n");
+        }
+        return users;
+    }
+
+    /// The model's fields as one JSON object, the text equivalent of serializationTOBinary
+    std::string modelToJSON(const ORM::Model &model)
+    {
+        std::string out;
+        JSONWriter writer(out);
+        writer.beginObject();
+        for (const auto &field : model.getFields())
+            writer.key(field->getName()).value(model.getFieldValue(field->getName()));
+        writer.endObject();
+        return out;
+    }
+
+    /**
+     * decode(encode(x)) must give x back, and malformed input must throw rather
+     * than crash or allocate what the input claims.
+     */
+    bool checkBinary(const std::vector<std::map<std::string, std::string>> &rows, const std::vector<BenchUser> &users,
+                     std::string &error)
+    {
+        std::string encoded = encodeRowSet(rows);
+        if (decodeRowSet(encoded) != rows)
+        {
+            error = "decodeRowSet(encodeRowSet(rows)) differs";
+            return false;
+        }
+        for (const BenchUser &user : users)
+        {
+            BenchUser decoded;
+            deserializationFROMBinary(serializationTOBinary(user), decoded);
+            for (const auto &field : user.getFields())
+            {
+                if (decoded.getFieldValue(field->getName()) != user.getFieldValue(field->getName()))
+                {
+                    error = "model round trip differs in " + field->getName() + ": " + user.getFieldValue(field->getName());
+                    return false;
+                }
+            }
+        }
+
+        std::vector<std::map<std::string, std::string>> small(rows.begin(), rows.begin() + 3);
+        std::string sample = encodeRowSet(small);
+        std::string user = serializationTOBinary(users[1]);
+        for (size_t length = 0; length < sample.size() + user.size(); length++)
+        {
+            bool isRowSet = length < sample.size();
+            try
+            {
+                if (isRowSet)
+                    decodeRowSet(std::string_view(sample).substr(0, length));
+                else
+                {
+                    BenchUser decoded;
+                    deserializationFROMBinary(std::string_view(user).substr(0, length - sample.size()), decoded);
+                }
+                error = std::string("truncated ") + (isRowSet ? "result set" : "model") + " was accepted";
+                return false;
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+        }
+
+        // header claiming 2^40 rows over a few bytes
+        std::string huge;
+        BinaryWriter writer(huge);
+        writer.writeByte(BINARY_TAG_ROWSET);
+        writer.writeByte(BINARY_FORMAT_VERSION);
+        writer.writeVarint(1);
+        writer.writeString("id");
+        writer.writeVarint(uint64_t(1) << 40);
+        writer.writeRaw("\0\0\0");
+        try
+        {
+            decodeRowSet(huge);
+            error = "row count larger than the input was accepted";
+            return false;
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        return true;
+    }
+
+    /* Measurement */
+
+    struct Result
+    {
+        double megabytesPerSecond;
+        double allocationsPerDocument;
+        size_t iterations;
+    };
+
+    /// Runs op until at least seconds have passed, returns the best throughput
+    Result measure(const std::function<void()> &op, size_t bytes, double seconds)
+    {
+        op(); // warm up
+
+        Result result{0, 0, 0};
+        size_t allocations = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        do
+        {
+            size_t before = allocationCount();
+            auto t0 = std::chrono::steady_clock::now();
+            op();
+            double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            allocations += allocationCount() - before;
+            result.iterations++;
+            if (t > 0)
+                result.megabytesPerSecond = std::max(result.megabytesPerSecond, bytes / t / 1e6);
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < seconds);
+        result.allocationsPerDocument = static_cast<double>(allocations) / result.iterations;
+        return result;
+    }
+
+    /* Conformance: fixed inputs with known results, run through every parser */
+
+    struct ConformanceCase
+    {
+        std::string_view input;
+        const char *expected; ///< stringify() of the parsed value, nullptr if it must be rejected
+    };
+
+    const ConformanceCase conformanceCases[] = {
+        // escapes
+        {R"("\"\\\/\b\f\n\r\t")", R"("\"\\/\b\f\n\r\t")"},
+        {R"("\u0000\u001f")", R"("\u0000\u001f")"},
+        {R"({"a\nb":1})", R"({"a\nb":1})"},
+        {R"("\x")", nullptr},
+        {R"("\'")", nullptr},
+        {R"("\u12")", nullptr},
+        {R"("\u12g4")", nullptr},
+        {"\"\t\"", nullptr},
+        {"\"\x01\"", nullptr},
+        {R"("abc)", nullptr},
+        // unicode
+        {R"("\u00e9\u20ac")", "\"\xC3\xA9\xE2\x82\xAC\""},
+        {R"("\ud83d\ude00")", "\"\xF0\x9F\x98\x80\""},
+        {"\"\xF0\x9F\x98\x80 caf\xC3\xA9\"", "\"\xF0\x9F\x98\x80 caf\xC3\xA9\""},
+        {R"("\ud800")", nullptr},
+        {R"("\udc00")", nullptr},
+        {R"("\ud800A")", nullptr},
+        {"\"\xFF\"", nullptr},
+        {"\"\xC0\xAF\"", nullptr},         // overlong
+        {"\"\xED\xA0\x80\"", nullptr},     // encoded surrogate
+        {"\"\xF4\x90\x80\x80\"", nullptr}, // above U+10FFFF
+        {"\"\xE2\x82\"", nullptr},         // truncated sequence
+        // numbers
+        {"0", "0"},
+        {"-0", "-0"},
+        {"1.5", "1.5"},
+        {"-1.5e-3", "-0.0015"},
+        {"1E2", "100"},
+        {"1e+2", "100"},
+        {"100e-2", "1"},
+        {"0.1", "0.1"},
+        {"9007199254740993", "9007199254740993"},
+        {"9223372036854775807", "9223372036854775807"},
+        {"-9223372036854775808", "-9223372036854775808"},
+        {"123456789012345678901234567890", "1.2345678901234568e+29"},
+        {"1.7976931348623157e308", "1.7976931348623157e+308"},
+        {"2.2250738585072014e-308", "2.2250738585072014e-308"},
+        {"5e-324", "5e-324"},
+        {"1e-400", "0"},
+        {"1e400", "null"}, // out of double range, written as null like any non-finite number
+        {"01", nullptr},
+        {"-01", nullptr},
+        {"1.", nullptr},
+        {".5", nullptr},
+        {"+1", nullptr},
+        {"1e", nullptr},
+        {"1e+", nullptr},
+        {"-", nullptr},
+        {"0x10", nullptr},
+        {"NaN", nullptr},
+        {"-Infinity", nullptr},
+        {"1.0e1.0", nullptr},
+        // structure
+        {"[[[]]]", "[[[]]]"},
+        {" \t\n\r{ \"a\" : [ 1 , 2 ] } ", R"({"a":[1,2]})"},
+        {R"({"":0,"a":1,"a":2})", R"({"":0,"a":2})"},
+        {"[true,false,null]", "[true,false,null]"},
+        {"[1,]", nullptr},
+        {R"({"a":1,})", nullptr},
+        {"[1 2]", nullptr},
+        {"{1:2}", nullptr},
+        {R"({"a" 1})", nullptr},
+        {"tru", nullptr},
+        {"TRUE", nullptr},
+        {"[", nullptr},
+        {"]", nullptr},
+    };
+
+    /**
+     * Runs every conformance case through every parser, each case as the only
+     * element of an array so that scalars and trailing garbage reach all of them.
+     *
+     * @return Number of mismatches, each one is printed to stderr
+     */
+    int checkConformance()
+    {
+        using Parse = std::function<std::string(const std::string &)>;
+        const std::vector<std::pair<const char *, Parse>> parsers = {
+            {"single_pass", [](const std::string &text)
+             { return JSON::stringify(JSON::parse(text, JSONParseMode::SINGLE_PASS)); }},
+            {"two_stage", [](const std::string &text)
+             { return JSON::stringify(JSON::parse(text, JSONParseMode::TWO_STAGE)); }},
+            {"arena", [](const std::string &text)
+             {
+                 std::pmr::monotonic_buffer_resource arena;
+                 return JSON::stringify(JSON::parse(std::string_view(text), &arena));
+             }},
+            {"lazy", [](const std::string &text)
+             { return JSON::stringify(JSON::parseLazy(text)); }},
+            {"push", [](const std::string &text)
+             {
+                 // one byte at a time, every escape and number gets split
+                 std::string out = "[";
+                 JSONPushParser parser([&](JSONNode &&element)
+                                       {
+                                           if (out.size() > 1)
+                                               out += ',';
+                                           out += JSON::stringify(element); });
+                 for (char c : text)
+                     parser.feed(std::string_view(&c, 1));
+                 parser.finish();
+                 return out + "]";
+             }},
+        };
+
+        int mismatches = 0;
+        for (const ConformanceCase &test : conformanceCases)
+        {
+            std::string document = "[" + std::string(test.input) + "]";
+            std::string expected = test.expected ? "[" + std::string(test.expected) + "]" : "an error";
+            for (const auto &[name, parse] : parsers)
+            {
+                std::string got;
+                try
+                {
+                    got = parse(document);
+                }
+                catch (const std::runtime_error &)
+                {
+                    got = "an error";
+                }
+                if (got != expected)
+                {
+                    std::cerr << "conformance: " << name << " parsed " << document << " to " << got
+                              << ", expected " << expected << std::endl;
+                    mismatches++;
+                }
+            }
+        }
+        return mismatches;
+    }
+
+    /**
+     * Number fuzzing, deterministic: doubles from random bit patterns and random
+     * int64s must come back exactly after stringify/parse, and random strings of
+     * number characters must be accepted exactly when they match the JSON number
+     * grammar, with the value strtod/strtoll give.
+     */
+    bool checkNumbers(std::string &error)
+    {
+        std::mt19937_64 rng(20240502);
+        for (int i = 0; i < 200000; i++)
+        {
+            uint64_t bits = rng();
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            if (!std::isfinite(value))
+                continue;
+            std::string text = JSON::stringify(JSON(value));
+            double back = JSON::parse("[" + text + "]")[0].get<double>();
+            if (std::memcmp(&back, &value, sizeof(value)) != 0)
+            {
+                error = "double " + text + " did not round trip";
+                return false;
+            }
+
+            int64_t integer = static_cast<int64_t>(rng());
+            text = JSON::stringify(JSON(integer));
+            const JSON parsed = JSON::parse("[" + text + "]");
+            if (text != std::to_string(integer) || !parsed[0].isInteger() || parsed[0].get<int64_t>() != integer)
+            {
+                error = "integer " + std::to_string(integer) + " came back as " + text;
+                return false;
+            }
+        }
+
+        static const std::regex grammar("-?(0|[1-9][0-9]*)(\\.[0-9]+)?([eE][+-]?[0-9]+)?");
+        static const char alphabet[] = "0123456789000111999-+.eE";
+        for (int i = 0; i < 100000; i++)
+        {
+            std::string text(1 + rng() % 30, ' ');
+            for (char &c : text)
+                c = alphabet[rng() % (sizeof(alphabet) - 1)];
+            bool valid = std::regex_match(text, grammar);
+            for (JSONParseMode mode : {JSONParseMode::SINGLE_PASS, JSONParseMode::TWO_STAGE})
+            {
+                std::optional<JSON> parsed;
+                try
+                {
+                    parsed = JSON::parse("[" + text + "]", mode)[0];
+                }
+                catch (const std::runtime_error &)
+                {
+                }
+                if (parsed.has_value() != valid)
+                {
+                    error = text + (valid ? " was rejected" : " was accepted");
+                    return false;
+                }
+                if (!valid)
+                    continue;
+
+                bool same;
+                if (parsed->isInteger())
+                {
+                    errno = 0;
+                    long long expected = std::strtoll(text.c_str(), nullptr, 10);
+                    same = text.find_first_of(".eE") == std::string::npos && errno == 0 &&
+                           parsed->get<int64_t>() == expected;
+                }
+                else
+                {
+                    double expected = std::strtod(text.c_str(), nullptr), got = parsed->get<double>();
+                    same = std::memcmp(&expected, &got, sizeof(got)) == 0 || (std::isinf(expected) && std::isinf(got));
+                }
+                if (!same)
+                {
+                    error = text + " parsed to " + JSON::stringify(*parsed);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * UTF-8 fuzzing, deterministic: strings of valid, truncated and random
+     * multibyte sequences at random offsets (so they straddle the 16, 32 and 64
+     * byte chunks of the structural index) must be refused by stage one exactly
+     * when the sequence by sequence check (utf8SequenceLength) refuses them, at
+     * the same offset.
+     */
+    bool checkUTF8(std::string &error)
+    {
+        static const char *const pieces[] = {"a", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xEF\xBF\xBF", "\xF4\x8F\xBF\xBF",
+                                             "\xE2\x82", "\xF0\x9F", "\xC3", "\x80", "\xED\xA0\x80", "\xE0\x80\x80", "\xF4\x90\x80\x80",
+                                             "\xC1\xBF", "\xFF"};
+        const size_t validPieces = 6; // the first ones, the others are invalid on their own
+        std::mt19937 rng(20240503);
+        std::vector<uint32_t> index;
+        for (int i = 0; i < 200000; i++)
+        {
+            std::string text = "\"" + std::string(rng() % 130, ' ');
+            size_t count = 1 + rng() % 40;
+            for (size_t j = 0; j < count; j++)
+            {
+                // mostly valid, so errors turn up late in the string too
+                size_t piece = rng() % 8 ? rng() % validPieces : rng() % (sizeof(pieces) / sizeof(pieces[0]));
+                text += rng() % 4 ? pieces[piece] : std::string(rng() % 70, 'x');
+            }
+            text += "\"";
+
+            std::string expected;
+            for (const char *p = text.data(), *end = p + text.size(); p < end;)
+            {
+                size_t length = utf8SequenceLength(p, end);
+                if (!length)
+                {
+                    expected = "at offset " + std::to_string(p - text.data()) + ":";
+                    break;
+                }
+                p += length;
+            }
+
+            std::string got;
+            try
+            {
+                buildStructuralIndex(text.data(), text.size(), index);
+            }
+            catch (const std::runtime_error &e)
+            {
+                got = e.what();
+                got = got.substr(got.find("at offset "));
+                got = got.substr(0, got.find(':') + 1);
+            }
+            if (got != expected)
+            {
+                error = "string of " + std::to_string(text.size()) + " bytes refused " + (expected.empty() ? "nowhere" : expected) +
+                        " by the scalar check, " + (got.empty() ? "nowhere" : got) + " by the " + structuralIndexKernel() + " kernel";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Values pointer matches while text is pushed through a JSONPathMatcher, stringified
+    std::vector<std::string> streamMatches(const std::string &text, const char *pointer)
+    {
+        std::vector<std::string> found;
+        JSONPathMatcher matcher;
+        matcher.add(JSONPointer(pointer), [&](JSONNode &&value)
+                    { found.push_back(JSON::stringify(value)); });
+        JSONPushParser parser(matcher);
+        for (size_t pos = 0; pos < text.size(); pos += 4096)
+            parser.feed(std::string_view(text).substr(pos, 4096));
+        parser.finish();
+        return found;
+    }
+
+    /// Values pointer matches in the tree, stringified
+    std::vector<std::string> treeMatches(const JSON &root, const char *pointer)
+    {
+        std::vector<std::string> found;
+        for (const JSONNode *node : JSONPointer(pointer).findAll(root))
+            found.push_back(JSON::stringify(*node));
+        return found;
+    }
+
+    /**
+     * JSON Pointer: the RFC 6901 examples, misses and invalid pointers, and
+     * wildcards, evaluated on a parsed tree, a lazy tree and the push parser.
+     */
+    bool checkPointers(std::string &error)
+    {
+        // RFC 6901 section 5
+        const std::string rfcText = R"({"foo":["bar","baz"],"":0,"a/b":1,"c%d":2,"e^f":3,"g|h":4,"i\\j":5,"k\"l":6," ":7,"m~n":8})";
+        const std::pair<const char *, const char *> rfcCases[] = {
+            {"", nullptr}, // the whole document
+            {"/foo", R"(["bar","baz"])"},
+            {"/foo/0", R"("bar")"},
+            {"/", "0"},
+            {"/a~1b", "1"},
+            {"/c%d", "2"},
+            {"/e^f", "3"},
+            {"/g|h", "4"},
+            {"/i\\j", "5"},
+            {"/k\"l", "6"},
+            {"/ ", "7"},
+            {"/m~0n", "8"},
+        };
+        const JSON rfc = JSON::parse(rfcText);
+        const std::string canonical = JSON::stringify(rfc);
+        const JSON lazy = JSON::parseLazy(rfcText);
+        for (const auto &[pointer, expected] : rfcCases)
+        {
+            std::string want = expected ? expected : canonical;
+            const JSONNode *found = JSONPointer(pointer).find(rfc);
+            const JSONNode *foundLazy = JSONPointer(pointer).find(lazy);
+            std::vector<std::string> streamed = streamMatches(rfcText, pointer);
+            if (!found || JSON::stringify(*found) != want || !foundLazy || JSON::stringify(*foundLazy) != want ||
+                streamed != std::vector<std::string>{want})
+            {
+                error = std::string("\"") + pointer + "\" doesn't give " + want;
+                return false;
+            }
+        }
+
+        for (const char *pointer : {"/foo/2", "/foo/-", "/foo/01", "/foo/0/x", "/missing", "/m~1n", "/a~1b/0"})
+        {
+            if (JSONPointer(pointer).find(rfc) || !streamMatches(rfcText, pointer).empty())
+            {
+                error = std::string("\"") + pointer + "\" matched";
+                return false;
+            }
+        }
+        if (JSON::stringify(rfc) != canonical)
+        {
+            error = "evaluating pointers changed the document";
+            return false;
+        }
+
+        for (const char *pointer : {"foo", "/~2", "/foo~", "/~"})
+        {
+            try
+            {
+                JSONPointer compiled(pointer);
+                error = std::string("\"") + pointer + "\" compiled";
+                return false;
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+        }
+
+        const std::string rowsText = R"({"rows":[{"email":"a"},{"name":"x"},{"email":"b","*":1}],"*":{"email":"c"}})";
+        const std::pair<const char *, std::vector<std::string>> wildcardCases[] = {
+            {"/rows/*/email", {R"("a")", R"("b")"}},
+            {"/*/email", {R"("c")"}},
+            {"/*/*/email", {R"("a")", R"("b")"}},
+            {"/rows/2/*", {R"("b")", "1"}},
+            {"/rows/*/missing", {}},
+        };
+        const JSON rows = JSON::parse(rowsText);
+        for (const auto &[pointer, expected] : wildcardCases)
+        {
+            if (treeMatches(rows, pointer) != expected || treeMatches(JSON::parseLazy(rowsText), pointer) != expected ||
+                streamMatches(rowsText, pointer) != expected)
+            {
+                error = std::string("\"") + pointer + "\" doesn't match as expected";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Every corpus has to come out of every parser the same, otherwise the
+     * numbers below are meaningless.
+     */
+    bool checkRoundTrip(const Corpus &corpus, std::string &error)
+    {
+        std::string canonical = JSON::stringify(JSON::parse(corpus.text));
+        if (JSON::stringify(JSON::parse(canonical)) != canonical)
+        {
+            error = "stringify(parse(x)) is not stable";
+            return false;
+        }
+        if (JSON::stringify(JSON::parse(corpus.text, JSONParseMode::SINGLE_PASS)) != canonical ||
+            JSON::stringify(JSON::parse(corpus.text, JSONParseMode::TWO_STAGE)) != canonical)
+        {
+            error = "single pass and two stage parsers disagree";
+            return false;
+        }
+        std::pmr::monotonic_buffer_resource arena;
+        if (JSON::stringify(JSON::parse(std::string_view(corpus.text), &arena)) != canonical)
+        {
+            error = "arena parse differs";
+            return false;
+        }
+        if (JSON::stringify(JSON::parseLazy(corpus.text)) != canonical)
+        {
+            error = "lazy parse differs";
+            return false;
+        }
+
+        std::string pushed = "[";
+        JSONPushParser parser([&](JSONNode &&element)
+                              {
+                                  if (pushed.size() > 1)
+                                      pushed += ',';
+                                  pushed += JSON::stringify(element); });
+        for (size_t pos = 0; pos < corpus.text.size(); pos += 4096)
+            parser.feed(std::string_view(corpus.text).substr(pos, 4096));
+        parser.finish();
+        pushed += ']';
+        if (pushed != canonical)
+        {
+            error = "push parser differs";
+            return false;
+        }
+
+        if (streamMatches(corpus.text, corpus.pointer) != treeMatches(JSON::parse(corpus.text), corpus.pointer))
+        {
+            error = std::string("JSONPathMatcher and JSONPointer disagree on ") + corpus.pointer;
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool json = false;
+    double seconds = 0.5;
+    std::string only;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--json") == 0)
+            json = true;
+        else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--corpus") == 0 && i + 1 < argc)
+            only = argv[++i];
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--json] [--seconds S] [--corpus NAME]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::mt19937 rng(20240501);
+    std::vector<Corpus> corpora = {
+        {"wide_objects", wideObjects(rng), true, "/*/column_1"},
+        {"deep_nesting", deepNesting(rng), true, "/*/child/1/id"},
+        {"numbers", numberArrays(rng), true, "/*/3"}, // exponents come out as strings, same work
+        {"string_logs", stringLogs(rng), false, "/*/message"},
+        {"schema_json", schemaHistory(rng), true, "/*/fields/0/name"},
+    };
+
+    if (!json)
+    {
+        std::printf("structural index kernel: %s\n", structuralIndexKernel());
+        std::printf("%-14s %9s  %-14s %10s %14s\n", "corpus", "size KiB", "operation", "MB/s", "allocs/doc");
+    }
+
+    auto report = [json](const std::string &corpus, size_t size, const char *name, const Result &result)
+    {
+        if (json)
+        {
+            std::string line;
+            JSONWriter writer(line);
+            writer.beginObject();
+            writer.key("corpus").value(corpus);
+            writer.key("bytes").value(size);
+            writer.key("operation").value(name);
+            writer.key("mb_per_s").value(result.megabytesPerSecond);
+            writer.key("allocs_per_doc").value(result.allocationsPerDocument);
+            writer.key("iterations").value(result.iterations);
+            writer.endObject();
+            std::cout << line << '\n';
+        }
+        else
+        {
+            std::printf("%-14s %9zu  %-14s %10.1f %14.0f\n", corpus.c_str(), size / 1024,
+                        name, result.megabytesPerSecond, result.allocationsPerDocument);
+        }
+    };
+
+    int failures = checkConformance();
+    std::string checkError;
+    if (!checkNumbers(checkError))
+    {
+        std::cerr << "numbers: " << checkError << std::endl;
+        failures++;
+    }
+    if (!checkUTF8(checkError))
+    {
+        std::cerr << "utf8: " << checkError << std::endl;
+        failures++;
+    }
+    if (!checkPointers(checkError))
+    {
+        std::cerr << "pointers: " << checkError << std::endl;
+        failures++;
+    }
+    if (!checkMigrations(checkError))
+    {
+        std::cerr << "migrations: " << checkError << std::endl;
+        failures++;
+    }
+    for (const Corpus &corpus : corpora)
+    {
+        if (!only.empty() && corpus.name != only)
+            continue;
+
+        std::string error;
+        if (!checkRoundTrip(corpus, error))
+        {
+            std::cerr << corpus.name << ": " << error << std::endl;
+            failures++;
+            continue;
+        }
+
+        JSON parsed = JSON::parse(corpus.text);
+        std::string written = JSON::stringify(parsed);
+        std::vector<uint32_t> index;
+        std::vector<std::pair<const char *, std::function<void()>>> operations = {
+            {"parse", [&]
+             { JSON doc = JSON::parse(corpus.text); }},
+            {"parse_1pass", [&]
+             { JSON doc = JSON::parse(corpus.text, JSONParseMode::SINGLE_PASS); }},
+            {"parse_2stage", [&]
+             { JSON doc = JSON::parse(corpus.text, JSONParseMode::TWO_STAGE); }},
+            {"index", [&]
+             {
+                 // stage one of parse_2stage alone
+                 buildStructuralIndex(corpus.text.data(), corpus.text.size(), index);
+             }},
+            {"parse_arena", [&]
+             {
+                 std::pmr::monotonic_buffer_resource arena(corpus.text.size());
+                 JSON doc = JSON::parse(std::string_view(corpus.text), &arena);
+             }},
+            {"parse_push", [&]
+             {
+                 JSONPushParser parser([](JSONNode &&) {});
+                 parser.feed(corpus.text);
+                 parser.finish();
+             }},
+            {"stringify", [&]
+             { std::string out = JSON::stringify(parsed); }},
+            {"round_trip", [&]
+             { std::string out = JSON::stringify(JSON::parse(corpus.text)); }},
+            {"match_push", [&]
+             {
+                 // only the matches are built
+                 JSONPathMatcher matcher;
+                 matcher.add(JSONPointer(corpus.pointer), [](JSONNode &&) {});
+                 JSONPushParser parser(matcher);
+                 parser.feed(corpus.text);
+                 parser.finish();
+             }},
+        };
+        // the parser this one replaced, as the baseline for parse
+        if (corpus.legacyReadable && legacy::parse(corpus.text).size() == parsed.size())
+        {
+            operations.emplace_back("parse_legacy", [&]
+                                    { legacy::JSONNode doc = legacy::parse(corpus.text); });
+        }
+
+        for (const auto &[name, op] : operations)
+        {
+            // stringify throughput is measured on the output size
+            size_t bytes = std::strcmp(name, "stringify") == 0 ? written.size() : corpus.text.size();
+            report(corpus.name, corpus.text.size(), name, measure(op, bytes, seconds));
+        }
+    }
+
+    // binary encoding next to JSON for the same data, sizes are those of each encoding
+    if (only.empty() || only == "binary_rows" || only == "binary_models")
+    {
+        auto rows = resultRows(rng);
+        auto users = benchUsers(rng);
+        std::string error;
+        if (!checkBinary(rows, users, error))
+        {
+            std::cerr << "binary: " << error << std::endl;
+            failures++;
+        }
+        else
+        {
+            std::string binaryRows = encodeRowSet(rows);
+            JSON rowsJSON = rowsToJSON(rows);
+            std::string jsonRows = JSON::stringify(rowsJSON);
+
+            std::string binaryUsers;
+            std::vector<std::string> encodedUsers;
+            for (const BenchUser &user : users)
+                encodedUsers.push_back(serializationTOBinary(user));
+            for (const auto &user : encodedUsers)
+                binaryUsers += user;
+            std::string jsonUsers;
+            for (const BenchUser &user : users)
+                jsonUsers += modelToJSON(user);
+
+            std::vector<std::tuple<const char *, const char *, size_t, std::function<void()>>> operations = {
+                {"binary_rows", "encode", binaryRows.size(), [&]
+                 { std::string out = encodeRowSet(rows); }},
+                {"binary_rows", "decode", binaryRows.size(), [&]
+                 { auto decoded = decodeRowSet(binaryRows); }},
+                {"binary_rows", "cursor", binaryRows.size(), [&]
+                 {
+                     BinaryRowSetReader reader(binaryRows);
+                     std::vector<std::optional<std::string_view>> row;
+                     while (reader.next(row))
+                     {
+                     }
+                 }},
+                {"binary_rows", "json_stringify", jsonRows.size(), [&]
+                 { std::string out = JSON::stringify(rowsJSON); }},
+                {"binary_rows", "json_parse", jsonRows.size(), [&]
+                 { JSON doc = JSON::parse(jsonRows); }},
+                {"binary_models", "encode", binaryUsers.size(), [&]
+                 {
+                     for (const BenchUser &user : users)
+                         std::string out = serializationTOBinary(user);
+                 }},
+                {"binary_models", "decode", binaryUsers.size(), [&]
+                 {
+                     BenchUser decoded;
+                     for (const auto &user : encodedUsers)
+                         deserializationFROMBinary(user, decoded);
+                 }},
+                {"binary_models", "json_stringify", jsonUsers.size(), [&]
+                 {
+                     for (const BenchUser &user : users)
+                         std::string out = modelToJSON(user);
+                 }},
+            };
+            for (const auto &[corpus, name, bytes, op] : operations)
+            {
+                if (only.empty() || only == corpus)
+                    report(corpus, bytes, name, measure(op, bytes, seconds));
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+// bench/legacy_json.h
+//
+// The JSON parser as it was before the single pass rewrite (findBarcePairs +
+// substr scanning + stoi/stod), kept only as a baseline for bench-json. The
+// node keeps the old layout: every node carries an unordered_map and a vector,
+// arrays copy their elements in. Parsing code is unchanged apart from names.
+//
+// It doesn't handle escapes, whitespace other than ' ' / '\n', exponents or
+// brackets inside strings, so only run it on corpora without those.
+
+#pragma once
+
+#include <cctype>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace legacy
+{
+    class JSONNode
+    {
+    public:
+        enum class Type
+        {
+            NUMBER,
+            STRING,
+            BOOL,
+            NULLT,
+            OBJECT,
+            ARRAY
+        };
+
+        JSONNode() : d_type(Type::NULLT) {}
+        explicit JSONNode(Type type) : d_type(type) {}
+        explicit JSONNode(double value) : d_type(Type::NUMBER), d_number(value) {}
+        explicit JSONNode(int value) : d_type(Type::NUMBER), d_number(value) {}
+        explicit JSONNode(bool value) : d_type(Type::BOOL), d_bool(value) {}
+        explicit JSONNode(const std::string &value) : d_type(Type::STRING), d_string(value) {}
+
+        bool isNULL() const { return d_type == Type::NULLT; }
+
+        size_t size() const { return d_type == Type::ARRAY ? d_array.size() : d_data.size(); }
+
+        void appendArray(const JSONNode &node)
+        {
+            if (d_type != Type::ARRAY)
+                throw std::runtime_error("This operation is only available to array node");
+            d_array.push_back(node);
+        }
+
+        JSONNode &operator[](const std::string &key)
+        {
+            if (d_type != Type::OBJECT)
+                throw std::runtime_error("This operation is only available to object node");
+            return d_data[key];
+        }
+
+    private:
+        Type d_type;
+        std::unordered_map<std::string, JSONNode> d_data;
+        std::vector<JSONNode> d_array;
+        std::string d_string;
+        double d_number = 0;
+        bool d_bool = false;
+    };
+
+    inline JSONNode parseObject(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair);
+    inline JSONNode parseArray(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair);
+
+    inline void findBarcePairs(const std::string &s, std::unordered_map<int, int> &bracePairs)
+    {
+        std::vector<int> stack;
+        int n = s.length();
+        for (int i = 0; i < n; i++)
+        {
+            if (s[i] == '[' || s[i] == '{')
+            {
+                stack.push_back(i);
+            }
+            else if (s[i] == ']' || s[i] == '}')
+            {
+                bracePairs[stack.back()] = i;
+                stack.pop_back();
+            }
+        }
+    }
+
+    inline bool isWhiteSpace(char c)
+    {
+        return c == ' ' || c == '\n';
+    }
+
+    inline bool isDouble(const std::string &s)
+    {
+        if (s.empty())
+            return false;
+        size_t i = 0;
+        if (s[0] == '+' || s[0] == '-')
+            i++;
+
+        bool dotseen = 0;
+        while (i < s.length())
+        {
+            if (!std::isdigit(s[i]) && s[i] != '.')
+                return false;
+            if (s[i] == '.')
+            {
+                if (dotseen)
+                    return false;
+                dotseen = true;
+            }
+            i++;
+        }
+        return true;
+    }
+
+    inline bool isInteger(const std::string &s)
+    {
+        if (s.empty())
+            return false;
+        size_t i = 0;
+        if (s[0] == '+' || s[0] == '-')
+            i++;
+        while (i < s.length())
+        {
+            if (!std::isdigit(s[i]))
+                return false;
+            i++;
+        }
+        return true;
+    }
+
+    inline JSONNode getValue(const std::string &s)
+    {
+        int i = 0, j = s.length() - 1;
+
+        while (i <= j && isWhiteSpace(s[i]))
+            i++;
+        while (j >= i && isWhiteSpace(s[j]))
+            j--;
+
+        if (i > j)
+            return JSONNode();
+
+        std::string temp = s.substr(i, j - i + 1);
+        if (temp.empty())
+            return JSONNode();
+
+        if (temp[0] == '"')
+        {
+            if (temp.length() < 2 || temp.back() != '"')
+                return JSONNode();
+            return JSONNode(temp.substr(1, temp.length() - 2));
+        }
+
+        if (temp == "true")
+            return JSONNode(true);
+        if (temp == "false")
+            return JSONNode(false);
+        if (temp == "null")
+            return JSONNode();
+
+        if (isDouble(temp))
+        {
+            try
+            {
+                if (isInteger(temp))
+                {
+                    try
+                    {
+                        return JSONNode(std::stoi(temp));
+                    }
+                    catch (...)
+                    {
+                        return JSONNode(std::stod(temp));
+                    }
+                }
+                return JSONNode(std::stod(temp));
+            }
+            catch (...)
+            {
+                return JSONNode(temp);
+            }
+        }
+        return JSONNode(temp);
+    }
+
+    inline JSONNode parse(const std::string &s)
+    {
+        std::unordered_map<int, int> bracePairs;
+        findBarcePairs(s, bracePairs);
+
+        int i = 0;
+        while (isWhiteSpace(s[i]))
+            i++;
+
+        if (s[i] == '[')
+            return parseArray(s, i, bracePairs[i], bracePairs);
+        return parseObject(s, i, bracePairs[i], bracePairs);
+    }
+
+    inline JSONNode parseObject(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair)
+    {
+        int i = start;
+        JSONNode ans(JSONNode::Type::OBJECT);
+
+        while (i < end)
+        {
+            while (i < end && s[i] != '"')
+                i++;
+            if (i >= end)
+                break;
+            i++;
+
+            std::string key;
+            while (i < end && s[i] != '"')
+            {
+                key += s[i];
+                i++;
+            }
+            if (i >= end)
+                throw std::runtime_error("Unterminated key");
+            i++;
+
+            while (i < end && s[i] != ':')
+                i++;
+            if (i >= end)
+                throw std::runtime_error("Expected ':' after key");
+            i++;
+
+            while (i < end && isWhiteSpace(s[i]))
+                i++;
+            if (i >= end)
+                throw std::runtime_error("Expected value after ':'");
+
+            std::string value;
+            if (s[i] == '{')
+            {
+                ans[key] = parseObject(s, i, bracePair[i], bracePair);
+                i = bracePair[i] + 1;
+            }
+            else if (s[i] == '[')
+            {
+                ans[key] = parseArray(s, i, bracePair[i], bracePair);
+                i = bracePair[i] + 1;
+            }
+            else
+            {
+                while (i < end && s[i] != ',' && s[i] != '}')
+                {
+                    value += s[i];
+                    i++;
+                }
+                ans[key] = getValue(value);
+            }
+
+            if (i < end && s[i] == ',')
+                i++;
+        }
+        return ans;
+    }
+
+    inline JSONNode parseArray(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair)
+    {
+        int i = start + 1;
+        JSONNode ans(JSONNode::Type::ARRAY);
+
+        while (i < end)
+        {
+            while (i < end && isWhiteSpace(s[i]))
+                i++;
+            if (i >= end)
+                break;
+
+            if (s[i] == ',')
+            {
+                i++;
+                continue;
+            }
+
+            if (s[i] == '{' || s[i] == '[')
+            {
+                int closingIndex = bracePair[i];
+                if (s[i] == '{')
+                    ans.appendArray(parseObject(s, i, closingIndex, bracePair));
+                else
+                    ans.appendArray(parseArray(s, i, closingIndex, bracePair));
+                i = closingIndex + 1;
+            }
+            else
+            {
+                int valueStart = i;
+                while (i < end && s[i] != ',')
+                    i++;
+                std::string valueStr = s.substr(valueStart, i - valueStart);
+                JSONNode value = getValue(valueStr);
+                if (!value.isNULL())
+                    ans.appendArray(value);
+                i++;
+            }
+
+            while (i < end && isWhiteSpace(s[i]))
+                i++;
+        }
+        return ans;
+    }
+}
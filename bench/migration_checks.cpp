@@ -0,0 +1,923 @@
+// bench/migration_checks.cpp
+//
+// See migration_checks.h. Each check returns false with a message on the first
+// mismatch; statements are compared as the strings MigrationManager generates.
+
+#include "migration_checks.h"
+
+#include "DatabaseTypes.h"
+#include "MigrationManager.h"
+#include "ModelMacros.h"
+#include "SqlMigration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Rows = std::vector<std::map<std::string, std::string>>;
+
+    /**
+     * DatabaseAdapter over callbacks. Every statement is appended to statements,
+     * queries are answered by onQuery and raw statements succeed unless onRaw
+     * returns false, in which case lastError/lastErrorCode describe the failure.
+     */
+    class ScriptedAdapter : public ORM::DatabaseAdapter
+    {
+    public:
+        std::vector<std::string> statements;
+        std::function<Rows(const std::string &, const std::vector<std::string> &)> onQuery;
+        std::function<bool(const std::string &, const std::vector<std::string> &)> onRaw;
+        std::string lastError;
+        unsigned int lastErrorCode = 0;
+
+        bool connect(const std::string &, const std::string &, const std::string &, const std::string &) override { return true; }
+        bool createTable(const ORM::Model &model) override
+        {
+            statements.push_back(getCreateTableSTring(model));
+            return true;
+        }
+        std::string escapeString(const std::string &input) const override { return input; }
+        std::string getLastError() const override { return lastError; }
+        unsigned int getLastErrorCode() const override { return lastErrorCode; }
+        std::string getCreateTableSTring(const ORM::Model &model) override { return "CREATE TABLE " + model.getTableName(); }
+
+        Rows executeQuery(const std::string &query, const std::vector<std::string> &params) override
+        {
+            statements.push_back(query);
+            return onQuery ? onQuery(query, params) : Rows{};
+        }
+
+        bool executeRawQuery(const std::string &query, const std::vector<std::string> &params) override
+        {
+            statements.push_back(query);
+            return onRaw ? onRaw(query, params) : true;
+        }
+
+        bool insertRecord(const ORM::Model &) override { return true; }
+        void disconnect() override {}
+        std::unique_ptr<ORM::QueryBuilder> createQueryBuilder() override { return nullptr; }
+        Rows fetchAllFromQuery(const std::string &query) override { return executeQuery(query, {}); }
+    };
+
+    bool contains(const std::string &text, const std::string &part)
+    {
+        return text.find(part) != std::string::npos;
+    }
+
+    bool fail(std::string &error, const std::string &message)
+    {
+        error = message;
+        return false;
+    }
+
+    /* Schema diffs (MigrationManager::planSchemaChange / applyAlterPlan) */
+
+    BEGIN_MODEL_DEFINITION(CheckAccount, "check_accounts")
+    FIELD(id, INTEGER, .primary_key = true, .auto_increment = true)
+    FIELD(email, STRING, .unique = true, .max_length = 100)
+    FIELD(avatar, BLOB, .nullable = true)
+    END_MODEL_DEFINITION()
+
+    /// Schema JSON entry of a column, as MigrationManager records it
+    std::string fieldJSON(const std::string &name, ORM::FieldType type, bool primaryKey, bool autoIncrement, bool unique, int maxLength)
+    {
+        auto flag = [](bool value)
+        { return value ? "true" : "false"; };
+        return "{\"name\":\"" + name + "\",\"type\":" + std::to_string(static_cast<int>(type)) +
+               ",\"primary_key\":" + flag(primaryKey) + ",\"auto_increment\":" + flag(autoIncrement) +
+               ",\"default_value\":\"\",\"max_length\":" + std::to_string(maxLength) +
+               ",\"nullable\":false,\"unique\":" + flag(unique) + "}";
+    }
+
+    JSON schemaJSON(const std::vector<std::string> &fields)
+    {
+        std::string text = "{\"fields\":[";
+        for (size_t i = 0; i < fields.size(); i++)
+            text += (i ? "," : "") + fields[i];
+        return JSON::parse(text + "],\"indexes\":[]}");
+    }
+
+    bool checkAlterPlans(std::string &error)
+    {
+        using ORM::AlterAlgorithm;
+        using ORM::FieldType;
+        CheckAccount model;
+
+        // id lost AUTO_INCREMENT and its key, email its unique index, avatar is new
+        JSON oldSchema = schemaJSON({fieldJSON("id", FieldType::INTEGER, false, false, false, 0),
+                                     fieldJSON("email", FieldType::STRING, false, false, false, 100)});
+        ORM::AlterPlan plan = ORM::MigrationManager::planSchemaChange(model, oldSchema);
+
+        std::vector<std::string> expected = {
+            "ADD PRIMARY KEY (id)",
+            "MODIFY COLUMN id INTEGER NOT NULL AUTO_INCREMENT",
+            "ADD UNIQUE INDEX email (email)",
+            "ADD COLUMN avatar BLOB",
+        };
+        if (plan.clauses.size() != expected.size())
+            return fail(error, "plan has " + std::to_string(plan.clauses.size()) + " clauses: " + plan.statement(AlterAlgorithm::COPY));
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            if (plan.clauses[i].sql != expected[i])
+                return fail(error, "clause " + std::to_string(i) + " is \"" + plan.clauses[i].sql + "\", expected \"" + expected[i] + "\"");
+        }
+        if (plan.clauses[2].algorithm != AlterAlgorithm::INPLACE || plan.clauses[2].undoSql != "DROP INDEX email")
+            return fail(error, "unique index clause: " + plan.clauses[2].undoSql);
+        if (plan.algorithm() != AlterAlgorithm::COPY)
+            return fail(error, "adding a primary key and AUTO_INCREMENT doesn't need ALGORITHM=COPY");
+
+        // a new key column: MySQL syntax, key after the column attributes
+        JSON emptySchema = schemaJSON({});
+        ORM::AlterPlan create = ORM::MigrationManager::planSchemaChange(model, emptySchema);
+        if (create.clauses.empty() || create.clauses[0].sql != "ADD COLUMN id INTEGER NOT NULL AUTO_INCREMENT PRIMARY KEY")
+            return fail(error, "added key column: " + (create.clauses.empty() ? std::string() : create.clauses[0].sql));
+
+        // unchanged keys produce nothing
+        JSON sameSchema = schemaJSON({fieldJSON("id", FieldType::INTEGER, true, true, false, 0),
+                                      fieldJSON("email", FieldType::STRING, false, false, true, 100),
+                                      "{\"name\":\"avatar\",\"type\":" + std::to_string(static_cast<int>(FieldType::BLOB)) +
+                                          ",\"primary_key\":false,\"auto_increment\":false,\"default_value\":\"\","
+                                          "\"max_length\":0,\"nullable\":true,\"unique\":false}"});
+        if (!ORM::MigrationManager::planSchemaChange(model, sameSchema).empty())
+            return fail(error, "unchanged schema produced clauses");
+
+        // only "algorithm not supported" moves on to the next algorithm
+        ORM::AlterPlan addColumn;
+        addColumn.tableName = "check_accounts";
+        addColumn.clauses.push_back({"ADD COLUMN note TEXT", "DROP COLUMN note", AlterAlgorithm::INSTANT, ""});
+
+        ScriptedAdapter adapter;
+        adapter.onRaw = [&](const std::string &query, const std::vector<std::string> &)
+        {
+            if (!contains(query, "ALGORITHM=INSTANT"))
+                return true;
+            adapter.lastError = "ALGORITHM=INSTANT is not supported for this operation";
+            adapter.lastErrorCode = 1846;
+            return false;
+        };
+        std::vector<std::string> upSql, downSql;
+        ORM::MigrationManager::applyAlterPlan(adapter, addColumn, upSql, downSql);
+        if (upSql.size() != 1 || !contains(upSql[0], "ALGORITHM=INPLACE") || adapter.statements.size() != 2)
+            return fail(error, "unsupported INSTANT wasn't retried with INPLACE");
+
+        adapter.statements.clear();
+        upSql.clear();
+        adapter.onRaw = [&](const std::string &, const std::vector<std::string> &)
+        {
+            adapter.lastError = "Lock wait timeout exceeded";
+            adapter.lastErrorCode = 1205;
+            return false;
+        };
+        try
+        {
+            ORM::MigrationManager::applyAlterPlan(adapter, addColumn, upSql, downSql);
+            return fail(error, "a failed ALTER didn't throw");
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        if (adapter.statements.size() != 1)
+            return fail(error, "a lock wait timeout was retried with another algorithm");
+        return true;
+    }
+
+    /* Online schema changes recorded in migration files */
+
+    /**
+     * Answers the information_schema and checkpoint queries of an OnlineSchemaChange
+     * on an empty table with primary key id, which nothing has been done to yet.
+     */
+    void scriptEmptyTable(ScriptedAdapter &adapter)
+    {
+        auto checkpointed = std::make_shared<bool>(false);
+        adapter.onQuery = [checkpointed](const std::string &query, const std::vector<std::string> &) -> Rows
+        {
+            if (contains(query, "FROM online_schema_changes"))
+                return *checkpointed ? Rows{{{"alter_sql", ""}, {"state", "copied"}, {"copied_key", ""}, {"max_key", ""}, {"copied_chunks", "0"}}} : Rows{};
+            if (contains(query, "KEY_COLUMN_USAGE"))
+                return {{{"COLUMN_NAME", "id"}}};
+            if (contains(query, "information_schema.COLUMNS"))
+                return {{{"COLUMN_NAME", "id"}}, {{"COLUMN_NAME", "email"}}};
+            return {}; // no table statistics, no shadow table, no rows
+        };
+        adapter.onRaw = [checkpointed](const std::string &query, const std::vector<std::string> &)
+        {
+            if (contains(query, "INSERT INTO online_schema_changes"))
+                *checkpointed = true;
+            else if (contains(query, "DELETE FROM online_schema_changes"))
+                *checkpointed = false;
+            return true;
+        };
+    }
+
+    bool checkOnlineReplay(std::string &error)
+    {
+        using ORM::AlterAlgorithm;
+        ORM::AlterPlan plan;
+        plan.tableName = "check_accounts";
+        plan.clauses.push_back({"MODIFY COLUMN email VARCHAR(20) NOT NULL", "MODIFY COLUMN email VARCHAR(100) NOT NULL",
+                                AlterAlgorithm::COPY, "shrinking VARCHAR column email"});
+
+        ORM::OnlineSchemaChangeOptions options;
+        options.minRows = 0;
+        ORM::MigrationManager::enableOnlineSchemaChange(options);
+
+        ScriptedAdapter adapter;
+        scriptEmptyTable(adapter);
+        std::vector<std::string> upSql, downSql;
+        ORM::MigrationManager::applyAlterPlan(adapter, plan, upSql, downSql);
+
+        std::string alterSql;
+        if (upSql.size() != 1 || !ORM::SqlMigration::isOnlineStatement(upSql[0], alterSql) ||
+            alterSql != plan.statement(AlterAlgorithm::COPY) || downSql.size() != 1 ||
+            !ORM::SqlMigration::isOnlineStatement(downSql[0], alterSql))
+        {
+            ORM::MigrationManager::disableOnlineSchemaChange();
+            return fail(error, "online change recorded as \"" + (upSql.empty() ? std::string() : upSql[0]) + "\"");
+        }
+
+        // the marker survives the file, and the replay goes through a shadow table again
+        std::string path = (std::filesystem::temp_directory_path() / "migration_checks_online.sql").string();
+        ORM::SqlMigration::write(path, "check_online", upSql, downSql);
+        ORM::SqlMigration migration = ORM::SqlMigration::load(path);
+        std::filesystem::remove(path);
+        if (migration.getUpSql() != upSql || migration.getDownSql() != downSql)
+        {
+            ORM::MigrationManager::disableOnlineSchemaChange();
+            return fail(error, "online marker lost by the migration file");
+        }
+
+        ORM::MigrationManager::disableOnlineSchemaChange();
+        for (bool up : {true, false})
+        {
+            adapter.statements.clear();
+            scriptEmptyTable(adapter);
+            up ? migration.up(adapter) : migration.down(adapter);
+
+            bool shadow = false;
+            for (const std::string &statement : adapter.statements)
+            {
+                if (statement == "CREATE TABLE _check_accounts_new LIKE check_accounts")
+                    shadow = true;
+                if (statement.compare(0, 27, "ALTER TABLE check_accounts ") == 0)
+                    return fail(error, std::string(up ? "up" : "down") + " replayed as a blocking ALTER: " + statement);
+            }
+            if (!shadow)
+                return fail(error, std::string(up ? "up" : "down") + " wasn't replayed through a shadow table");
+        }
+        return true;
+    }
+
+    /* SQL migration files (SqlMigration) */
+
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    void writeFile(const std::string &path, const std::string &text)
+    {
+        std::ofstream(path, std::ios::binary) << text;
+    }
+
+    /// Whether SqlMigration::load throws with a message containing reason
+    bool refused(const std::string &path, const std::string &reason)
+    {
+        try
+        {
+            ORM::SqlMigration::load(path);
+        }
+        catch (const std::runtime_error &e)
+        {
+            return contains(e.what(), reason);
+        }
+        return false;
+    }
+
+    bool checkMigrationFiles(std::string &error)
+    {
+        std::string path = (std::filesystem::temp_directory_path() / "migration_checks_file.sql").string();
+        std::vector<std::string> upSql = {"ALTER TABLE users ADD COLUMN bio TEXT", "UPDATE users\nSET bio = ''"};
+        std::vector<std::string> downSql = {"ALTER TABLE users DROP COLUMN bio"};
+        ORM::SqlMigration::write(path, "20250101_120000_after_users", upSql, downSql);
+
+        ORM::SqlMigration migration = ORM::SqlMigration::load(path);
+        if (migration.getName() != "20250101_120000_after_users" || migration.getUpSql() != upSql || migration.getDownSql() != downSql)
+            return fail(error, "file doesn't load back what was written");
+
+        // any edit of the statements is caught by the checksum, whitespace included
+        std::string text = readFile(path);
+        const std::pair<std::string, std::string> edits[] = {
+            {"ADD COLUMN bio TEXT", "ADD COLUMN bio VARCHAR(10)"},
+            {"DROP COLUMN bio;", "DROP COLUMN bio; "},
+            {"-- down\n", "-- down\nDROP TABLE users;\n"},
+        };
+        for (const auto &[from, to] : edits)
+        {
+            std::string edited = text;
+            edited.replace(edited.find(from), from.size(), to);
+            writeFile(path, edited);
+            if (!refused(path, "checksum doesn't match"))
+                return fail(error, "edited file was loaded: " + to);
+        }
+
+        // so is a header that doesn't match the body's checksum any more
+        std::string header = text.substr(0, text.find("-- up"));
+        std::string checksum = header.substr(header.find("-- checksum: ") + 13, 40);
+        std::string edited = text;
+        edited.replace(edited.find(checksum), 40, std::string(40, '0'));
+        writeFile(path, edited);
+        bool wrongChecksum = refused(path, "checksum doesn't match");
+
+        writeFile(path, text.substr(text.find("-- up")));
+        bool noHeader = refused(path, "no migration/checksum header");
+        std::filesystem::remove(path);
+        if (!wrongChecksum)
+            return fail(error, "file with a wrong checksum was loaded");
+        if (!noHeader)
+            return fail(error, "file without header was loaded");
+        return true;
+    }
+
+    /* Backfill checkpoints */
+
+    /**
+     * Table check_backfill with primary keys 1..rows and the migration_backfills
+     * checkpoint, both transactional: data updates and checkpoint writes only
+     * count once committed. The data UPDATE of chunk failChunk and the checkpoint
+     * UPDATE of chunk failCheckpoint (counted over all runs, 1 based) fail.
+     */
+    struct BackfillTable
+    {
+        int rows = 10;
+        int failChunk = 0;
+        int failCheckpoint = 0;
+        std::map<std::string, std::string> checkpoint; ///< Committed migration_backfills row, empty if none
+        std::vector<int> updates;                      ///< Committed updates per key
+        int chunks = 0;                                ///< Data UPDATEs attempted
+        int checkpoints = 0;                           ///< Checkpoint UPDATEs attempted
+
+        std::map<std::string, std::string> pendingCheckpoint;
+        std::vector<int> pendingUpdates;
+        bool inTransaction = false;
+
+        /// Keys matching a KeyRangeChunks range
+        std::vector<int> keys(const std::vector<std::string> &params) const
+        {
+            int low = params.size() == 2 ? std::stoi(params[0]) : 0;
+            int high = std::stoi(params.back());
+            std::vector<int> matched;
+            for (int key = low + 1; key <= std::min(high, rows); key++)
+                matched.push_back(key);
+            return matched;
+        }
+
+        void script(ScriptedAdapter &adapter)
+        {
+            updates.resize(rows + 1);
+            adapter.onQuery = [this](const std::string &query, const std::vector<std::string> &params) -> Rows
+            {
+                if (contains(query, "FROM migration_backfills"))
+                    return checkpoint.empty() ? Rows{} : Rows{checkpoint};
+                if (contains(query, "KEY_COLUMN_USAGE"))
+                    return {{{"COLUMN_NAME", "id"}}};
+                if (contains(query, "AS max_key"))
+                    return {{{"max_key", std::to_string(rows)}}};
+                if (contains(query, "AS chunk_end"))
+                {
+                    size_t offset = std::stoul(query.substr(query.rfind(' ') + 1));
+                    std::vector<int> matched = keys(params);
+                    return offset < matched.size() ? Rows{{{"chunk_end", std::to_string(matched[offset])}}} : Rows{};
+                }
+                return {};
+            };
+            adapter.onRaw = [this, &adapter](const std::string &query, const std::vector<std::string> &params)
+            {
+                if (query == "START TRANSACTION")
+                {
+                    inTransaction = true;
+                    pendingCheckpoint = checkpoint;
+                    pendingUpdates = updates;
+                }
+                else if (query == "COMMIT" || query == "ROLLBACK")
+                {
+                    if (query == "COMMIT")
+                    {
+                        checkpoint = pendingCheckpoint;
+                        updates = pendingUpdates;
+                    }
+                    inTransaction = false;
+                }
+                else if (contains(query, "INSERT INTO migration_backfills"))
+                {
+                    checkpoint = {{"table_name", params[1]}, {"last_key", ""}, {"max_key", params[2]}, {"chunks", "0"}, {"is_done", params[3]}};
+                }
+                else if (contains(query, "UPDATE migration_backfills"))
+                {
+                    if (++checkpoints == failCheckpoint)
+                    {
+                        adapter.lastError = "Lock wait timeout exceeded";
+                        return false;
+                    }
+                    auto &row = inTransaction ? pendingCheckpoint : checkpoint;
+                    row["last_key"] = params[0];
+                    row["chunks"] = std::to_string(std::stoi(row["chunks"]) + 1);
+                    row["is_done"] = params[1];
+                }
+                else if (contains(query, "UPDATE check_backfill"))
+                {
+                    if (++chunks == failChunk)
+                    {
+                        adapter.lastError = "Deadlock found when trying to get lock";
+                        return false;
+                    }
+                    for (int key : keys(params))
+                        (inTransaction ? pendingUpdates : updates)[key]++;
+                }
+                return true;
+            };
+        }
+    };
+
+    bool checkBackfillResume(std::string &error)
+    {
+        ORM::BackfillOptions options;
+        options.batchSize = 3;
+        options.maxThreadsRunning = 0;
+
+        BackfillTable table;
+        table.failChunk = 3; // keys 7..9
+        ScriptedAdapter adapter;
+        table.script(adapter);
+        try
+        {
+            ORM::Backfill(adapter, "check_resume", options).update("check_backfill", "flag = 1");
+            return fail(error, "the failed chunk didn't stop the backfill");
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        if (table.checkpoint["chunks"] != "2" || table.checkpoint["last_key"] != "6" || table.checkpoint["is_done"] != "0")
+            return fail(error, "checkpoint after the failure is at key " + table.checkpoint["last_key"] + " after " + table.checkpoint["chunks"] + " chunks");
+
+        // the update of a chunk whose checkpoint failed is rolled back with it
+        table.failCheckpoint = 3; // keys 7..9 again
+        try
+        {
+            ORM::Backfill(adapter, "check_resume", options).update("check_backfill", "flag = 1");
+            return fail(error, "the failed checkpoint didn't stop the backfill");
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+
+        // a new run continues after the last committed chunk, every row is updated once
+        ORM::Backfill(adapter, "check_resume", options).update("check_backfill", "flag = 1");
+        for (int key = 1; key <= table.rows; key++)
+        {
+            if (table.updates[key] != 1)
+                return fail(error, "key " + std::to_string(key) + " was updated " + std::to_string(table.updates[key]) + " times");
+        }
+        if (table.checkpoint["is_done"] != "1" || table.checkpoint["chunks"] != "4")
+            return fail(error, "backfill didn't finish after " + table.checkpoint["chunks"] + " chunks");
+
+        // a finished job does nothing
+        int attempted = table.chunks;
+        ORM::Backfill(adapter, "check_resume", options).update("check_backfill", "flag = 1");
+        if (table.chunks != attempted)
+            return fail(error, "a finished backfill ran again");
+        return true;
+    }
+
+    /* Migration lock (MigrationLock) between instances */
+
+    /// GET_LOCK / RELEASE_LOCK of one server, shared by the connections of several instances
+    class LockServer
+    {
+    public:
+        void connect(ScriptedAdapter &adapter)
+        {
+            adapter.onQuery = [this, &adapter](const std::string &query, const std::vector<std::string> &params) -> Rows
+            {
+                if (contains(query, "GET_LOCK"))
+                    return {{{"acquired", getLock(&adapter, params[0], std::stoi(params[1]))}}};
+                if (contains(query, "RELEASE_LOCK"))
+                    return {{{"released", releaseLock(&adapter, params[0])}}};
+                return {};
+            };
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable released_;
+        std::map<std::string, const ScriptedAdapter *> owners_;
+
+        std::string getLock(const ScriptedAdapter *connection, const std::string &name, int seconds)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bool free = released_.wait_for(lock, std::chrono::seconds(seconds), [&]
+                                           { return !owners_.count(name) || owners_[name] == connection; });
+            if (!free)
+                return "0";
+            owners_[name] = connection;
+            return "1";
+        }
+
+        std::string releaseLock(const ScriptedAdapter *connection, const std::string &name)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto owner = owners_.find(name);
+            if (owner == owners_.end() || owner->second != connection)
+                return "0";
+            owners_.erase(owner);
+            released_.notify_all();
+            return "1";
+        }
+    };
+
+    bool checkLockContention(std::string &error)
+    {
+        LockServer server;
+
+        // instances starting together migrate one at a time, waiting inside GET_LOCK
+        const int instances = 8;
+        std::vector<ScriptedAdapter> adapters(instances);
+        std::atomic<int> inside{0}, mostInside{0}, migrated{0}, failures{0};
+        std::vector<std::thread> threads;
+        for (ScriptedAdapter &adapter : adapters)
+        {
+            server.connect(adapter);
+            threads.emplace_back([&]
+                                 {
+                try
+                {
+                    ORM::MigrationLock lock(adapter, std::chrono::seconds(30));
+                    int now = ++inside;
+                    int most = mostInside;
+                    while (now > most && !mostInside.compare_exchange_weak(most, now))
+                    {
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    migrated++;
+                    inside--;
+                }
+                catch (const std::exception &)
+                {
+                    failures++;
+                } });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        if (failures || migrated != instances)
+            return fail(error, std::to_string(failures) + " instances failed to take the lock");
+        if (mostInside != 1)
+            return fail(error, std::to_string(mostInside) + " instances held the lock at once");
+        for (const ScriptedAdapter &adapter : adapters)
+        {
+            // one try without waiting, then one blocking GET_LOCK, no polling
+            if (adapter.statements.size() > 3)
+                return fail(error, "an instance ran " + std::to_string(adapter.statements.size()) + " lock statements");
+        }
+
+        // the lock is released when the holder throws, and a waiter gives up after the timeout
+        ScriptedAdapter holder, waiter;
+        server.connect(holder);
+        server.connect(waiter);
+        try
+        {
+            ORM::MigrationLock lock(holder, std::chrono::seconds(1));
+            bool timedOut = false;
+            try
+            {
+                ORM::MigrationLock blocked(waiter, std::chrono::seconds(1));
+            }
+            catch (const std::runtime_error &e)
+            {
+                timedOut = contains(e.what(), "Timed out");
+            }
+            if (!timedOut)
+                return fail(error, "a second holder got the lock");
+            throw std::runtime_error("migration failed");
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        try
+        {
+            ORM::MigrationLock lock(waiter, std::chrono::seconds(0));
+        }
+        catch (const std::runtime_error &)
+        {
+            return fail(error, "the lock wasn't released by a failed migration");
+        }
+        return true;
+    }
+
+    /* Migration records (MigrationManager::migrateModel) */
+
+    BEGIN_MODEL_DEFINITION(CheckProfileV1, "check_profiles")
+    FIELD(id, INTEGER, .primary_key = true, .auto_increment = true)
+    FIELD(name, STRING, .max_length = 50)
+    END_MODEL_DEFINITION()
+
+    BEGIN_MODEL_DEFINITION(CheckProfileV2, "check_profiles")
+    FIELD(id, INTEGER, .primary_key = true, .auto_increment = true)
+    FIELD(name, STRING, .max_length = 50)
+    FIELD(bio, TEXT, .nullable = true)
+    END_MODEL_DEFINITION()
+
+    /// The migrations table of one model, with the lock always free; ALTERs fail while failAlter is set.
+    /// information_schema reports columns and indexes as the live table
+    class MigrationsTable
+    {
+    public:
+        struct Record
+        {
+            std::string version, hash, schema;
+            bool applied, current, pending;
+        };
+        std::vector<Record> records;
+        bool failAlter = false;
+        Rows columns, indexes;
+
+        void connect(ScriptedAdapter &adapter)
+        {
+            adapter.onQuery = [this](const std::string &query, const std::vector<std::string> &) -> Rows
+            {
+                if (contains(query, "GET_LOCK"))
+                    return {{{"acquired", "1"}}};
+                if (contains(query, "RELEASE_LOCK"))
+                    return {{{"released", "1"}}};
+                if (contains(query, "information_schema.COLUMNS"))
+                    return columns;
+                if (contains(query, "information_schema.STATISTICS"))
+                    return indexes;
+                Rows rows;
+                for (const Record &record : records)
+                {
+                    if (contains(query, "applied_at IS NULL") ? record.pending : contains(query, "is_current = 1") && record.current)
+                        rows.push_back({{"version", record.version}, {"schema_hash", record.hash}, {"schema_json", record.schema}});
+                }
+                return rows;
+            };
+            adapter.onRaw = [this, &adapter](const std::string &query, const std::vector<std::string> &params)
+            {
+                if (contains(query, "INSERT INTO migrations"))
+                {
+                    // values are quoted with ', which the schema JSON doesn't contain
+                    std::vector<std::string> values;
+                    size_t start = query.find("VALUES ('") + 9;
+                    for (size_t end; (end = query.find('\'', start)) != std::string::npos && values.size() < 4; start = query.find('\'', end + 1) + 1)
+                        values.push_back(query.substr(start, end - start));
+                    records.push_back({values[1], values[2], values[3], false, false, true});
+                }
+                else if (contains(query, "UPDATE migrations SET is_current = (version = ?)"))
+                {
+                    for (Record &record : records)
+                    {
+                        record.current = record.version == params[0];
+                        record.applied = record.applied || record.current;
+                        record.pending = record.pending && !record.current;
+                    }
+                }
+                else if (contains(query, "UPDATE migrations SET schema_hash = ?"))
+                {
+                    for (Record &record : records)
+                    {
+                        if (record.version == params[3])
+                        {
+                            record.hash = params[0];
+                            record.schema = params[1];
+                        }
+                    }
+                }
+                else if (contains(query, "DELETE FROM migrations"))
+                {
+                    records.erase(std::remove_if(records.begin(), records.end(), [&](const Record &record)
+                                                 { return record.pending && (params.size() < 2 || record.version == params[1]); }),
+                                  records.end());
+                }
+                else if (failAlter && contains(query, "ALTER TABLE check_profiles"))
+                {
+                    adapter.lastError = "Duplicate column name 'bio'";
+                    adapter.lastErrorCode = 1060;
+                    return false;
+                }
+                return true;
+            };
+        }
+
+        const Record *current() const
+        {
+            for (const Record &record : records)
+            {
+                if (record.current)
+                    return &record;
+            }
+            return nullptr;
+        }
+    };
+
+    /// Position of the first statement starting with prefix, statements.size() if none
+    size_t find(const std::vector<std::string> &statements, const std::string &prefix)
+    {
+        auto it = std::find_if(statements.begin(), statements.end(), [&](const std::string &statement)
+                               { return statement.compare(0, prefix.size(), prefix) == 0; });
+        return it - statements.begin();
+    }
+
+    bool checkMigrationRecords(std::string &error)
+    {
+        // migration files go to a scratch directory
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "migration_checks_records";
+        std::filesystem::path previous = std::filesystem::current_path();
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        std::filesystem::current_path(directory);
+        auto done = [&](bool passed)
+        {
+            std::filesystem::current_path(previous);
+            std::filesystem::remove_all(directory);
+            return passed;
+        };
+
+        MigrationsTable table;
+        ScriptedAdapter adapter;
+        table.connect(adapter);
+
+        // the record is written before the DDL, and only marked applied after it
+        ORM::MigrationManager::migrateModel(adapter, CheckProfileV1{});
+        size_t insert = find(adapter.statements, "INSERT INTO migrations");
+        size_t create = find(adapter.statements, "CREATE TABLE check_profiles");
+        size_t mark = find(adapter.statements, "UPDATE migrations SET is_current = (version = ?)");
+        if (!(insert < create && create < mark && mark < adapter.statements.size()))
+            return done(fail(error, "first migration wasn't recorded before its CREATE TABLE"));
+        if (!table.current() || table.current()->version != "001_intial" || table.current()->pending)
+            return done(fail(error, "first migration isn't the applied, current one"));
+
+        // a failed ALTER leaves no record behind, the previous version stays current
+        table.failAlter = true;
+        adapter.statements.clear();
+        bool threw = false;
+        try
+        {
+            ORM::MigrationManager::migrateModel(adapter, CheckProfileV2{});
+        }
+        catch (const std::runtime_error &)
+        {
+            threw = true;
+        }
+        table.failAlter = false;
+        if (!threw)
+            return done(fail(error, "a failed ALTER didn't fail the migration"));
+        if (find(adapter.statements, "INSERT INTO migrations") > find(adapter.statements, "ALTER TABLE check_profiles"))
+            return done(fail(error, "change wasn't recorded before its ALTER"));
+        if (table.records.size() != 1 || table.current()->version != "001_intial")
+            return done(fail(error, "a failed migration left " + std::to_string(table.records.size()) + " records"));
+
+        // a pending record left by a crash before its DDL is dropped, and versions never repeat
+        table.records.push_back({"interrupted", "", table.records[0].schema, false, false, true});
+        ORM::MigrationManager::migrateModel(adapter, CheckProfileV2{});
+        std::string first = table.current()->version;
+        ORM::MigrationManager::migrateModel(adapter, CheckProfileV1{});
+        std::string second = table.current()->version;
+        if (table.records.size() != 3)
+            return done(fail(error, "expected 3 records, found " + std::to_string(table.records.size())));
+        if (first == second || first.size() != std::string("20250101_120000_000").size() || first > second)
+            return done(fail(error, "versions " + first + " and " + second + " recorded back to back"));
+
+        // a hash change without any DDL (an older schema JSON format) refreshes the current record
+        table.records.back().hash = "stale";
+        size_t files = std::distance(std::filesystem::directory_iterator("migrations"), std::filesystem::directory_iterator());
+        adapter.statements.clear();
+        ORM::MigrationManager::migrateModel(adapter, CheckProfileV1{});
+        if (table.records.size() != 3 || find(adapter.statements, "INSERT INTO migrations") != adapter.statements.size())
+            return done(fail(error, "a hash change without DDL was recorded as a migration"));
+        if (std::distance(std::filesystem::directory_iterator("migrations"), std::filesystem::directory_iterator()) != static_cast<std::ptrdiff_t>(files))
+            return done(fail(error, "a hash change without DDL wrote a migration file"));
+        if (table.current()->version != second || table.current()->hash == "stale")
+            return done(fail(error, "current record wasn't refreshed"));
+
+        // a pending record whose DDL ran before the crash is applied as is, the ALTER isn't repeated
+        const MigrationsTable::Record recorded = table.records[1];
+        table.records.push_back({"altered", recorded.hash, recorded.schema, false, false, true});
+        table.columns = {{{"COLUMN_NAME", "id"}, {"DATA_TYPE", "int"}, {"CHARACTER_MAXIMUM_LENGTH", ""}, {"IS_NULLABLE", "NO"}},
+                         {{"COLUMN_NAME", "name"}, {"DATA_TYPE", "varchar"}, {"CHARACTER_MAXIMUM_LENGTH", "50"}, {"IS_NULLABLE", "NO"}},
+                         {{"COLUMN_NAME", "bio"}, {"DATA_TYPE", "text"}, {"CHARACTER_MAXIMUM_LENGTH", "65535"}, {"IS_NULLABLE", "YES"}}};
+        adapter.statements.clear();
+        ORM::MigrationManager::migrateModel(adapter, CheckProfileV2{});
+        if (find(adapter.statements, "ALTER TABLE check_profiles") != adapter.statements.size() ||
+            find(adapter.statements, "INSERT INTO migrations") != adapter.statements.size())
+            return done(fail(error, "an interrupted migration whose DDL ran was planned again"));
+        if (table.records.size() != 4 || table.current()->version != "altered" || table.current()->pending)
+            return done(fail(error, "an interrupted migration whose DDL ran wasn't recorded as applied"));
+
+        // while one whose table doesn't have its schema yet is planned again
+        table.records.push_back({"not_altered", table.records[0].hash, table.records[0].schema, false, false, true});
+        adapter.statements.clear();
+        ORM::MigrationManager::migrateModel(adapter, CheckProfileV1{});
+        if (table.records.size() != 5 || table.current()->version == "not_altered" ||
+            find(adapter.statements, "ALTER TABLE check_profiles DROP COLUMN bio") == adapter.statements.size())
+            return done(fail(error, "an interrupted migration whose DDL didn't run wasn't planned again"));
+        return done(true);
+    }
+
+    /// scriptEmptyTable, with information_schema reporting rows rows
+    void scriptLargeTable(ScriptedAdapter &adapter, const std::string &rows)
+    {
+        scriptEmptyTable(adapter);
+        auto answer = adapter.onQuery;
+        adapter.onQuery = [answer, rows](const std::string &query, const std::vector<std::string> &params) -> Rows
+        {
+            if (contains(query, "information_schema.TABLES"))
+                return {{{"TABLE_ROWS", rows}, {"DATA_LENGTH", "0"}, {"INDEX_LENGTH", "0"}}};
+            return answer(query, params);
+        };
+    }
+
+    bool checkReplayedCopies(std::string &error)
+    {
+        const std::string sql = "ALTER TABLE check_accounts MODIFY COLUMN email VARCHAR(20) NOT NULL, ALGORITHM=COPY";
+        ORM::MigrationCostOptions limits;
+        ScriptedAdapter adapter;
+
+        // refused as the dry run reports it, before any ALTER
+        scriptLargeTable(adapter, "5000000");
+        ORM::MigrationManager::enableRebuildLimits(limits);
+        bool refused = false;
+        try
+        {
+            ORM::MigrationManager::replayStatement(adapter, sql);
+        }
+        catch (const std::runtime_error &e)
+        {
+            refused = contains(e.what(), "Refusing");
+        }
+        ORM::MigrationManager::disableRebuildLimits();
+        if (!refused || !ORM::MigrationCostEstimator(adapter, limits).estimate(sql).refused)
+            return fail(error, "a large ALGORITHM=COPY replay wasn't refused");
+        for (const std::string &statement : adapter.statements)
+        {
+            if (statement.compare(0, 27, "ALTER TABLE check_accounts ") == 0)
+                return fail(error, "a refused replay ran " + statement);
+        }
+
+        // online once enabled, as the dry run reports it
+        ORM::OnlineSchemaChangeOptions options;
+        ORM::MigrationManager::enableOnlineSchemaChange(options);
+        adapter.statements.clear();
+        scriptLargeTable(adapter, "5000000");
+        ORM::MigrationManager::replayStatement(adapter, sql);
+        ORM::MigrationManager::disableOnlineSchemaChange();
+        if (ORM::MigrationCostEstimator(adapter, limits, &options).estimate(sql).algorithm != "ONLINE" ||
+            find(adapter.statements, "CREATE TABLE _check_accounts_new LIKE check_accounts") == adapter.statements.size())
+            return fail(error, "a large ALGORITHM=COPY replay didn't go through a shadow table");
+
+        // without an ALGORITHM the cheapest one is tried first
+        adapter.statements.clear();
+        scriptLargeTable(adapter, "10");
+        ORM::MigrationManager::replayStatement(adapter, "ALTER TABLE check_accounts DROP COLUMN avatar");
+        if (adapter.statements.back() != "ALTER TABLE check_accounts DROP COLUMN avatar, ALGORITHM=INSTANT")
+            return fail(error, "replayed as \"" + adapter.statements.back() + "\"");
+        return true;
+    }
+}
+
+bool checkMigrations(std::string &error)
+{
+    const std::pair<const char *, bool (*)(std::string &)> checks[] = {
+        {"alter plans", checkAlterPlans},
+        {"online replay", checkOnlineReplay},
+        {"migration files", checkMigrationFiles},
+        {"backfill resume", checkBackfillResume},
+        {"lock contention", checkLockContention},
+        {"migration records", checkMigrationRecords},
+        {"replayed copies", checkReplayedCopies},
+    };
+    for (const auto &[name, check] : checks)
+    {
+        if (!check(error))
+        {
+            error = std::string(name) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
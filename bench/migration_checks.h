@@ -0,0 +1,17 @@
+// bench/migration_checks.h
+//
+// Checks of the migration code run by bench-json next to the JSON checks. They
+// drive MigrationManager and friends through ScriptedAdapter, an in memory
+// DatabaseAdapter that records statements and answers queries from callbacks,
+// so no MySQL server is needed.
+
+#pragma once
+
+#include <string>
+
+/**
+ * @brief Runs every migration check
+ * @param error Receives the first failure
+ * @return false if a check failed
+ */
+bool checkMigrations(std::string &error);
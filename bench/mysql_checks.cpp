@@ -0,0 +1,198 @@
+// bench/mysql_checks.cpp
+//
+// Migration checks that need a real server, run by `make check-mysql`. Connects
+// with ORM_TEST_MYSQL_HOST / _USER / _PASSWORD / _DB (default localhost, root,
+// no password, orm_test). The database must be a scratch one: its migrations
+// and online_schema_changes tables are dropped. Migration files are written to
+// a temporary directory.
+//
+//   check_mysql
+//
+// Exits non-zero on the first failure.
+
+#include "MigrationManager.h"
+#include "ModelMacros.h"
+#include "MySQLAdapter.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Rows = std::vector<std::map<std::string, std::string>>;
+
+    /// Forwards to another adapter, recording every statement
+    class RecordingAdapter : public ORM::DatabaseAdapter
+    {
+    public:
+        explicit RecordingAdapter(ORM::DatabaseAdapter &adapter) : adapter_(adapter) {}
+
+        std::vector<std::string> statements;
+
+        bool connect(const std::string &host, const std::string &user, const std::string &password, const std::string &dbname) override
+        {
+            return adapter_.connect(host, user, password, dbname);
+        }
+        bool createTable(const ORM::Model &model) override
+        {
+            statements.push_back(adapter_.getCreateTableSTring(model));
+            return adapter_.createTable(model);
+        }
+        std::string escapeString(const std::string &input) const override { return adapter_.escapeString(input); }
+        std::string getLastError() const override { return adapter_.getLastError(); }
+        unsigned int getLastErrorCode() const override { return adapter_.getLastErrorCode(); }
+        std::string getCreateTableSTring(const ORM::Model &model) override { return adapter_.getCreateTableSTring(model); }
+        Rows executeQuery(const std::string &query, const std::vector<std::string> &params) override
+        {
+            statements.push_back(query);
+            return adapter_.executeQuery(query, params);
+        }
+        bool executeRawQuery(const std::string &query, const std::vector<std::string> &params) override
+        {
+            statements.push_back(query);
+            return adapter_.executeRawQuery(query, params);
+        }
+        bool insertRecord(const ORM::Model &model) override { return adapter_.insertRecord(model); }
+        void disconnect() override { adapter_.disconnect(); }
+        std::unique_ptr<ORM::QueryBuilder> createQueryBuilder() override { return adapter_.createQueryBuilder(); }
+        Rows fetchAllFromQuery(const std::string &query) override
+        {
+            statements.push_back(query);
+            return adapter_.fetchAllFromQuery(query);
+        }
+
+    private:
+        ORM::DatabaseAdapter &adapter_;
+    };
+
+    std::string env(const char *name, const char *fallback)
+    {
+        const char *value = std::getenv(name);
+        return value ? value : fallback;
+    }
+
+    void expect(bool condition, const std::string &message)
+    {
+        if (!condition)
+            throw std::runtime_error(message);
+    }
+
+    void execute(ORM::DatabaseAdapter &adapter, const std::string &sql, const std::vector<std::string> &params = {})
+    {
+        expect(adapter.executeRawQuery(sql, params), sql + ": " + adapter.getLastError());
+    }
+
+    std::string scalar(ORM::DatabaseAdapter &adapter, const std::string &sql, const std::vector<std::string> &params = {})
+    {
+        Rows rows = adapter.executeQuery(sql, params);
+        expect(!rows.empty() && !rows[0].empty(), "no result: " + sql);
+        return rows[0].begin()->second;
+    }
+
+    /* Two versions of one table, the second shrinks a VARCHAR (ALGORITHM=COPY) */
+
+    BEGIN_MODEL_DEFINITION(CheckOscV1, "check_osc")
+    FIELD(id, INTEGER, .primary_key = true, .auto_increment = true)
+    FIELD(email, STRING, .max_length = 100)
+    END_MODEL_DEFINITION()
+
+    BEGIN_MODEL_DEFINITION(CheckOscV2, "check_osc")
+    FIELD(id, INTEGER, .primary_key = true, .auto_increment = true)
+    FIELD(email, STRING, .max_length = 20)
+    END_MODEL_DEFINITION()
+
+    std::string emailLength(ORM::DatabaseAdapter &adapter)
+    {
+        return scalar(adapter, "SELECT CHARACTER_MAXIMUM_LENGTH FROM information_schema.COLUMNS "
+                               "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'check_osc' AND COLUMN_NAME = 'email'");
+    }
+
+    /// Whether the statements altered check_osc through a shadow table, and never directly
+    void expectOnline(const RecordingAdapter &adapter, const std::string &step)
+    {
+        bool shadow = false;
+        for (const std::string &statement : adapter.statements)
+        {
+            shadow = shadow || statement == "CREATE TABLE _check_osc_new LIKE check_osc";
+            expect(statement.compare(0, 22, "ALTER TABLE check_osc ") != 0, step + " ran a blocking ALTER: " + statement);
+        }
+        expect(shadow, step + " didn't go through a shadow table");
+    }
+
+    /// An online schema change is recorded as one, and migrateToVersion replays it online both ways
+    void checkOnlineReplay(ORM::DatabaseAdapter &mysql)
+    {
+        for (const char *table : {"check_osc", "_check_osc_new", "_check_osc_old", "migrations", "online_schema_changes"})
+            execute(mysql, std::string("DROP TABLE IF EXISTS ") + table);
+
+        RecordingAdapter adapter(mysql);
+        ORM::MigrationManager::intialize(adapter);
+        ORM::MigrationManager::migrateModel(adapter, CheckOscV1{});
+        for (int i = 0; i < 50; i++)
+            execute(adapter, "INSERT INTO check_osc (email) VALUES (?)", {"user" + std::to_string(i) + "@example.com"});
+
+        ORM::OnlineSchemaChangeOptions options;
+        options.minRows = 0;
+        options.chunkSize = 7;
+        ORM::MigrationManager::enableOnlineSchemaChange(options);
+        adapter.statements.clear();
+        ORM::MigrationManager::migrateModel(adapter, CheckOscV2{});
+        ORM::MigrationManager::disableOnlineSchemaChange();
+        expectOnline(adapter, "migrateModel");
+        expect(emailLength(adapter) == "20", "email wasn't shrunk");
+
+        std::string version = ORM::MigrationManager::getCurrentVersion(adapter, "check_osc");
+        std::ifstream file("migrations/" + version + "_after_check_osc.sql");
+        std::stringstream content;
+        content << file.rdbuf();
+        expect(content.str().find("\n-- online\nALTER TABLE check_osc ") != std::string::npos,
+               "migration file doesn't mark the online change:\n" + content.str());
+
+        // replayed with online schema changes disabled, the marker alone decides
+        adapter.statements.clear();
+        expect(ORM::MigrationManager::migrateToVersion(adapter, "check_osc", "001_intial"), "migrating down failed");
+        expectOnline(adapter, "migrating down");
+        expect(emailLength(adapter) == "100", "email wasn't restored");
+
+        adapter.statements.clear();
+        expect(ORM::MigrationManager::migrateToVersion(adapter, "check_osc", version), "migrating up failed");
+        expectOnline(adapter, "migrating up");
+        expect(emailLength(adapter) == "20", "email wasn't shrunk again");
+        expect(scalar(adapter, "SELECT COUNT(*) FROM check_osc") == "50", "rows were lost");
+    }
+}
+
+int main()
+{
+    ORM::MySQLAdapter mysql;
+    if (!mysql.connect(env("ORM_TEST_MYSQL_HOST", "localhost"), env("ORM_TEST_MYSQL_USER", "root"),
+                       env("ORM_TEST_MYSQL_PASSWORD", ""), env("ORM_TEST_MYSQL_DB", "orm_test")))
+    {
+        std::cerr << "Connection failed: " << mysql.getLastError() << std::endl;
+        return 1;
+    }
+
+    // migration files of the checks don't end up next to the project's
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "orm_mysql_checks";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::filesystem::current_path(directory);
+
+    try
+    {
+        checkOnlineReplay(mysql);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "online replay: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "mysql checks passed" << std::endl;
+    return 0;
+}
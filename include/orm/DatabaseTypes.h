@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <map>
+#include <memory_resource>
 #include "utils/utils.h"
 
 namespace ORM
@@ -20,6 +22,10 @@ namespace ORM
         BLOB      /**< Binary Large Object (BLOB) type */
     };
 
+    // Result set types allocated from a caller supplied memory resource (see RequestArena)
+    using PmrRow = std::pmr::map<std::pmr::string, std::pmr::string>;
+    using PmrRows = std::pmr::vector<PmrRow>;
+
     struct FieldOptions
     {
         // Declaration order matters for designated initializers
@@ -27,10 +33,53 @@ namespace ORM
         bool auto_increment = false; /**< Indicates if the field auto increments */
         bool nullable = false;       /**< Indicates if the field can be null */
         bool unique = false;         /**< Indicates if the field has a unique constraint */
+        bool index = false;          /**< Indicates if a secondary index is created on the field */
         int max_length = 0;          /**< Maximum length for fields like strings */
         std::string default_value;   /**< Default value for the field */
     };
 
+    // A column of an index, optionally limited to a prefix of the value (prefix index)
+    struct IndexColumn
+    {
+        std::string name;      /**< Column name */
+        int prefix_length = 0; /**< Indexed prefix length, 0 indexes the full value */
+
+        IndexColumn(const char *name) : name(name) {}
+        IndexColumn(const std::string &name, int prefixLength = 0) : name(name), prefix_length(prefixLength) {}
+
+        /**
+         * Render the column as used in an index definition, e.g. "bio(20)".
+         */
+        std::string toString() const
+        {
+            return prefix_length > 0 ? name + "(" + std::to_string(prefix_length) + ")" : name;
+        }
+    };
+
+    // Secondary index declared on a model. A composite index listing every column a
+    // query reads acts as a covering index.
+    struct IndexDefinition
+    {
+        std::string name;                 /**< Index name, unique per table */
+        std::vector<IndexColumn> columns; /**< Indexed columns in order */
+        bool unique = false;              /**< Indicates if the index is a unique constraint */
+
+        /**
+         * Render the column list of the index, e.g. "(user_id, created_at)".
+         */
+        std::string columnList() const
+        {
+            std::string list = "(";
+            for (size_t i = 0; i < columns.size(); i++)
+            {
+                if (i > 0)
+                    list += ", ";
+                list += columns[i].toString();
+            }
+            return list + ")";
+        }
+    };
+
     class QueryBuilder;
 
     // Class representing a single field in a model
@@ -107,6 +156,42 @@ namespace ORM
          * @return The value of the field as a string
          */
         virtual std::string getFieldValue(const std::string &fieldName) const = 0;
+
+        /**
+         * Get the model level (composite) indexes of this model.
+         *
+         * @return A vector of index definitions, empty by default
+         */
+        virtual const std::vector<IndexDefinition> &getIndexes() const
+        {
+            static const std::vector<IndexDefinition> none;
+            return none;
+        }
+
+        /**
+         * Get every secondary index of the table: one "idx_<field>" index per field
+         * declared with `.index = true` followed by the model level indexes.
+         * TEXT/BLOB columns can only be indexed by prefix, so they use the first 255 bytes.
+         *
+         * @return A vector of index definitions
+         */
+        std::vector<IndexDefinition> collectIndexes() const
+        {
+            std::vector<IndexDefinition> indexes;
+            for (const auto &field : getFields())
+            {
+                if (!field->getOptions().index)
+                    continue;
+
+                bool needsPrefix = field->getType() == FieldType::TEXT ||
+                                   field->getType() == FieldType::BLOB ||
+                                   (field->getType() == FieldType::STRING && field->getOptions().max_length <= 0);
+                indexes.push_back({"idx_" + field->getName(), {IndexColumn(field->getName(), needsPrefix ? 255 : 0)}, false});
+            }
+            const auto &declared = getIndexes();
+            indexes.insert(indexes.end(), declared.begin(), declared.end());
+            return indexes;
+        }
     };
 
     // Abstract base class for database adapters, providing the interface for interacting with databases
@@ -137,6 +222,13 @@ namespace ORM
 
         virtual std::string getLastError() const = 0;
 
+        /**
+         * Server error number of the last failed executeRawQuery.
+         *
+         * @return The error number, 0 if unknown or the adapter doesn't report one
+         */
+        virtual unsigned int getLastErrorCode() const { return 0; }
+
         virtual std::string getCreateTableSTring(const Model &model) = 0;
 
         virtual std::vector<std::map<std::string, std::string>> executeQuery(
@@ -1,8 +1,10 @@
 // include/orm/MySQLAdapter.cpp
 #include "MySQLAdapter.h"
+#include <mysql/mysqld_error.h>
 #include <stdexcept>
 #include <iostream>
 #include <string.h>
+#include <algorithm>
 
 namespace ORM
 {
@@ -42,6 +44,7 @@ namespace ORM
             mysql_close(connection_);
             connection_ = nullptr;
         }
+        inTransaction_ = false;
     }
 
     std::string MySQLAdapter::getTypeString(FieldType type, const FieldOptions &options) const
@@ -93,36 +96,7 @@ namespace ORM
             return false;
         }
 
-        std::string query = "CREATE TABLE IF NOT EXISTS " + model.getTableName() + " (";
-        bool first = true;
-
-        for (const auto &field : model.getFields())
-        {
-            if (!first)
-                query += ", ";
-            first = false;
-
-            query += field->getName() + " " + getTypeString(field->getType(), field->getOptions());
-
-            if (field->getOptions().primary_key)
-            {
-                query += " PRIMARY KEY";
-            }
-            if (field->getOptions().unique)
-            {
-                query += " UNIQUE";
-            }
-            if (!field->getOptions().nullable)
-            {
-                query += " NOT NULL";
-            }
-            if (!field->getOptions().default_value.empty())
-            {
-                query += " DEFAULT '" + escapeString(field->getOptions().default_value) + "'";
-            }
-        }
-
-        query += ")";
+        std::string query = getCreateTableSTring(model);
 
         if (mysql_query(connection_, query.c_str()))
         {
@@ -164,6 +138,12 @@ namespace ORM
             }
         }
 
+        for (const auto &index : model.collectIndexes())
+        {
+            query += index.unique ? ", UNIQUE INDEX " : ", INDEX ";
+            query += index.name + " " + index.columnList();
+        }
+
         query += ")";
         return query;
     }
@@ -208,34 +188,386 @@ namespace ORM
             first = false;
 
             query += field->getName();
+            values += formatValue(*field, value);
+        }
+
+        query += ") " + values + ")";
+        if (mysql_query(connection_, query.c_str()))
+        {
+            lastError_ = mysql_error(connection_);
+            return false;
+        }
+
+        return true;
+    }
+
+    std::string MySQLAdapter::formatValue(const Field &field, const std::string &value) const
+    {
+        if (value.empty())
+            return "NULL";
+
+        switch (field.getType())
+        {
+        case FieldType::INTEGER:
+        case FieldType::FLOAT:
+        case FieldType::DOUBLE:
+        case FieldType::BOOLEAN:
+            return value;
+        default:
+            return "'" + escapeString(value) + "'";
+        }
+    }
+
+    bool MySQLAdapter::insertRecords(const std::vector<const Model *> &models, size_t chunkSize,
+                                     std::vector<unsigned long long> *firstIds)
+    {
+        return insertRows(models, chunkSize, false, firstIds);
+    }
+
+    bool MySQLAdapter::upsertRecords(const std::vector<const Model *> &models, size_t chunkSize)
+    {
+        // several chunks run in one transaction so a failing chunk doesn't leave the earlier ones
+        // committed, unless the caller already opened one with beginTransaction
+        bool ownTransaction = connection_ && chunkSize != 0 && models.size() > chunkSize && !inTransaction_;
+        if (ownTransaction && !beginTransaction())
+            return false;
+
+        if (insertRows(models, chunkSize, true))
+            return !ownTransaction || commitTransaction();
+
+        if (ownTransaction)
+        {
+            std::string error = lastError_;
+            rollbackTransaction();
+            lastError_ = error;
+        }
+        return false;
+    }
+
+    bool MySQLAdapter::insertRows(const std::vector<const Model *> &models, size_t chunkSize, bool upsert,
+                                  std::vector<unsigned long long> *firstIds)
+    {
+        if (!connection_)
+        {
+            lastError_ = "Not connected to database";
+            return false;
+        }
+        if (models.empty())
+            return true;
+        if (chunkSize == 0)
+            chunkSize = models.size();
+
+        const Model &first = *models.front();
+        const auto &fields = first.getFields();
+
+        // Columns are shared by every row of the multi-row statement. Auto increment
+        // fields are only sent when at least one row carries an explicit value,
+        // rows without one get NULL so MySQL generates the key.
+        std::vector<const Field *> columns;
+        // the key an upsert matches on: the primary key, else the first unique field
+        std::string keyColumn;
+        for (const auto &field : fields)
+        {
+            const FieldOptions opt = field->getOptions();
+            if (opt.primary_key || (opt.unique && keyColumn.empty()))
+                keyColumn = field->getName();
+        }
+        for (const auto &field : fields)
+        {
+            const FieldOptions opt = field->getOptions();
+
+            if (opt.auto_increment)
+            {
+                bool hasValue = std::any_of(models.begin(), models.end(), [&](const Model *m)
+                                            { return !m->getFieldValue(field->getName()).empty(); });
+                if (!hasValue)
+                    continue;
+            }
+            columns.push_back(field.get());
+        }
+        if (upsert && keyColumn.empty())
+        {
+            lastError_ = "No primary key or unique field found for table " + first.getTableName();
+            return false;
+        }
+
+        std::string head = "INSERT INTO " + first.getTableName() + " (";
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            if (i > 0)
+                head += ", ";
+            head += columns[i]->getName();
+        }
+        head += ") VALUES ";
 
-            if (value.empty())
+        // The matched key identifies the row, everything else (other unique columns included) is
+        // overwritten by the new values, read through the row alias (MySQL 8.0.20+, replaces VALUES())
+        std::string tail;
+        if (upsert)
+        {
+            tail = " AS new ON DUPLICATE KEY UPDATE ";
+            bool firstUpdate = true;
+            for (const Field *field : columns)
             {
-                values += "NULL";
+                if (field->getName() == keyColumn || field->getOptions().primary_key)
+                    continue;
+                if (!firstUpdate)
+                    tail += ", ";
+                firstUpdate = false;
+                tail += field->getName() + " = new." + field->getName();
             }
-            else
+            if (firstUpdate) // only key columns, keep the existing row untouched
+                tail += keyColumn + " = " + keyColumn;
+        }
+
+        for (size_t start = 0; start < models.size(); start += chunkSize)
+        {
+            size_t end = std::min(models.size(), start + chunkSize);
+            std::string query = head;
+
+            for (size_t r = start; r < end; r++)
             {
-                switch (field->getType())
+                const Model &model = *models[r];
+                if (model.getTableName() != first.getTableName())
                 {
-                case FieldType::INTEGER:
-                case FieldType::FLOAT:
-                case FieldType::DOUBLE:
-                case FieldType::BOOLEAN:
-                    values += value;
-                    break;
-                default:
-                    values += "'" + escapeString(value) + "'";
+                    lastError_ = "Cannot write records of different tables in one statement";
+                    return false;
+                }
+
+                if (r > start)
+                    query += ", ";
+                query += "(";
+                for (size_t c = 0; c < columns.size(); c++)
+                {
+                    const Field &field = *columns[c];
+                    std::string value = model.getFieldValue(field.getName());
+
+                    if (value.empty() && !field.getOptions().nullable && !field.getOptions().auto_increment)
+                    {
+                        if (!field.getOptions().default_value.empty())
+                        {
+                            value = field.getOptions().default_value;
+                        }
+                        else
+                        {
+                            lastError_ = "Field '" + field.getName() + "' cannot be NULL";
+                            return false;
+                        }
+                    }
+
+                    if (c > 0)
+                        query += ", ";
+                    query += formatValue(field, value);
                 }
+                query += ")";
+            }
+            query += tail;
+
+            if (mysql_query(connection_, query.c_str()))
+            {
+                lastError_ = mysql_error(connection_);
+                return false;
             }
+            if (firstIds)
+                firstIds->push_back(mysql_insert_id(connection_));
         }
 
-        query += ") " + values + ")";
-        if (mysql_query(connection_, query.c_str()))
+        return true;
+    }
+
+    bool MySQLAdapter::updateRecords(const std::vector<std::pair<const Model *, std::vector<std::string>>> &changes, size_t chunkSize)
+    {
+        if (!connection_)
+        {
+            lastError_ = "Not connected to database";
+            return false;
+        }
+        if (changes.empty())
+            return true;
+        if (chunkSize == 0)
+            chunkSize = changes.size();
+
+        const Model &first = *changes.front().first;
+        const Field *pkField = nullptr;
+        for (const auto &field : first.getFields())
+        {
+            if (field->getOptions().primary_key)
+            {
+                pkField = field.get();
+                break;
+            }
+        }
+        if (!pkField)
+        {
+            lastError_ = "No primary key found for table " + first.getTableName();
+            return false;
+        }
+        const std::string &pk = pkField->getName();
+
+        // One statement per chunk: every changed column becomes
+        //   col = CASE pk WHEN <id> THEN <value> ... ELSE col END
+        // so rows that did not touch a column keep their current value.
+        for (size_t start = 0; start < changes.size(); start += chunkSize)
+        {
+            size_t end = std::min(changes.size(), start + chunkSize);
+
+            std::vector<std::string> columnOrder;
+            std::map<std::string, std::string> cases;
+            std::string ids;
+
+            for (size_t r = start; r < end; r++)
+            {
+                const Model &model = *changes[r].first;
+                std::string pkValue = formatValue(*pkField, model.getFieldValue(pk));
+                if (pkValue == "NULL")
+                {
+                    lastError_ = "Cannot update a record of " + model.getTableName() + " without primary key value";
+                    return false;
+                }
+                if (r > start)
+                    ids += ", ";
+                ids += pkValue;
+
+                for (const auto &column : changes[r].second)
+                {
+                    for (const auto &field : model.getFields())
+                    {
+                        if (field->getName() != column)
+                            continue;
+                        auto it = cases.find(column);
+                        if (it == cases.end())
+                        {
+                            columnOrder.push_back(column);
+                            it = cases.emplace(column, "").first;
+                        }
+                        it->second += " WHEN " + pkValue + " THEN " + formatValue(*field, model.getFieldValue(column));
+                        break;
+                    }
+                }
+            }
+            if (columnOrder.empty())
+                continue;
+
+            std::string query = "UPDATE " + first.getTableName() + " SET ";
+            for (size_t i = 0; i < columnOrder.size(); i++)
+            {
+                const std::string &column = columnOrder[i];
+                if (i > 0)
+                    query += ", ";
+                query += column + " = CASE " + pk + cases[column] + " ELSE " + column + " END";
+            }
+            query += " WHERE " + pk + " IN (" + ids + ")";
+
+            if (mysql_query(connection_, query.c_str()))
+            {
+                lastError_ = mysql_error(connection_);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool MySQLAdapter::deleteRecords(const std::vector<const Model *> &models, size_t chunkSize)
+    {
+        if (!connection_)
+        {
+            lastError_ = "Not connected to database";
+            return false;
+        }
+        if (models.empty())
+            return true;
+        if (chunkSize == 0)
+            chunkSize = models.size();
+
+        const Model &first = *models.front();
+        const Field *pkField = nullptr;
+        for (const auto &field : first.getFields())
+        {
+            if (field->getOptions().primary_key)
+            {
+                pkField = field.get();
+                break;
+            }
+        }
+        if (!pkField)
+        {
+            lastError_ = "No primary key found for table " + first.getTableName();
+            return false;
+        }
+
+        for (size_t start = 0; start < models.size(); start += chunkSize)
+        {
+            size_t end = std::min(models.size(), start + chunkSize);
+            std::string query = "DELETE FROM " + first.getTableName() + " WHERE " + pkField->getName() + " IN (";
+            for (size_t r = start; r < end; r++)
+            {
+                std::string pkValue = formatValue(*pkField, models[r]->getFieldValue(pkField->getName()));
+                if (pkValue == "NULL")
+                {
+                    lastError_ = "Cannot delete a record of " + first.getTableName() + " without primary key value";
+                    return false;
+                }
+                if (r > start)
+                    query += ", ";
+                query += pkValue;
+            }
+            query += ")";
+
+            if (mysql_query(connection_, query.c_str()))
+            {
+                lastError_ = mysql_error(connection_);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool MySQLAdapter::beginTransaction()
+    {
+        if (!connection_)
+        {
+            lastError_ = "Not connected to database";
+            return false;
+        }
+        if (mysql_query(connection_, "START TRANSACTION"))
+        {
+            lastError_ = mysql_error(connection_);
+            return false;
+        }
+        inTransaction_ = true;
+        return true;
+    }
+
+    bool MySQLAdapter::commitTransaction()
+    {
+        if (!connection_)
+        {
+            lastError_ = "Not connected to database";
+            return false;
+        }
+        if (mysql_query(connection_, "COMMIT"))
         {
             lastError_ = mysql_error(connection_);
             return false;
         }
+        inTransaction_ = false;
+        return true;
+    }
 
+    bool MySQLAdapter::rollbackTransaction()
+    {
+        if (!connection_)
+        {
+            lastError_ = "Not connected to database";
+            return false;
+        }
+        // a ROLLBACK only fails on a lost connection, whose transaction the server rolls back
+        inTransaction_ = false;
+        if (mysql_query(connection_, "ROLLBACK"))
+        {
+            lastError_ = mysql_error(connection_);
+            return false;
+        }
         return true;
     }
 
@@ -278,65 +610,91 @@ namespace ORM
 
     bool MySQLAdapter::executeRawQuery(const std::string &query, const std::vector<std::string> &params)
     {
+        lastErrorCode_ = 0;
         MYSQL_STMT *stmt = mysql_stmt_init(connection_);
         if (!stmt)
             return false;
 
         if (mysql_stmt_prepare(stmt, query.c_str(), query.length()) != 0)
         {
-            lastError_ = mysql_error(connection_);
+            // e.g. CREATE TRIGGER, which the prepared statement protocol doesn't support
+            lastErrorCode_ = mysql_stmt_errno(stmt);
+            bool unsupported = lastErrorCode_ == ER_UNSUPPORTED_PS;
+            lastError_ = mysql_stmt_error(stmt);
             mysql_stmt_close(stmt);
+            if (unsupported && params.empty())
+                return executeTextQuery(query);
             return false;
         }
         if (!bindStatementParams(stmt, params))
         {
-            lastError_ = mysql_error(connection_);
+            lastErrorCode_ = mysql_stmt_errno(stmt);
+            lastError_ = mysql_stmt_error(stmt);
             mysql_stmt_close(stmt);
             return false;
         }
         bool succuss = mysql_stmt_execute(stmt) == 0;
+        if (!succuss)
+        {
+            lastErrorCode_ = mysql_stmt_errno(stmt);
+            lastError_ = mysql_stmt_error(stmt);
+        }
         mysql_stmt_close(stmt);
         return succuss;
     }
 
-    std::vector<std::map<std::string, std::string>> ORM::MySQLAdapter::executeQuery(
-        const std::string &query, const std::vector<std::string> &params)
+    bool MySQLAdapter::executeTextQuery(const std::string &query)
     {
+        if (mysql_real_query(connection_, query.c_str(), query.length()) != 0)
+        {
+            lastErrorCode_ = mysql_errno(connection_);
+            lastError_ = mysql_error(connection_);
+            return false;
+        }
+        // statements without a result set return nullptr here
+        if (MYSQL_RES *result = mysql_store_result(connection_))
+            mysql_free_result(result);
+        return true;
+    }
 
-        std::vector<std::map<std::string, std::string>> results;
-
-        MYSQL_STMT *stmt = mysql_stmt_init(connection_);
+    /**
+     * Run a prepared statement and append its rows to results. Rows is either the
+     * std or the pmr row vector, rows and strings use the allocator of results.
+     */
+    template <typename Rows>
+    void fetchStatementRows(MYSQL *connection, const std::string &query, const std::vector<std::string> &params, Rows &results)
+    {
+        MYSQL_STMT *stmt = mysql_stmt_init(connection);
         if (!stmt)
-            return results;
+            return;
 
         if (mysql_stmt_prepare(stmt, query.c_str(), query.length()) != 0)
         {
             mysql_stmt_close(stmt);
-            return results;
+            return;
         }
 
         if (!bindStatementParams(stmt, params))
         {
             mysql_stmt_close(stmt);
-            return results;
+            return;
         }
 
         if (mysql_stmt_execute(stmt) != 0)
         {
             mysql_stmt_close(stmt);
-            return results;
+            return;
         }
 
         MYSQL_RES *meta = mysql_stmt_result_metadata(stmt);
         if (!meta)
         {
             mysql_stmt_close(stmt);
-            return results;
+            return;
         }
 
         int numFields = mysql_num_fields(meta);
         std::vector<MYSQL_BIND> bind(numFields);
-        std::vector<char> buffer(1024);
         std::vector<unsigned long> lengths(numFields);
         std::vector<char *> rowBuffer(numFields);
 
@@ -352,22 +710,66 @@ namespace ORM
 
         mysql_stmt_bind_result(stmt, bind.data());
 
+        MYSQL_FIELD *fields = mysql_fetch_fields(meta);
         while (mysql_stmt_fetch(stmt) == 0)
         {
-            std::map<std::string, std::string> row;
-            MYSQL_FIELD *fields = mysql_fetch_fields(meta);
+            auto &row = results.emplace_back();
             for (int i = 0; i < numFields; ++i)
             {
-                row[fields[i].name] = std::string(rowBuffer[i], lengths[i]);
+                row.emplace(std::piecewise_construct,
+                            std::forward_as_tuple(fields[i].name),
+                            std::forward_as_tuple(rowBuffer[i], lengths[i]));
             }
-            results.push_back(row);
         }
 
         for (auto ptr : rowBuffer)
             delete[] ptr;
         mysql_free_result(meta);
         mysql_stmt_close(stmt);
+    }
+
+    /**
+     * Append all rows of a stored result to rows, SQL NULL is rendered as "NULL".
+     */
+    template <typename Rows>
+    void fetchResultRows(MYSQL_RES *result, Rows &rows)
+    {
+        int num_fields = mysql_num_fields(result);       // total rows
+        MYSQL_FIELD *fields = mysql_fetch_field(result); // all field with name
+        MYSQL_ROW row;
+
+        while ((row = mysql_fetch_row(result)))
+        {
+            auto &row_map = rows.emplace_back();
+            unsigned long *lengths = mysql_fetch_lengths(result);
+
+            for (int i = 0; i < num_fields; i++)
+            {
+                if (row[i])
+                    row_map.emplace(std::piecewise_construct,
+                                    std::forward_as_tuple(fields[i].name),
+                                    std::forward_as_tuple(row[i], lengths[i]));
+                else
+                    row_map.emplace(std::piecewise_construct,
+                                    std::forward_as_tuple(fields[i].name),
+                                    std::forward_as_tuple("NULL"));
+            }
+        }
+    }
+
+    std::vector<std::map<std::string, std::string>> ORM::MySQLAdapter::executeQuery(
+        const std::string &query, const std::vector<std::string> &params)
+    {
+        std::vector<std::map<std::string, std::string>> results;
+        fetchStatementRows(connection_, query, params, results);
+        return results;
+    }
 
+    PmrRows MySQLAdapter::executeQuery(const std::string &query, const std::vector<std::string> &params,
+                                       std::pmr::memory_resource *resource)
+    {
+        PmrRows results(resource);
+        fetchStatementRows(connection_, query, params, results);
         return results;
     }
 
@@ -375,28 +777,284 @@ namespace ORM
     {
         std::vector<std::map<std::string, std::string>> rows;
         MYSQL_RES *result = nullptr;
-        if (!executeQuery(query, result))
+        if (!executeQuery(query, result) || !result)
         {
-            return rows; // unsuccsessfull
+            return rows; // unsuccsessfull or no result set
         }
-        int num_fields = mysql_num_fields(result);       // total rows
-        MYSQL_FIELD *fields = mysql_fetch_field(result); // all field with name
-        MYSQL_ROW row;
+        fetchResultRows(result, rows);
+        mysql_free_result(result);
+        return rows;
+    }
 
-        while (row = mysql_fetch_row(result))
+    PmrRows MySQLAdapter::fetchAllFromQuery(const std::string &query, std::pmr::memory_resource *resource)
+    {
+        PmrRows rows(resource);
+        MYSQL_RES *result = nullptr;
+        if (!executeQuery(query, result) || !result)
         {
-            std::map<std::string, std::string> row_map;
-            unsigned long *lengths = mysql_fetch_lengths(result);
+            return rows; // unsuccsessfull or no result set
+        }
+        fetchResultRows(result, rows);
+        mysql_free_result(result);
+        return rows;
+    }
 
-            for (int i = 0; i < num_fields; i++)
+    std::string MySQLAdapter::fetchBinaryFromQuery(const std::string &query)
+    {
+        std::string out;
+        MYSQL_RES *result = nullptr;
+        if (!executeQuery(query, result) || !result)
+        {
+            return out;
+        }
+
+        unsigned int num_fields = mysql_num_fields(result);
+        MYSQL_FIELD *fields = mysql_fetch_fields(result);
+
+        BinaryWriter writer(out);
+        writer.writeByte(BINARY_TAG_ROWSET);
+        writer.writeByte(BINARY_FORMAT_VERSION);
+        writer.writeVarint(num_fields);
+        for (unsigned int i = 0; i < num_fields; i++)
+        {
+            writer.writeString(fields[i].name);
+        }
+        writer.writeVarint(mysql_num_rows(result));
+
+        size_t bitmapSize = (num_fields + 7) / 8;
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(result)))
+        {
+            unsigned long *lengths = mysql_fetch_lengths(result);
+            size_t bitmap = writer.position();
+            out.append(bitmapSize, '\0');
+            for (unsigned int i = 0; i < num_fields; i++)
             {
-                std::string key = fields[i].name;
-                std::string value = row[i] ? std::string(row[i], lengths[i]) : "NULL";
-                row_map[key] = value;
+                if (!row[i])
+                {
+                    out[bitmap + i / 8] = static_cast<char>(out[bitmap + i / 8] | (1u << (i % 8)));
+                    continue;
+                }
+                writer.writeString(std::string_view(row[i], lengths[i]));
             }
-            rows.push_back(row_map);
         }
         mysql_free_result(result);
-        return rows;
+        return out;
+    }
+
+    namespace
+    {
+        /// How a result column is written by writeJSONFromQuery
+        enum class JSONColumnKind
+        {
+            STRING,
+            NUMBER,
+            BOOLEAN,
+            BITS,
+            BINARY
+        };
+
+        // charsetnr of BINARY/VARBINARY/BLOB columns, TEXT columns carry their own charset
+        constexpr unsigned int BINARY_CHARSET_NR = 63;
+
+        JSONColumnKind jsonColumnKind(const MYSQL_FIELD &field)
+        {
+            switch (field.type)
+            {
+            case MYSQL_TYPE_TINY_BLOB:
+            case MYSQL_TYPE_MEDIUM_BLOB:
+            case MYSQL_TYPE_LONG_BLOB:
+            case MYSQL_TYPE_BLOB:
+            case MYSQL_TYPE_STRING:
+            case MYSQL_TYPE_VAR_STRING:
+            case MYSQL_TYPE_VARCHAR:
+                return field.charsetnr == BINARY_CHARSET_NR ? JSONColumnKind::BINARY : JSONColumnKind::STRING;
+            case MYSQL_TYPE_GEOMETRY:
+                return JSONColumnKind::BINARY;
+            case MYSQL_TYPE_TINY:
+                // BOOLEAN columns are TINYINT(1)
+                return field.length == 1 ? JSONColumnKind::BOOLEAN : JSONColumnKind::NUMBER;
+            case MYSQL_TYPE_SHORT:
+            case MYSQL_TYPE_LONG:
+            case MYSQL_TYPE_INT24:
+            case MYSQL_TYPE_LONGLONG:
+            case MYSQL_TYPE_YEAR:
+            case MYSQL_TYPE_FLOAT:
+            case MYSQL_TYPE_DOUBLE:
+            case MYSQL_TYPE_DECIMAL:
+            case MYSQL_TYPE_NEWDECIMAL:
+                return JSONColumnKind::NUMBER;
+            case MYSQL_TYPE_BIT:
+                return JSONColumnKind::BITS;
+            default:
+                return JSONColumnKind::STRING;
+            }
+        }
+
+        /// Standard base64 with padding, binary column values are not valid UTF-8 JSON strings
+        void appendBase64(std::string &out, std::string_view bytes)
+        {
+            static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            out.reserve(out.size() + (bytes.size() + 2) / 3 * 4);
+            size_t i = 0;
+            for (; i + 2 < bytes.size(); i += 3)
+            {
+                unsigned chunk = static_cast<unsigned char>(bytes[i]) << 16 |
+                                 static_cast<unsigned char>(bytes[i + 1]) << 8 |
+                                 static_cast<unsigned char>(bytes[i + 2]);
+                out += alphabet[chunk >> 18];
+                out += alphabet[(chunk >> 12) & 0x3f];
+                out += alphabet[(chunk >> 6) & 0x3f];
+                out += alphabet[chunk & 0x3f];
+            }
+            if (i < bytes.size())
+            {
+                unsigned chunk = static_cast<unsigned char>(bytes[i]) << 16;
+                if (i + 1 < bytes.size())
+                    chunk |= static_cast<unsigned char>(bytes[i + 1]) << 8;
+                out += alphabet[chunk >> 18];
+                out += alphabet[(chunk >> 12) & 0x3f];
+                out += i + 1 < bytes.size() ? alphabet[(chunk >> 6) & 0x3f] : '=';
+                out += '=';
+            }
+        }
+
+        /// Owns a mysql_use_result() result: unread rows are drained and the result freed on every path
+        class UseResult
+        {
+        public:
+            explicit UseResult(MYSQL_RES *result) : result_(result) {}
+            ~UseResult()
+            {
+                if (!result_)
+                    return;
+                while (mysql_fetch_row(result_))
+                {
+                }
+                mysql_free_result(result_);
+            }
+            UseResult(const UseResult &) = delete;
+            UseResult &operator=(const UseResult &) = delete;
+
+            MYSQL_RES *get() const { return result_; }
+
+        private:
+            MYSQL_RES *result_;
+        };
+    }
+
+    bool MySQLAdapter::writeJSONFromQuery(const std::string &query, JSONWriter &writer)
+    {
+        if (!connection_)
+        {
+            lastError_ = "Not connected to database";
+            return false;
+        }
+        if (mysql_query(connection_, query.c_str()))
+        {
+            lastError_ = mysql_error(connection_);
+            return false;
+        }
+
+        // Unbuffered: rows are pulled from the server as they are written
+        UseResult guard(mysql_use_result(connection_));
+        MYSQL_RES *result = guard.get();
+        if (!result)
+        {
+            if (mysql_field_count(connection_) > 0)
+            {
+                lastError_ = mysql_error(connection_);
+                return false;
+            }
+            writer.beginArray().endArray();
+            return true;
+        }
+
+        unsigned int num_fields = mysql_num_fields(result);
+        MYSQL_FIELD *fields = mysql_fetch_fields(result);
+        std::vector<JSONColumnKind> kinds(num_fields);
+        for (unsigned int i = 0; i < num_fields; i++)
+        {
+            kinds[i] = jsonColumnKind(fields[i]);
+        }
+
+        writer.beginArray();
+        std::string encoded;
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(result)))
+        {
+            unsigned long *lengths = mysql_fetch_lengths(result);
+            writer.beginObject();
+            for (unsigned int i = 0; i < num_fields; i++)
+            {
+                writer.key(fields[i].name);
+                if (!row[i])
+                {
+                    writer.value(nullptr);
+                    continue;
+                }
+
+                std::string_view value(row[i], lengths[i]);
+                switch (kinds[i])
+                {
+                case JSONColumnKind::NUMBER:
+                    writer.numberValue(value);
+                    break;
+                case JSONColumnKind::BOOLEAN:
+                    writer.value(value != "0");
+                    break;
+                case JSONColumnKind::BITS:
+                {
+                    // BIT(n) arrives as n/8 big-endian bytes
+                    if (fields[i].length == 1)
+                    {
+                        writer.value(!value.empty() && value.back() != 0);
+                        break;
+                    }
+                    unsigned long long bits = 0;
+                    for (char c : value)
+                    {
+                        bits = (bits << 8) | static_cast<unsigned char>(c);
+                    }
+                    writer.numberValue(std::to_string(bits));
+                    break;
+                }
+                case JSONColumnKind::BINARY:
+                    encoded.clear();
+                    appendBase64(encoded, value);
+                    writer.value(encoded);
+                    break;
+                case JSONColumnKind::STRING:
+                    writer.value(value);
+                    break;
+                }
+            }
+            writer.endObject();
+        }
+        writer.endArray();
+
+        bool success = mysql_errno(connection_) == 0;
+        if (!success)
+        {
+            lastError_ = mysql_error(connection_);
+        }
+        return success;
+    }
+
+    bool MySQLAdapter::streamJSONFromQuery(const std::string &query, std::ostream &out, int indent)
+    {
+        JSONWriter writer(out, indent);
+        return writeJSONFromQuery(query, writer);
+    }
+
+    std::string MySQLAdapter::fetchJSONFromQuery(const std::string &query)
+    {
+        std::string out;
+        {
+            JSONWriter writer(out);
+            if (!writeJSONFromQuery(query, writer))
+                out.clear();
+        }
+        return out;
     }
-}
\ No newline at end of file
+}
@@ -19,6 +19,7 @@ namespace ORM
         std::string getCreateTableSTring(const Model &model) override;
         void disconnect() override;
         std::string getLastError() const override { return lastError_; }
+        unsigned int getLastErrorCode() const override { return lastErrorCode_; }
 
         bool executeQuery(const std::string &query, MYSQL_RES *&result);
 
@@ -30,14 +31,60 @@ namespace ORM
 
         std::vector<std::map<std::string, std::string>> fetchAllFromQuery(const std::string &query) override;
 
+        // Same as above, rows and strings are allocated from resource (e.g. a RequestArena)
+        PmrRows executeQuery(const std::string &query, const std::vector<std::string> &params,
+                             std::pmr::memory_resource *resource);
+        PmrRows fetchAllFromQuery(const std::string &query, std::pmr::memory_resource *resource);
+
+        /**
+         * Run a query and encode its result set straight from MYSQL_RES into the
+         * binary result set format (see BinaryRowSetReader), SQL NULL stays NULL.
+         */
+        std::string fetchBinaryFromQuery(const std::string &query);
+
+        /**
+         * Run a query and write its rows as a JSON array of objects into out.
+         *
+         * Rows are read one at a time (mysql_use_result) and written straight from
+         * MYSQL_ROW, staged output is flushed to the stream every few KiB, so memory
+         * stays bounded whatever the size of the result. Numeric columns are written
+         * as numbers, TINYINT(1) and BIT(1) as booleans, SQL NULL as null,
+         * BINARY/VARBINARY/BLOB columns as base64 strings and everything else as
+         * escaped strings.
+         *
+         * @param indent Spaces per nesting level, 0 for compact output
+         * @return True on success, on an error mid-stream the output is incomplete.
+         *         If writing throws, the rest of the result is drained and freed first
+         */
+        bool streamJSONFromQuery(const std::string &query, std::ostream &out, int indent = 0);
+
+        /**
+         * Same as streamJSONFromQuery, returning the JSON text (empty on error)
+         */
+        std::string fetchJSONFromQuery(const std::string &query);
+
         std::unique_ptr<QueryBuilder> createQueryBuilder() override
         {
             return std::make_unique<MySQLQueryBuilder>(connection_);
         }
 
+        // Transactions
+        bool beginTransaction();
+        bool commitTransaction();
+        bool rollbackTransaction();
+        // between beginTransaction and commitTransaction/rollbackTransaction, a START TRANSACTION
+        // sent as a raw query isn't seen
+        bool inTransaction() const { return inTransaction_; }
+
         MYSQL *getConnection() const { return connection_; }
         std::string escapeString(const std::string &input) const override;
 
+        /**
+         * Render a field value as a SQL literal: NULL when empty, unquoted for
+         * numeric/boolean fields and an escaped quoted string otherwise.
+         */
+        std::string formatValue(const Field &field, const std::string &value) const;
+
         // Insert operations
         template <typename ModelType>
         bool insert(const std::map<std::string, std::string> &fields);
@@ -45,6 +92,14 @@ namespace ORM
         template <typename ModelType>
         bool bulkInsert(const std::vector<std::map<std::string, std::string>> &entities);
 
+        // Upsert operations (INSERT ... AS new ON DUPLICATE KEY UPDATE, MySQL 8.0.20+), matched on the
+        // primary key or else the first unique field; bulkUpsert runs all chunks in one transaction
+        template <typename ModelType>
+        bool upsert(const ModelType &entity);
+
+        template <typename ModelType>
+        bool bulkUpsert(const std::vector<ModelType> &entities, size_t chunkSize = 500);
+
         // select operations
         template <typename ModelType>
         std::vector<std::map<std::string, std::string>> find();
@@ -105,10 +160,28 @@ namespace ORM
     private:
         MYSQL *connection_;
         std::string lastError_;
+        // set by executeRawQuery only
+        unsigned int lastErrorCode_ = 0;
+        bool inTransaction_ = false;
         MySQLQueryBuilder queryBuilder_;
 
         std::string getTypeString(FieldType type, const FieldOptions &options) const;
+        // Runs a statement through the text protocol (mysql_real_query), discarding any result
+        bool executeTextQuery(const std::string &query);
         bool insertRecord(const Model &model) override;
+        bool upsertRecords(const std::vector<const Model *> &models, size_t chunkSize);
+        bool writeJSONFromQuery(const std::string &query, JSONWriter &writer);
+
+        // Multi-row writes used by upsert and MySQLUnitOfWork::flush, all models must share one table
+        // firstIds receives mysql_insert_id() of every chunk, the key generated for its first row
+        bool insertRows(const std::vector<const Model *> &models, size_t chunkSize, bool upsert,
+                        std::vector<unsigned long long> *firstIds = nullptr);
+        bool insertRecords(const std::vector<const Model *> &models, size_t chunkSize,
+                           std::vector<unsigned long long> *firstIds = nullptr);
+        bool updateRecords(const std::vector<std::pair<const Model *, std::vector<std::string>>> &changes, size_t chunkSize);
+        bool deleteRecords(const std::vector<const Model *> &models, size_t chunkSize);
+
+        friend class MySQLUnitOfWork;
     };
 }
 
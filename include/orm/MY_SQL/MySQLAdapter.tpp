@@ -57,6 +57,24 @@ namespace ORM
         return true;
     }
 
+    template <typename ModelType>
+    bool MySQLAdapter::upsert(const ModelType &entity)
+    {
+        return upsertRecords({&entity}, 1);
+    }
+
+    template <typename ModelType>
+    bool MySQLAdapter::bulkUpsert(const std::vector<ModelType> &entities, size_t chunkSize)
+    {
+        std::vector<const Model *> models;
+        models.reserve(entities.size());
+        for (const auto &entity : entities)
+        {
+            models.push_back(&entity);
+        }
+        return upsertRecords(models, chunkSize);
+    }
+
     template <typename ModelType>
     std::vector<std::map<std::string, std::string>> MySQLAdapter::find()
     {
@@ -0,0 +1,280 @@
+// include/orm/MySQLUnitOfWork.cpp
+#include "MySQLUnitOfWork.h"
+#include <algorithm>
+
+namespace ORM
+{
+    namespace
+    {
+        const Field *primaryKeyField(const Model &model)
+        {
+            for (const auto &field : model.getFields())
+            {
+                if (field->getOptions().primary_key)
+                    return field.get();
+            }
+            return nullptr;
+        }
+
+        /**
+         * Group models by table while keeping the order in which tables were first seen,
+         * so statements are issued in a predictable order.
+         */
+        template <typename Item, typename TableOf>
+        std::vector<std::vector<Item>> groupByTable(const std::vector<Item> &items, TableOf tableOf)
+        {
+            std::vector<std::vector<Item>> groups;
+            std::unordered_map<std::string, size_t> groupIndex;
+            for (const auto &item : items)
+            {
+                auto [it, inserted] = groupIndex.emplace(tableOf(item), groups.size());
+                if (inserted)
+                    groups.emplace_back();
+                groups[it->second].push_back(item);
+            }
+            return groups;
+        }
+    }
+
+    MySQLUnitOfWork::MySQLUnitOfWork(MySQLAdapter &adapter, size_t batchSize)
+        : adapter_(adapter), batchSize_(batchSize) {}
+
+    std::string MySQLUnitOfWork::identityKey(const std::string &tableName, const std::string &id)
+    {
+        return tableName + ":" + id;
+    }
+
+    std::string MySQLUnitOfWork::identityKey(const Model &model)
+    {
+        const Field *pk = primaryKeyField(model);
+        if (!pk)
+            return "";
+        std::string id = model.getFieldValue(pk->getName());
+        return id.empty() ? "" : identityKey(model.getTableName(), id);
+    }
+
+    std::unordered_map<std::string, std::string> MySQLUnitOfWork::takeSnapshot(const Model &model)
+    {
+        std::unordered_map<std::string, std::string> snapshot;
+        for (const auto &field : model.getFields())
+        {
+            snapshot[field->getName()] = model.getFieldValue(field->getName());
+        }
+        return snapshot;
+    }
+
+    bool MySQLUnitOfWork::isDeleted(const Model &model) const
+    {
+        return std::any_of(deletedEntities_.begin(), deletedEntities_.end(), [&](const std::shared_ptr<Model> &entity)
+                           { return entity.get() == &model; });
+    }
+
+    bool MySQLUnitOfWork::isDeleted(const std::string &key) const
+    {
+        return std::any_of(deletedEntities_.begin(), deletedEntities_.end(), [&](const std::shared_ptr<Model> &entity)
+                           { return identityKey(*entity) == key; });
+    }
+
+    bool MySQLUnitOfWork::insertGroup(const std::vector<const Model *> &group, std::vector<std::pair<Model *, std::string>> &generatedKeys)
+    {
+        const Field *pk = primaryKeyField(*group.front());
+        if (!pk || !pk->getOptions().auto_increment)
+            return adapter_.insertRecords(group, batchSize_);
+
+        // The key of a generated row is only known from mysql_insert_id(), i.e. for the first row of a
+        // statement; rows of a multi-row INSERT after it are derived, so they must not carry explicit keys
+        std::vector<const Model *> explicitKeys;
+        std::vector<const Model *> generated;
+        for (const Model *model : group)
+            (model->getFieldValue(pk->getName()).empty() ? generated : explicitKeys).push_back(model);
+
+        if (!explicitKeys.empty() && !adapter_.insertRecords(explicitKeys, batchSize_))
+            return false;
+        if (generated.empty())
+            return true;
+
+        if (!autoIncrement_)
+        {
+            auto settings = adapter_.executeQuery(
+                "SELECT @@auto_increment_increment AS step, @@innodb_autoinc_lock_mode AS lock_mode", {});
+            AutoIncrement autoIncrement;
+            if (!settings.empty())
+            {
+                autoIncrement.increment = settings[0]["step"].empty() ? 1 : std::stoull(settings[0]["step"]);
+                // modes 0 (traditional) and 1 (consecutive) hand a multi-row INSERT consecutive keys, 2
+                // (interleaved, the MySQL 8 default) lets concurrent INSERTs take keys in between
+                autoIncrement.consecutive = settings[0]["lock_mode"] == "0" || settings[0]["lock_mode"] == "1";
+            }
+            autoIncrement_ = autoIncrement;
+        }
+
+        // without consecutive keys every row is its own INSERT, with its own mysql_insert_id()
+        size_t chunkSize = !autoIncrement_->consecutive ? 1 : batchSize_ == 0 ? generated.size() : batchSize_;
+        std::vector<unsigned long long> firstIds;
+        if (!adapter_.insertRecords(generated, chunkSize, &firstIds))
+            return false;
+
+        for (size_t i = 0; i < generated.size(); i++)
+        {
+            unsigned long long id = firstIds[i / chunkSize] + (i % chunkSize) * autoIncrement_->increment;
+            // the models are owned by newEntities_, only the const view was handed to the adapter
+            generatedKeys.emplace_back(const_cast<Model *>(generated[i]), std::to_string(id));
+        }
+        return true;
+    }
+
+    void MySQLUnitOfWork::registerNew(const std::shared_ptr<Model> &entity)
+    {
+        if (entity)
+            newEntities_.push_back(entity);
+    }
+
+    void MySQLUnitOfWork::registerDirty(const std::shared_ptr<Model> &entity)
+    {
+        if (!entity)
+            return;
+
+        std::string key = identityKey(*entity);
+        if (key.empty())
+            throw std::runtime_error("Cannot track a " + entity->getTableName() + " record without primary key value");
+
+        auto it = identityMap_.find(key);
+        if (it != identityMap_.end())
+        {
+            if (it->second.entity != entity)
+                throw std::runtime_error("Another instance of " + key + " is already tracked");
+            return;
+        }
+        // No snapshot: every non-empty field counts as changed
+        identityMap_[key] = Entry{entity, {}};
+    }
+
+    void MySQLUnitOfWork::registerDeleted(const std::shared_ptr<Model> &entity)
+    {
+        if (!entity)
+            return;
+
+        // Deleting a model that was never written just cancels the insert
+        auto pending = std::find(newEntities_.begin(), newEntities_.end(), entity);
+        if (pending != newEntities_.end())
+        {
+            newEntities_.erase(pending);
+            return;
+        }
+        if (!isDeleted(*entity))
+            deletedEntities_.push_back(entity);
+    }
+
+    bool MySQLUnitOfWork::flush()
+    {
+        lastError_.clear();
+
+        // Collect changed columns of every tracked model
+        std::vector<std::pair<const Model *, std::vector<std::string>>> dirty;
+        for (const auto &[key, entry] : identityMap_)
+        {
+            const Model &model = *entry.entity;
+            if (isDeleted(model))
+                continue;
+
+            std::vector<std::string> changed;
+            for (const auto &field : model.getFields())
+            {
+                if (field->getOptions().primary_key)
+                    continue;
+
+                std::string value = model.getFieldValue(field->getName());
+                auto old = entry.snapshot.find(field->getName());
+                if (old == entry.snapshot.end() ? !value.empty() : old->second != value)
+                    changed.push_back(field->getName());
+            }
+            if (!changed.empty())
+                dirty.emplace_back(&model, std::move(changed));
+        }
+
+        if (newEntities_.empty() && dirty.empty() && deletedEntities_.empty())
+            return true;
+
+        std::vector<const Model *> inserts;
+        for (const auto &entity : newEntities_)
+            inserts.push_back(entity.get());
+
+        std::vector<const Model *> deletes;
+        for (const auto &entity : deletedEntities_)
+            deletes.push_back(entity.get());
+
+        auto tableOfModel = [](const Model *model)
+        { return model->getTableName(); };
+        auto tableOfChange = [](const std::pair<const Model *, std::vector<std::string>> &change)
+        { return change.first->getTableName(); };
+
+        if (!adapter_.beginTransaction())
+        {
+            lastError_ = adapter_.getLastError();
+            return false;
+        }
+
+        bool success = true;
+        // auto increment keys generated for new models, set once the transaction commits
+        std::vector<std::pair<Model *, std::string>> generatedKeys;
+        for (const auto &group : groupByTable(inserts, tableOfModel))
+        {
+            if (!(success = insertGroup(group, generatedKeys)))
+                break;
+        }
+        if (success)
+        {
+            for (const auto &group : groupByTable(dirty, tableOfChange))
+            {
+                if (!(success = adapter_.updateRecords(group, batchSize_)))
+                    break;
+            }
+        }
+        if (success)
+        {
+            for (const auto &group : groupByTable(deletes, tableOfModel))
+            {
+                if (!(success = adapter_.deleteRecords(group, batchSize_)))
+                    break;
+            }
+        }
+
+        if (!success || !adapter_.commitTransaction())
+        {
+            lastError_ = adapter_.getLastError();
+            adapter_.rollbackTransaction();
+            return false;
+        }
+
+        // The database now matches the in-memory state
+        for (const auto &entity : deletedEntities_)
+        {
+            identityMap_.erase(identityKey(*entity));
+        }
+        for (auto &[key, entry] : identityMap_)
+        {
+            entry.snapshot = takeSnapshot(*entry.entity);
+        }
+        for (auto &[model, id] : generatedKeys)
+        {
+            model->setFieldValue(primaryKeyField(*model)->getName(), id);
+        }
+        for (const auto &entity : newEntities_)
+        {
+            std::string key = identityKey(*entity);
+            if (!key.empty())
+                identityMap_[key] = Entry{entity, takeSnapshot(*entity)};
+        }
+        newEntities_.clear();
+        deletedEntities_.clear();
+        return true;
+    }
+
+    void MySQLUnitOfWork::clear()
+    {
+        identityMap_.clear();
+        newEntities_.clear();
+        deletedEntities_.clear();
+        lastError_.clear();
+    }
+}
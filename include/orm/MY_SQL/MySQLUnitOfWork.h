@@ -0,0 +1,141 @@
+// include/orm/MySQLUnitOfWork.h
+#pragma once
+#include "MySQLAdapter.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace ORM
+{
+    /**
+     * @class MySQLUnitOfWork
+     * @brief Collects new, dirty and deleted models and writes them in one transaction.
+     *
+     * Models loaded through find() are kept in an identity map so the same primary
+     * key is only fetched once per unit of work. A snapshot of the loaded values is
+     * taken so flush() only sends the columns that actually changed.
+     *
+     * flush() emits grouped multi-row INSERTs per table, CASE based batched UPDATEs
+     * and DELETE ... WHERE pk IN (...) statements, chunked by batchSize.
+     */
+    class MySQLUnitOfWork
+    {
+    public:
+        explicit MySQLUnitOfWork(MySQLAdapter &adapter, size_t batchSize = 500);
+
+        /**
+         * Load a model by primary key through the identity map.
+         *
+         * @param id The primary key value
+         * @return The tracked model, or nullptr if no row was found or it is scheduled for deletion
+         */
+        template <typename ModelType>
+        std::shared_ptr<ModelType> find(const std::string &id);
+
+        /**
+         * Schedule a new model for insertion on flush. Auto increment keys generated
+         * by the INSERT are set on the model, which is then tracked like a loaded one.
+         * With innodb_autoinc_lock_mode = 2 (the MySQL 8 default) keys of a multi-row
+         * INSERT may not be consecutive, so such models are inserted one row at a time.
+         */
+        void registerNew(const std::shared_ptr<Model> &entity);
+
+        /**
+         * Track a model that was not loaded through find(). All its non-empty
+         * fields are written on flush. Models from find() are tracked automatically.
+         */
+        void registerDirty(const std::shared_ptr<Model> &entity);
+
+        /**
+         * Schedule a model for deletion on flush.
+         */
+        void registerDeleted(const std::shared_ptr<Model> &entity);
+
+        /**
+         * Write all pending changes in a single transaction.
+         *
+         * @return True on success, false after rolling back (see getLastError)
+         */
+        bool flush();
+
+        /**
+         * Forget all tracked models and pending changes.
+         */
+        void clear();
+
+        std::string getLastError() const { return lastError_; }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<Model> entity;
+            std::unordered_map<std::string, std::string> snapshot; /**< Field values as last read/written */
+        };
+
+        /// Server settings deciding how generated keys are read back, queried once per unit of work
+        struct AutoIncrement
+        {
+            unsigned long long increment = 1; /**< @@auto_increment_increment */
+            bool consecutive = false;         /**< Whether a multi-row INSERT gets consecutive keys */
+        };
+
+        MySQLAdapter &adapter_;
+        size_t batchSize_;
+        std::string lastError_;
+        std::optional<AutoIncrement> autoIncrement_;
+
+        std::map<std::string, Entry> identityMap_; /**< "table:pk" -> tracked model */
+        std::vector<std::shared_ptr<Model>> newEntities_;
+        std::vector<std::shared_ptr<Model>> deletedEntities_;
+
+        static std::string identityKey(const Model &model);
+        static std::string identityKey(const std::string &tableName, const std::string &id);
+        static std::unordered_map<std::string, std::string> takeSnapshot(const Model &model);
+        bool isDeleted(const Model &model) const;
+        bool isDeleted(const std::string &key) const;
+        // inserts the new models of one table, reading back generated auto increment keys
+        bool insertGroup(const std::vector<const Model *> &group, std::vector<std::pair<Model *, std::string>> &generatedKeys);
+    };
+
+    template <typename ModelType>
+    std::shared_ptr<ModelType> MySQLUnitOfWork::find(const std::string &id)
+    {
+        auto entity = std::make_shared<ModelType>();
+        std::string key = identityKey(entity->getTableName(), id);
+
+        // a row scheduled for deletion is gone as far as this unit of work is concerned
+        if (isDeleted(key))
+        {
+            lastError_ = key + " is scheduled for deletion";
+            return nullptr;
+        }
+
+        auto it = identityMap_.find(key);
+        if (it != identityMap_.end())
+        {
+            return std::dynamic_pointer_cast<ModelType>(it->second.entity);
+        }
+
+        auto row = adapter_.findById<ModelType>(id);
+        if (row.empty())
+        {
+            lastError_ = adapter_.getLastError();
+            return nullptr;
+        }
+
+        for (const auto &field : entity->getFields())
+        {
+            auto value = row.find(field->getName());
+            // fetchAllFromQuery renders SQL NULL as "NULL", models use empty values
+            if (value != row.end() && value->second != "NULL")
+            {
+                entity->setFieldValue(field->getName(), value->second);
+            }
+        }
+
+        identityMap_[key] = Entry{entity, takeSnapshot(*entity)};
+        return entity;
+    }
+}
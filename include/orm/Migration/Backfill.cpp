@@ -0,0 +1,94 @@
+#include "Backfill.h"
+#include "KeyRangeChunks.h"
+#include "MigrationManager.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace ORM
+{
+    Backfill::Backfill(DatabaseAdapter &adapter, std::string name, BackfillOptions options)
+        : adapter_(adapter), name_(std::move(name)), options_(std::move(options))
+    {
+        if (options_.batchSize == 0)
+            options_.batchSize = 1;
+    }
+
+    void Backfill::update(const std::string &tableName, const std::string &assignments, const std::string &where)
+    {
+        std::string sql = "UPDATE " + tableName + " SET " + assignments + " WHERE ";
+        std::string filter = where.empty() ? "" : " AND (" + where + ")";
+
+        forEachChunk(tableName, [&](const std::string &range, const std::vector<std::string> &params)
+                     { execute(sql + range + filter, params); });
+    }
+
+    void Backfill::forEachChunk(const std::string &tableName,
+                                const std::function<void(const std::string &range, const std::vector<std::string> &params)> &apply)
+    {
+        ensureCheckpointTable();
+        auto checkpoint = adapter_.executeQuery(
+            "SELECT table_name, last_key, max_key, chunks, is_done FROM migration_backfills WHERE name = ?", {name_});
+
+        if (!checkpoint.empty() && checkpoint[0]["table_name"] != tableName)
+            throw std::runtime_error("Backfill " + name_ + " was started on table " + checkpoint[0]["table_name"]);
+        if (!checkpoint.empty() && checkpoint[0]["is_done"] == "1")
+            return;
+
+        std::string key = MigrationManager::getPrimaryKey(adapter_, tableName);
+        if (key.empty())
+            throw std::runtime_error("Backfill " + name_ + ": " + tableName + " needs a single column primary key");
+
+        if (checkpoint.empty())
+        {
+            auto last = adapter_.executeQuery("SELECT " + key + " AS max_key FROM " + tableName + " ORDER BY " + key + " DESC LIMIT 1", {});
+            execute("INSERT INTO migration_backfills (name, table_name, max_key, is_done) VALUES (?, ?, ?, ?)",
+                    {name_, tableName, last.empty() ? "" : last[0]["max_key"], last.empty() ? "1" : "0"});
+            if (last.empty())
+                return; // empty table
+            checkpoint = adapter_.executeQuery(
+                "SELECT table_name, last_key, max_key, chunks, is_done FROM migration_backfills WHERE name = ?", {name_});
+            if (checkpoint.empty())
+                throw std::runtime_error("Backfill " + name_ + ": checkpoint not found");
+        }
+        else
+        {
+            std::cerr << "Backfill " << name_ << ": resuming after " << checkpoint[0]["chunks"] << " chunks" << std::endl;
+        }
+
+        KeyRangeChunks chunks(adapter_, tableName, key, options_.batchSize, options_, "Backfill " + name_, options_.pause);
+        chunks.run(std::stoll(checkpoint[0]["chunks"]) > 0, checkpoint[0]["last_key"], checkpoint[0]["max_key"], apply,
+                   [&](const std::string &chunkEnd, bool done)
+                   {
+                       execute("UPDATE migration_backfills SET last_key = ?, chunks = chunks + 1, is_done = ? WHERE name = ?",
+                               {chunkEnd, done ? "1" : "0", name_});
+                   });
+    }
+
+    void Backfill::reset()
+    {
+        ensureCheckpointTable();
+        execute("DELETE FROM migration_backfills WHERE name = ?", {name_});
+    }
+
+    void Backfill::ensureCheckpointTable()
+    {
+        execute(R"(
+            CREATE TABLE IF NOT EXISTS migration_backfills (
+                name VARCHAR(191) PRIMARY KEY,
+                table_name VARCHAR(64) NOT NULL,
+                last_key VARCHAR(255) NOT NULL DEFAULT '',
+                max_key VARCHAR(255) NOT NULL DEFAULT '',
+                chunks BIGINT NOT NULL DEFAULT 0,
+                is_done BOOLEAN NOT NULL DEFAULT 0,
+                updated_at DATETIME DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP
+            )
+        )");
+    }
+
+    void Backfill::execute(const std::string &sql, const std::vector<std::string> &params)
+    {
+        if (!adapter_.executeRawQuery(sql, params))
+            throw std::runtime_error("Backfill " + name_ + " failed: " + adapter_.getLastError() + "\n" + sql);
+    }
+}
@@ -0,0 +1,86 @@
+// include/orm/Migration/Backfill.h
+#pragma once
+#include "DatabaseTypes.h"
+#include "LoadThrottle.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ORM
+{
+    /**
+     * @struct BackfillOptions
+     * @brief Chunk size and pacing of a Backfill
+     */
+    struct BackfillOptions : ThrottleOptions
+    {
+        size_t batchSize = 1000;            /**< Rows per chunk */
+        std::chrono::milliseconds pause{0}; /**< Sleep after every chunk, on top of load throttling */
+    };
+
+    /**
+     * @class Backfill
+     * @brief Resumable, chunked data migration over a table, for MigrationInterface::up().
+     *
+     * The table is walked in primary key ranges of batchSize rows, each range is
+     * updated in its own statement so locks and undo stay small, and the work pauses
+     * while replicas lag or the server is busy (see LoadThrottle).
+     *
+     * Progress is checkpointed per job name in the migration_backfills table, in
+     * the transaction of every chunk (see KeyRangeChunks): running the job again
+     * continues after the last committed chunk, and does nothing once the job
+     * completed. A chunk interrupted by a crash was rolled back and runs again.
+     *
+     * Rows are visited up to the largest key present when the job first started,
+     * rows inserted later are expected to be written complete by the application.
+     * The table needs a single column primary key.
+     *
+     * @example
+     * void up(ORM::DatabaseAdapter &adapter) override {
+     *     adapter.executeRawQuery("ALTER TABLE users ADD COLUMN display_name VARCHAR(100)", {});
+     *     ORM::Backfill(adapter, "users_display_name").update("users", "display_name = CONCAT(first_name, ' ', last_name)");
+     * }
+     */
+    class Backfill
+    {
+    public:
+        /**
+         * @param name Identifies the job and its checkpoint, unique per data migration
+         */
+        Backfill(DatabaseAdapter &adapter, std::string name, BackfillOptions options = {});
+
+        /**
+         * Run UPDATE tableName SET assignments chunk by chunk.
+         *
+         * @param assignments SET list, e.g. "status = 'active'"
+         * @param where Optional extra condition, e.g. "status IS NULL"
+         * @throws std::runtime_error if an UPDATE fails or the table has no usable primary key
+         */
+        void update(const std::string &tableName, const std::string &assignments, const std::string &where = "");
+
+        /**
+         * Call apply for every chunk of tableName, in primary key order.
+         *
+         * @param apply Receives a condition selecting the chunk (with ? placeholders)
+         *              and the values to bind, for custom per chunk statements. They run
+         *              in the chunk's transaction, so no DDL. It should throw to stop the
+         *              job, the chunk is then rolled back and runs again next time.
+         */
+        void forEachChunk(const std::string &tableName,
+                          const std::function<void(const std::string &range, const std::vector<std::string> &params)> &apply);
+
+        /**
+         * Delete the checkpoint, the next run starts over from the first row.
+         */
+        void reset();
+
+    private:
+        DatabaseAdapter &adapter_;
+        std::string name_;
+        BackfillOptions options_;
+
+        void ensureCheckpointTable();
+        void execute(const std::string &sql, const std::vector<std::string> &params = {});
+    };
+}
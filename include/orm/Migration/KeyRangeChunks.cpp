@@ -0,0 +1,59 @@
+#include "KeyRangeChunks.h"
+
+#include <stdexcept>
+#include <thread>
+
+namespace ORM
+{
+    KeyRangeChunks::KeyRangeChunks(DatabaseAdapter &adapter, std::string tableName, std::string key, size_t chunkSize,
+                                   const ThrottleOptions &throttle, std::string label, std::chrono::milliseconds pause)
+        : adapter_(adapter), tableName_(std::move(tableName)), key_(std::move(key)), chunkSize_(chunkSize > 0 ? chunkSize : 1),
+          throttle_(adapter, throttle, label), label_(std::move(label)), pause_(pause) {}
+
+    void KeyRangeChunks::run(bool started, const std::string &lastKey, const std::string &maxKey, const Apply &apply, const Checkpoint &checkpoint)
+    {
+        std::string chunkStart = lastKey;
+        while (true)
+        {
+            throttle_.wait();
+
+            // the first chunk has no lower bound
+            std::string range = started ? key_ + " > ? AND " + key_ + " <= ?" : key_ + " <= ?";
+            std::vector<std::string> params = started ? std::vector<std::string>{chunkStart, maxKey} : std::vector<std::string>{maxKey};
+
+            auto end = adapter_.executeQuery("SELECT " + key_ + " AS chunk_end FROM " + tableName_ + " WHERE " + range +
+                                                 " ORDER BY " + key_ + " LIMIT 1 OFFSET " + std::to_string(chunkSize_ - 1),
+                                             params);
+            bool last = end.empty();
+            params.back() = last ? maxKey : end[0]["chunk_end"];
+
+            // the checkpoint only ever covers chunks whose changes are committed
+            execute("START TRANSACTION");
+            try
+            {
+                apply(range, params);
+                checkpoint(params.back(), last);
+            }
+            catch (...)
+            {
+                adapter_.executeRawQuery("ROLLBACK", {});
+                throw;
+            }
+            execute("COMMIT");
+
+            if (last)
+                return;
+            chunkStart = params.back();
+            started = true;
+
+            if (pause_.count() > 0)
+                std::this_thread::sleep_for(pause_);
+        }
+    }
+
+    void KeyRangeChunks::execute(const std::string &sql)
+    {
+        if (!adapter_.executeRawQuery(sql, {}))
+            throw std::runtime_error(label_ + " failed: " + adapter_.getLastError() + "\n" + sql);
+    }
+}
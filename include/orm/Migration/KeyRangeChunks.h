@@ -0,0 +1,59 @@
+// include/orm/Migration/KeyRangeChunks.h
+#pragma once
+#include "DatabaseTypes.h"
+#include "LoadThrottle.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ORM
+{
+    /**
+     * @class KeyRangeChunks
+     * @brief Walks a table in primary key ranges of chunkSize rows, for Backfill and OnlineSchemaChange.
+     *
+     * Each range ends at the key chunkSize rows after the previous one, the last
+     * one at maxKey. The statements of a chunk and its checkpoint run in one
+     * transaction: a chunk interrupted by a crash or an error leaves neither, and
+     * runs again in full when the walk resumes from the checkpoint. Work pauses
+     * before every chunk while replicas lag or the server is busy (see LoadThrottle).
+     */
+    class KeyRangeChunks
+    {
+    public:
+        /// Receives a condition selecting the chunk (with ? placeholders) and the values to bind
+        using Apply = std::function<void(const std::string &range, const std::vector<std::string> &params)>;
+        /// Records chunkEnd as the last finished key, done is set for the last chunk
+        using Checkpoint = std::function<void(const std::string &chunkEnd, bool done)>;
+
+        /**
+         * @param key Single column primary key of tableName
+         * @param label Prefix of the log lines, e.g. "Backfill users_display_name"
+         * @param pause Sleep after every chunk, on top of load throttling
+         */
+        KeyRangeChunks(DatabaseAdapter &adapter, std::string tableName, std::string key, size_t chunkSize,
+                       const ThrottleOptions &throttle, std::string label, std::chrono::milliseconds pause = {});
+
+        /**
+         * Run every chunk after lastKey up to maxKey.
+         *
+         * @param started Whether a chunk finished already, lastKey is ignored if not
+         * @param lastKey Last key of the last finished chunk
+         * @param apply Statements of a chunk, must not commit implicitly (no DDL)
+         * @throws std::runtime_error if a statement fails, after rolling the chunk back
+         */
+        void run(bool started, const std::string &lastKey, const std::string &maxKey, const Apply &apply, const Checkpoint &checkpoint);
+
+    private:
+        DatabaseAdapter &adapter_;
+        std::string tableName_;
+        std::string key_;
+        size_t chunkSize_;
+        LoadThrottle throttle_;
+        std::string label_;
+        std::chrono::milliseconds pause_;
+
+        void execute(const std::string &sql);
+    };
+}
@@ -0,0 +1,66 @@
+#include "LoadThrottle.h"
+
+#include <iostream>
+#include <thread>
+
+namespace ORM
+{
+    LoadThrottle::LoadThrottle(DatabaseAdapter &adapter, const ThrottleOptions &options, std::string label)
+        : adapter_(adapter), options_(options), label_(std::move(label)) {}
+
+    void LoadThrottle::wait()
+    {
+        bool paused = false;
+        while (true)
+        {
+            std::string reason = overloadReason();
+            if (reason.empty())
+                break;
+            if (!paused)
+                std::cerr << label_ << ": pausing, " << reason << std::endl;
+            paused = true;
+            std::this_thread::sleep_for(options_.throttleInterval);
+        }
+        if (paused)
+            std::cerr << label_ << ": resuming" << std::endl;
+    }
+
+    std::string LoadThrottle::overloadReason()
+    {
+        for (DatabaseAdapter *replica : options_.replicas)
+        {
+            double lag = replicationLag(*replica);
+            if (lag < 0)
+                return "replication is stopped on a replica";
+            if (lag > options_.maxReplicationLag)
+                return "a replica is " + std::to_string(lag) + "s behind";
+        }
+
+        if (options_.maxThreadsRunning > 0)
+        {
+            auto status = adapter_.executeQuery(
+                "SELECT VARIABLE_VALUE FROM performance_schema.global_status WHERE VARIABLE_NAME = 'Threads_running'", {});
+            if (!status.empty() && std::stoi(status[0]["VARIABLE_VALUE"]) > options_.maxThreadsRunning)
+                return "Threads_running is " + status[0]["VARIABLE_VALUE"];
+        }
+        return "";
+    }
+
+    double LoadThrottle::replicationLag(DatabaseAdapter &replica)
+    {
+        // SHOW SLAVE STATUS for servers before 8.0.22
+        auto status = replica.executeQuery("SHOW REPLICA STATUS", {});
+        if (status.empty())
+            status = replica.executeQuery("SHOW SLAVE STATUS", {});
+        if (status.empty())
+            return 0; // not a replica
+
+        auto lag = status[0].find("Seconds_Behind_Source");
+        if (lag == status[0].end())
+            lag = status[0].find("Seconds_Behind_Master");
+        // NULL while the replication threads are stopped
+        if (lag == status[0].end() || lag->second.empty() || lag->second == "NULL")
+            return -1;
+        return std::stod(lag->second);
+    }
+}
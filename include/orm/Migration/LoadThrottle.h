@@ -0,0 +1,52 @@
+// include/orm/Migration/LoadThrottle.h
+#pragma once
+#include "DatabaseTypes.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace ORM
+{
+    /**
+     * @struct ThrottleOptions
+     * @brief When long running batch work (online schema changes, backfills) pauses
+     */
+    struct ThrottleOptions
+    {
+        double maxReplicationLag = 1.0;                  /**< Seconds, work pauses while a replica lags more */
+        int maxThreadsRunning = 25;                      /**< Work pauses while Threads_running is higher, 0 to ignore */
+        std::chrono::milliseconds throttleInterval{500}; /**< Sleep between load checks while paused */
+        std::vector<DatabaseAdapter *> replicas;         /**< Connections to the replicas whose lag is watched */
+    };
+
+    /**
+     * @class LoadThrottle
+     * @brief Blocks batch work while replicas lag behind or the primary is busy.
+     *
+     * Call wait() before every batch. Lag is read from SHOW REPLICA STATUS on each
+     * replica (SHOW SLAVE STATUS before MySQL 8.0.22), load from Threads_running
+     * in performance_schema.global_status on the primary.
+     */
+    class LoadThrottle
+    {
+    public:
+        /**
+         * @param adapter Connection to the primary
+         * @param label Prefix of the log lines, e.g. "Online schema change"
+         */
+        LoadThrottle(DatabaseAdapter &adapter, const ThrottleOptions &options, std::string label);
+
+        /**
+         * Return once neither replication lag nor load is above its limit.
+         */
+        void wait();
+
+    private:
+        DatabaseAdapter &adapter_;
+        const ThrottleOptions &options_;
+        std::string label_;
+
+        std::string overloadReason();
+        double replicationLag(DatabaseAdapter &replica);
+    };
+}
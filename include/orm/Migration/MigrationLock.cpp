@@ -0,0 +1,36 @@
+#include "MigrationLock.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace ORM
+{
+    MigrationLock::MigrationLock(DatabaseAdapter &adapter, std::chrono::seconds timeout, std::string name)
+        : adapter_(adapter), name_(std::move(name))
+    {
+        std::string acquired = getLock(std::chrono::seconds(0));
+        if (acquired == "0")
+        {
+            std::cerr << "Migration lock " << name_ << " is held by another instance, waiting" << std::endl;
+            acquired = getLock(timeout);
+            if (acquired == "0")
+                throw std::runtime_error("Timed out after " + std::to_string(timeout.count()) +
+                                         "s waiting for migration lock " + name_);
+        }
+        if (acquired != "1")
+            throw std::runtime_error("Failed to acquire migration lock " + name_ + ": " + adapter_.getLastError());
+    }
+
+    MigrationLock::~MigrationLock()
+    {
+        auto released = adapter_.executeQuery("SELECT RELEASE_LOCK(?) AS released", {name_});
+        if (released.empty() || released[0]["released"] != "1")
+            std::cerr << "Failed to release migration lock " << name_ << std::endl;
+    }
+
+    std::string MigrationLock::getLock(std::chrono::seconds timeout)
+    {
+        auto result = adapter_.executeQuery("SELECT GET_LOCK(?, ?) AS acquired", {name_, std::to_string(timeout.count())});
+        return result.empty() ? "" : result[0]["acquired"];
+    }
+}
@@ -0,0 +1,48 @@
+// include/orm/Migration/MigrationLock.h
+#pragma once
+#include "DatabaseTypes.h"
+#include <chrono>
+#include <string>
+
+namespace ORM
+{
+    /**
+     * @class MigrationLock
+     * @brief Named MySQL lock (GET_LOCK) held for the lifetime of the object.
+     *
+     * Serializes migrations between all processes using the same database, so when
+     * many instances start at once only one of them runs the DDL. The others block
+     * inside GET_LOCK on the server, without polling. MySQL releases the lock if the
+     * holding connection dies, so a crashed instance never leaves it behind.
+     *
+     * The lock belongs to the adapter's connection: keep that connection open and
+     * don't share it with other threads while the lock is held.
+     *
+     * @example
+     * {
+     *     ORM::MigrationLock lock(adapter, std::chrono::seconds(600));
+     *     // migrate
+     * } // released here
+     */
+    class MigrationLock
+    {
+    public:
+        /**
+         * Acquire the lock, waiting up to timeout for another holder to release it.
+         *
+         * @throws std::runtime_error on timeout or if GET_LOCK fails
+         */
+        MigrationLock(DatabaseAdapter &adapter, std::chrono::seconds timeout, std::string name = "orm_migrations");
+        ~MigrationLock();
+
+        MigrationLock(const MigrationLock &) = delete;
+        MigrationLock &operator=(const MigrationLock &) = delete;
+
+    private:
+        DatabaseAdapter &adapter_;
+        std::string name_;
+
+        // GET_LOCK result: "1" acquired, "0" timed out, "" (NULL) on error
+        std::string getLock(std::chrono::seconds timeout);
+    };
+}
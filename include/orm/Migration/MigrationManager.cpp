@@ -1,8 +1,10 @@
 #include "MigrationManager.h"
+#include "SqlMigration.h"
 
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <chrono>
 
@@ -11,14 +13,62 @@ namespace ORM
     namespace fs = std::filesystem;
 
     std::unordered_map<std::string, std::function<std::unique_ptr<MigrationInterface>()>> MigrationManager::migrationRegistry;
+    std::optional<OnlineSchemaChangeOptions> MigrationManager::onlineSchemaChange;
+    std::unordered_map<std::string, std::string> MigrationManager::migrationFiles;
+    std::chrono::seconds MigrationManager::lockTimeout{600};
+    std::optional<MigrationCostOptions> MigrationManager::rebuildLimits;
+
+    namespace
+    {
+        // server errors meaning the requested ALGORITHM can't be used, the ALTER itself may still work
+        constexpr unsigned int ALTER_ALGORITHM_NOT_SUPPORTED = 1845;        // ER_ALTER_OPERATION_NOT_SUPPORTED
+        constexpr unsigned int ALTER_ALGORITHM_NOT_SUPPORTED_REASON = 1846; // ER_ALTER_OPERATION_NOT_SUPPORTED_REASON
+        constexpr unsigned int ALTER_ALGORITHM_UNKNOWN = 1800;              // ER_UNKNOWN_ALTER_ALGORITHM, INSTANT before 8.0.12
+
+        bool isAlgorithmNotSupported(unsigned int errorCode)
+        {
+            return errorCode == ALTER_ALGORITHM_NOT_SUPPORTED || errorCode == ALTER_ALGORITHM_NOT_SUPPORTED_REASON ||
+                   errorCode == ALTER_ALGORITHM_UNKNOWN;
+        }
+
+        const std::string ALTER_TABLE_PREFIX = "ALTER TABLE ";
+        const std::string COPY_SUFFIX = ", ALGORITHM=COPY"; // appended by AlterPlan::statement(COPY)
+
+        std::string upper(std::string text)
+        {
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                           { return std::toupper(c); });
+            return text;
+        }
+
+        bool endsWith(const std::string &text, const std::string &suffix)
+        {
+            return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+    }
 
     void MigrationManager::intialize(DatabaseAdapter &adapter)
     {
-        ensureMigrationTable(adapter);
+        {
+            MigrationLock lock(adapter, lockTimeout);
+            ensureMigrationTable(adapter);
+        }
 
         // create migrations/ fireactory if it dosent exists
         if (!fs::exists("migrations"))
             fs::create_directory("migrations");
+
+        // only the names are indexed, a file is read when its migration is applied
+        for (const auto &entry : fs::directory_iterator("migrations"))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".sql")
+                migrationFiles[entry.path().stem().string()] = entry.path().string();
+        }
+    }
+
+    void MigrationManager::setLockTimeout(std::chrono::seconds timeout)
+    {
+        lockTimeout = timeout;
     }
 
     void MigrationManager::registerMigration(const std::string &version, std::function<std::unique_ptr<MigrationInterface>()> creator)
@@ -28,10 +78,57 @@ namespace ORM
 
     void MigrationManager::migrateModel(DatabaseAdapter &adapter, const Model &model)
     {
-        std::string tableName = model.getTableName();
-        std::string schemaHash = claculateSchemaHash(model);
         JSON schemaJSON = generateSchemaJSON(model);
+        std::string schemaHash = claculateSchemaHash(schemaJSON);
+        // the last migration is read under the lock, after any other instance finished
+        MigrationLock lock(adapter, lockTimeout);
+        migrateModel(adapter, model, schemaJSON, schemaHash);
+    }
+
+    void MigrationManager::migrateAll(DatabaseAdapter &adapter)
+    {
+        struct Pending
+        {
+            std::unique_ptr<Model> model;
+            JSON schemaJSON;
+            std::string schemaHash;
+        };
+
+        std::unordered_map<std::string, std::string> currentHashes = getCurrentHashes(adapter);
+        std::vector<Pending> pending;
+        for (ModelRegistry::ModelFactory create : ModelRegistry::getModels())
+        {
+            std::unique_ptr<Model> model = create();
+            JSON schemaJSON = generateSchemaJSON(*model);
+            std::string schemaHash = claculateSchemaHash(schemaJSON);
+
+            auto current = currentHashes.find(model->getTableName());
+            if (current != currentHashes.end() && current->second == schemaHash)
+                continue; // up to date
+
+            pending.push_back(Pending{std::move(model), std::move(schemaJSON), std::move(schemaHash)});
+        }
+        if (pending.empty())
+            return;
+
+        MigrationLock lock(adapter, lockTimeout);
+        // another instance may have migrated while we waited
+        currentHashes = getCurrentHashes(adapter);
+        for (Pending &model : pending)
+        {
+            auto current = currentHashes.find(model.model->getTableName());
+            if (current != currentHashes.end() && current->second == model.schemaHash)
+                continue;
 
+            migrateModel(adapter, *model.model, model.schemaJSON, model.schemaHash);
+        }
+    }
+
+    void MigrationManager::migrateModel(DatabaseAdapter &adapter, const Model &model, const JSON &schemaJSON, const std::string &schemaHash)
+    {
+        std::string tableName = model.getTableName();
+
+        resolveInterruptedMigrations(adapter, tableName);
         JSON lastMigration = getLastMigration(adapter, tableName);
 
         if (lastMigration.isNULL()) // first migration of the model
@@ -40,66 +137,65 @@ namespace ORM
             std::vector<std::string> upSql = {adapter.getCreateTableSTring(model)};
             std::vector<std::string> downSql = {"DROP TABLE " + tableName};
 
-            createMigrationFile(version + "_create_" + tableName, upSql, downSql);
-            adapter.createTable(model);
+            // recorded first: a record that can't be written fails the migration before any DDL
             createMigrationRecord(adapter, tableName, schemaHash, schemaJSON, version);
+            try
+            {
+                createMigrationFile(version + "_create_" + tableName, upSql, downSql);
+                if (!adapter.createTable(model))
+                    throw std::runtime_error("Failed to create table " + tableName + ": " + adapter.getLastError());
+            }
+            catch (...)
+            {
+                discardMigrationRecord(adapter, tableName, version);
+                throw;
+            }
+            markMigrationApplied(adapter, tableName, version);
         }
         else if (lastMigration["schema_hash"].get<std::string>() != schemaHash) // schema has changed need migration
         {
             JSON old_schema = parseSchemaJSON(lastMigration["schema_json"].get<std::string>());
+            AlterPlan plan = planSchemaChange(model, old_schema);
+
+            // the hash also moves when only the recorded form of the schema does (e.g. number formatting),
+            // that's no migration: the current record takes the new hash
+            if (plan.empty())
+            {
+                refreshMigrationRecord(adapter, tableName, lastMigration["version"].get<std::string>(), schemaHash, schemaJSON);
+                return;
+            }
 
             std::string version = generateVersionNumber();
             std::string migrationName = version + "_after_" + tableName;
 
-            // already generated upsql and downsql when create schema
-            std::vector<std::string> upsql;
-            std::vector<std::string> downsql;
-
-            // compare schema and genearet alter statements
-            compareAndUpdateSchema(adapter, model, old_schema, upsql, downsql);
-
-            createMigrationFile(migrationName, upsql, downsql);
-
             createMigrationRecord(adapter, tableName, schemaHash, schemaJSON, version);
+            try
+            {
+                // written before the ALTER too, so a migration recovered after a crash has its file
+                createMigrationFile(migrationName, {plan.statement(plan.algorithm())}, {plan.undoStatement()});
+
+                // then again with the statements that ran (algorithm retries, online changes)
+                std::vector<std::string> upsql;
+                std::vector<std::string> downsql;
+                applyAlterPlan(adapter, plan, upsql, downsql);
+                createMigrationFile(migrationName, upsql, downsql);
+            }
+            catch (...)
+            {
+                discardMigrationRecord(adapter, tableName, version);
+                throw;
+            }
+            markMigrationApplied(adapter, tableName, version);
         }
     }
 
     // Create migration file
     void MigrationManager::createMigrationFile(const std::string &name, const std::vector<std::string> &upSql, const std::vector<std::string> &downSql)
     {
-        std::ofstream file("migrations/" + name + ".cpp");
-
-        file << "#include \"MigrationManager.h\"\n";
-        file << "#include \"DatabaseTypes.h\"\n\n";
-
-        file << "using namespace ORM;\n\n";
-
-        file << "class Migration_" << name << " : public ORM::MigrationInterface {\n";
-        file << "public:\n";
-
-        file << "     void up(ORM::DatabaseAdapter &adapter) override { \n";
-        for (const auto &sql : upSql)
-        {
-            file << "         adapter.executeRawQuery(\"" << sql << "\",{});\n";
-        }
-        file << "     }\n\n";
-
-        file << "      void down(ORM::DatabaseAdapter &adapter) override { \n";
-        for (const auto &sql : downSql)
-        {
-            file << "         adapter.executeRawQuery(\"" << sql << "\",{});\n";
-        }
-        file << "     }\n";
-
-        file << "};\n\n";
-
-        // auto-register in registry
-        file << "static bool registered = [] {\n";
-        file << "     MigrationManager::registerMigration(\"" << name << "\",[]{\n";
-        file << "           return std::make_unique<Migration_" << name << ">();\n";
-        file << "     });\n";
-        file << "     return true;\n";
-        file << "}();\n";
+        fs::create_directories("migrations");
+        std::string path = "migrations/" + name + ".sql";
+        SqlMigration::write(path, name, upSql, downSql);
+        migrationFiles[name] = path;
     }
 
     std::string MigrationManager::getCurrentVersion(DatabaseAdapter &adapter, const std::string &modelName)
@@ -115,30 +211,35 @@ namespace ORM
 
         // If no current version marked, get the last applied version
         result = adapter.executeQuery(
-            "SELECT version FROM migrations WHERE model_name = ? AND is_applied = 1 ORDER BY applied_at DESC LIMIT 1",
+            "SELECT version FROM migrations WHERE model_name = ? AND is_applied = 1 ORDER BY applied_at DESC, id DESC LIMIT 1",
             {modelName});
 
         return result.empty() ? "" : result[0]["version"];
     }
 
-    std::string MigrationManager::claculateSchemaHash(const Model &model)
+    std::string MigrationManager::claculateSchemaHash(const JSON &schemaJSON)
     {
-        std::ostringstream schemaStream;
-        schemaStream << JSON::stringify(generateSchemaJSON(model));
+        return sha1Hex(JSON::stringify(schemaJSON));
+    }
 
-        std::string schemaString = schemaStream.str();
+    std::string MigrationManager::sha1Hex(const std::string &data)
+    {
         unsigned char hash[SHA_DIGEST_LENGTH];
-        SHA1(reinterpret_cast<const unsigned char *>(schemaString.c_str()), schemaString.length(), hash);
+        SHA1(reinterpret_cast<const unsigned char *>(data.data()), data.length(), hash);
 
-        std::ostringstream hashStream;
+        static const char hexDigits[] = "0123456789abcdef";
+        std::string hex(SHA_DIGEST_LENGTH * 2, '0');
         for (size_t i = 0; i < SHA_DIGEST_LENGTH; i++)
-            hashStream << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-        return hashStream.str();
+        {
+            hex[2 * i] = hexDigits[hash[i] >> 4];
+            hex[2 * i + 1] = hexDigits[hash[i] & 0x0f];
+        }
+        return hex;
     }
 
     JSON MigrationManager::generateSchemaJSON(const Model &model)
     {
-        JSON schema(JSONType::ARRAY);
+        JSON fields(JSONType::ARRAY);
 
         for (const auto &field : model.getFields())
         {
@@ -161,19 +262,51 @@ namespace ORM
             fieldJson["nullable"] = JSON(opt.nullable);
             fieldJson["unique"] = JSON(opt.unique);
 
-            schema.appendArray(fieldJson);
+            fields.appendArray(std::move(fieldJson));
         }
+
+        JSON indexes(JSONType::ARRAY);
+        for (const auto &index : model.collectIndexes())
+        {
+            JSON indexJson(JSONType::OBJECT);
+            indexJson["name"] = JSON(index.name);
+            JSON columns(JSONType::ARRAY);
+            for (const auto &column : index.columns)
+            {
+                columns.appendArray(JSON(column.toString()));
+            }
+            indexJson["columns"] = std::move(columns);
+            indexJson["unique"] = JSON(index.unique);
+            indexes.appendArray(std::move(indexJson));
+        }
+
+        JSON schema(JSONType::OBJECT);
+        schema["fields"] = std::move(fields);
+        schema["indexes"] = std::move(indexes);
         return schema;
     }
 
-    JSON MigrationManager::parseSchemaJSON(const std::string &jsonStr)
+    JSON MigrationManager::parseSchemaJSON(const std::string &jsonStr, bool lazy)
     {
         try
         {
-            JSON parsed = JSON::parse(jsonStr);
-            if (!parsed.isArray())
+            JSON parsed = lazy ? JSON::parseLazy(jsonStr) : JSON::parse(jsonStr);
+
+            // schemas recorded before index support are a bare array of fields
+            if (parsed.isArray())
             {
-                throw std::runtime_error("Schema JSON should be an array of field definitions");
+                JSON schema(JSONType::OBJECT);
+                schema["fields"] = parsed;
+                schema["indexes"] = JSON(JSONType::ARRAY);
+                return schema;
+            }
+            if (!parsed.isObject() || !parsed.contains("fields") || !parsed["fields"].isArray())
+            {
+                throw std::runtime_error("Schema JSON should contain an array of field definitions");
+            }
+            if (!parsed.contains("indexes"))
+            {
+                parsed["indexes"] = JSON(JSONType::ARRAY);
             }
             return parsed;
         }
@@ -189,22 +322,33 @@ namespace ORM
     {
         try
         {
+            // the layout version is kept in the table comment, tables without one are version 1
             std::string query = R"(
                 CREATE TABLE IF NOT EXISTS migrations (
                     id INT PRIMARY KEY AUTO_INCREMENT,
-                    model_name TEXT NOT NULL,
-                    version TEXT NOT NULL,
-                    schema_hash TEXT NOT NULL,
+                    model_name VARCHAR(64) NOT NULL,
+                    version VARCHAR(128) NOT NULL,
+                    schema_hash VARCHAR(64) NOT NULL,
                     schema_json TEXT NOT NULL,
                     is_applied BOOLEAN NOT NULL DEFAULT 1,
                     is_current BOOLEAN NOT NULL DEFAULT 0,
-                    applied_at DATETIME DEFAULT CURRENT_TIMESTAMP
-                )
+                    applied_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+                    UNIQUE KEY uq_migrations_model_version (model_name, version),
+                    KEY idx_migrations_model_current (model_name, is_current),
+                    KEY idx_migrations_model_applied (model_name, applied_at)
+                ) COMMENT = 'orm_migrations_table=2'
             )";
             if (!adapter.executeRawQuery(query, {}))
             {
                 throw std::runtime_error("Failed to execute migrations table creation SQL");
             }
+
+            int tableVersion = getMigrationTableVersion(adapter);
+            if (tableVersion < MIGRATION_TABLE_VERSION)
+                upgradeMigrationTable(adapter, tableVersion);
+            else if (tableVersion > MIGRATION_TABLE_VERSION)
+                std::cerr << "Warning: migrations table is version " << tableVersion << ", newer than this build ("
+                          << MIGRATION_TABLE_VERSION << ")" << std::endl;
         }
         catch (const std::exception &e)
         {
@@ -213,6 +357,50 @@ namespace ORM
         }
     }
 
+    int MigrationManager::getMigrationTableVersion(DatabaseAdapter &adapter)
+    {
+        auto result = adapter.executeQuery(
+            "SELECT TABLE_COMMENT FROM information_schema.TABLES WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'migrations'", {});
+        if (result.empty())
+            throw std::runtime_error("migrations table not found in information_schema");
+
+        const std::string prefix = "orm_migrations_table=";
+        const std::string &comment = result[0]["TABLE_COMMENT"];
+        if (comment.compare(0, prefix.size(), prefix) != 0)
+            return 1;
+        return std::stoi(comment.substr(prefix.size()));
+    }
+
+    void MigrationManager::upgradeMigrationTable(DatabaseAdapter &adapter, int fromVersion)
+    {
+        if (fromVersion < 2)
+        {
+            std::cerr << "Upgrading migrations table to version 2" << std::endl;
+
+            // versions recorded twice stay as they are, migration files and registered migrations are found by them;
+            // (model_name, version) is only made unique when there are none
+            auto duplicates = adapter.executeQuery(
+                "SELECT model_name, version FROM migrations GROUP BY model_name, version HAVING COUNT(*) > 1", {});
+            for (auto &duplicate : duplicates)
+                std::cerr << "Warning: migration " << duplicate["version"] << " of " << duplicate["model_name"]
+                          << " is recorded more than once" << std::endl;
+            std::string versionKey = duplicates.empty() ? "ADD UNIQUE KEY uq_migrations_model_version (model_name, version), "
+                                                        : "ADD KEY idx_migrations_model_version (model_name, version), ";
+
+            if (!adapter.executeRawQuery(
+                    "ALTER TABLE migrations "
+                    "MODIFY model_name VARCHAR(64) NOT NULL, "
+                    "MODIFY version VARCHAR(128) NOT NULL, "
+                    "MODIFY schema_hash VARCHAR(64) NOT NULL, " +
+                        versionKey +
+                        "ADD KEY idx_migrations_model_current (model_name, is_current), "
+                        "ADD KEY idx_migrations_model_applied (model_name, applied_at), "
+                        "COMMENT = 'orm_migrations_table=2'",
+                    {}))
+                throw std::runtime_error("Failed to upgrade migrations table to version 2: " + adapter.getLastError());
+        }
+    }
+
     bool MigrationManager::migrationExists(DatabaseAdapter &adapter, const std::string &tableName, const std::string &hash)
     {
         auto result = adapter.executeQuery(
@@ -223,21 +411,14 @@ namespace ORM
 
     void MigrationManager::createMigrationRecord(DatabaseAdapter &adapter, const std::string &tableName, const std::string &hash, const JSON &schemaJSON, const std::string &version)
     {
-        // First, clear any current flags for this model
-        std::string clearCurrentQuery = "UPDATE migrations SET is_current = 0 WHERE model_name = ?";
-
-        if (!adapter.executeRawQuery(clearCurrentQuery, {tableName}))
-        {
-            throw std::runtime_error("Failed to clear current versions flags.");
-        }
-
         // Validate schemaJSON before storing
-        if (!schemaJSON.isArray())
-            throw std::runtime_error("Schema JSON must be an array");
+        if (!schemaJSON.isObject() || !schemaJSON.contains("fields") || !schemaJSON["fields"].isArray())
+            throw std::runtime_error("Schema JSON must contain an array of fields");
 
-        for (size_t i = 0; i < schemaJSON.size(); i++)
+        const JSON &fields = schemaJSON["fields"];
+        for (size_t i = 0; i < fields.size(); i++)
         {
-            JSON field = schemaJSON[i];
+            JSON field = fields[i];
             if (field.isNULL() || (field["name"].get<std::string>().empty()))
             {
                 throw std::runtime_error("Invalid field in schema - cannot store empty fields");
@@ -249,46 +430,171 @@ namespace ORM
         std::string escapedHash = adapter.escapeString(hash);
         std::string escapedSchema = adapter.escapeString(JSON::stringify(schemaJSON));
 
-        std::string query = "INSERT INTO migrations (model_name, version, schema_hash, schema_json, is_current) VALUES ('" +
-                            escapedModelName + "','" + escapedVersion + "','" + escapedHash + "','" + escapedSchema + "', 1)";
+        // pending until markMigrationApplied: not applied, not current, no applied_at
+        std::string query = "INSERT INTO migrations (model_name, version, schema_hash, schema_json, is_applied, is_current, applied_at) VALUES ('" +
+                            escapedModelName + "','" + escapedVersion + "','" + escapedHash + "','" + escapedSchema + "', 0, 0, NULL)";
 
         if (!adapter.executeRawQuery(query, {}))
         {
-            throw std::runtime_error("Failed to insert record in migrations table.");
+            throw std::runtime_error("Failed to insert record in migrations table: " + adapter.getLastError());
+        }
+    }
+
+    void MigrationManager::markMigrationApplied(DatabaseAdapter &adapter, const std::string &tableName, const std::string &version)
+    {
+        // one statement, so the model never ends up without a current version
+        if (!adapter.executeRawQuery(
+                "UPDATE migrations SET is_current = (version = ?), is_applied = IF(version = ?, 1, is_applied), "
+                "applied_at = IF(version = ?, CURRENT_TIMESTAMP, applied_at) WHERE model_name = ?",
+                {version, version, version, tableName}))
+        {
+            throw std::runtime_error("Failed to mark migration " + version + " of " + tableName + " as applied: " + adapter.getLastError());
+        }
+    }
+
+    void MigrationManager::refreshMigrationRecord(DatabaseAdapter &adapter, const std::string &tableName, const std::string &version, const std::string &hash, const JSON &schemaJSON)
+    {
+        if (!adapter.executeRawQuery("UPDATE migrations SET schema_hash = ?, schema_json = ? WHERE model_name = ? AND version = ?",
+                                     {hash, JSON::stringify(schemaJSON), tableName, version}))
+        {
+            throw std::runtime_error("Failed to refresh the schema of migration " + version + " of " + tableName + ": " + adapter.getLastError());
+        }
+    }
+
+    void MigrationManager::discardMigrationRecord(DatabaseAdapter &adapter, const std::string &tableName, const std::string &version)
+    {
+        // called while an error propagates, which matters more than this one
+        if (!adapter.executeRawQuery("DELETE FROM migrations WHERE model_name = ? AND version = ? AND applied_at IS NULL", {tableName, version}))
+            std::cerr << "Warning: failed to remove the record of migration " << version << " of " << tableName << ": "
+                      << adapter.getLastError() << std::endl;
+    }
+
+    void MigrationManager::resolveInterruptedMigrations(DatabaseAdapter &adapter, const std::string &tableName)
+    {
+        auto interrupted = adapter.executeQuery(
+            "SELECT version, schema_json FROM migrations WHERE model_name = ? AND applied_at IS NULL ORDER BY id DESC", {tableName});
+        if (interrupted.empty())
+            return;
+
+        // the migration lock leaves at most one pending record per model, the newest is the one that can have run
+        std::string applied;
+        if (tableMatchesSchema(adapter, tableName, parseSchemaJSON(interrupted[0]["schema_json"])))
+        {
+            applied = interrupted[0]["version"];
+            std::cerr << "Warning: migration " << applied << " of " << tableName
+                      << " was interrupted after its DDL ran; recording it as applied" << std::endl;
+            markMigrationApplied(adapter, tableName, applied);
+        }
+        for (auto &row : interrupted)
+        {
+            if (row["version"] != applied)
+                std::cerr << "Warning: migration " << row["version"] << " of " << tableName
+                          << " was interrupted before its DDL took effect; planning it again" << std::endl;
+        }
+        if (!adapter.executeRawQuery("DELETE FROM migrations WHERE model_name = ? AND applied_at IS NULL", {tableName}))
+            throw std::runtime_error("Failed to remove interrupted migrations of " + tableName + ": " + adapter.getLastError());
+    }
+
+    bool MigrationManager::tableMatchesSchema(DatabaseAdapter &adapter, const std::string &tableName, const JSON &schema)
+    {
+        auto columns = adapter.executeQuery(
+            "SELECT COLUMN_NAME, DATA_TYPE, CHARACTER_MAXIMUM_LENGTH, IS_NULLABLE FROM information_schema.COLUMNS "
+            "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ?",
+            {tableName});
+        const JSON &fields = schema["fields"];
+        if (columns.size() != fields.size()) // no columns if the table doesn't exist
+            return false;
+
+        // names, types, lengths and nullability; defaults aren't compared, MySQL reports them normalized
+        std::unordered_set<std::string> uniqueColumns;
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            Field field = fieldFromSchemaJSON(fields[i]);
+            const FieldOptions &options = field.getOptions();
+            auto column = std::find_if(columns.begin(), columns.end(), [&](auto &row)
+                                       { return row["COLUMN_NAME"] == field.getName(); });
+            if (column == columns.end())
+                return false;
+
+            static const char *const dataTypes[] = {"int", "float", "double", "varchar", "tinyint", "text", "datetime", "blob"};
+            std::string dataType = (*column)["DATA_TYPE"];
+            bool sameType = dataType == dataTypes[static_cast<int>(field.getType())];
+            if (field.getType() == FieldType::STRING)
+            {
+                // CREATE TABLE makes a STRING without max_length TEXT, ADD COLUMN VARCHAR(255)
+                sameType = options.max_length > 0 ? sameType && (*column)["CHARACTER_MAXIMUM_LENGTH"] == std::to_string(options.max_length)
+                                                  : dataType == "text" || (sameType && (*column)["CHARACTER_MAXIMUM_LENGTH"] == "255");
+            }
+            if (!sameType || ((*column)["IS_NULLABLE"] == "YES") != (options.nullable && !options.primary_key))
+                return false;
+            if (options.unique)
+                uniqueColumns.insert(field.getName());
         }
+
+        // the named indexes, and the unique keys of unique fields, which MySQL names after their column
+        auto live = adapter.executeQuery(
+            "SELECT DISTINCT INDEX_NAME FROM information_schema.STATISTICS "
+            "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ? AND INDEX_NAME <> 'PRIMARY'",
+            {tableName});
+        std::unordered_set<std::string> liveIndexes, indexes = uniqueColumns;
+        for (auto &row : live)
+            liveIndexes.insert(row["INDEX_NAME"]);
+        const JSON &indexList = schema["indexes"];
+        for (size_t i = 0; i < indexList.size(); i++)
+            indexes.insert(indexList[i]["name"].get<std::string>());
+        return liveIndexes == indexes;
     }
 
     JSON MigrationManager::getLastMigration(DatabaseAdapter &adapter, const std::string &tableName)
     {
         auto result = adapter.executeQuery(
-            "SELECT schema_hash, schema_json FROM migrations WHERE model_name = ? AND is_current = 1 LIMIT 1", {tableName});
+            "SELECT version, schema_hash, schema_json FROM migrations WHERE model_name = ? AND is_current = 1 LIMIT 1", {tableName});
 
         if (result.empty())
         {
             // If no current version marked, get the last applied migration
             result = adapter.executeQuery(
-                "SELECT schema_hash, schema_json FROM migrations WHERE model_name = ? AND is_applied = 1 "
-                "ORDER BY applied_at DESC LIMIT 1",
+                "SELECT version, schema_hash, schema_json FROM migrations WHERE model_name = ? AND is_applied = 1 "
+                "ORDER BY applied_at DESC, id DESC LIMIT 1",
                 {tableName});
         }
         if (result.empty())
             return JSON();
 
         JSON lastMigration(JSONType::OBJECT);
+        lastMigration["version"] = JSON(result[0]["version"]);
         lastMigration["schema_hash"] = JSON(result[0]["schema_hash"]);
         lastMigration["schema_json"] = JSON(result[0]["schema_json"]);
         return lastMigration;
     }
 
-    void MigrationManager::compareAndUpdateSchema(DatabaseAdapter &adapter, const Model &model, const JSON &oldSchema, std::vector<std::string> &upSql, std::vector<std::string> &downSql)
+    std::unordered_map<std::string, std::string> MigrationManager::getCurrentHashes(DatabaseAdapter &adapter)
     {
-        std::string tableName = model.getTableName();
+        auto result = adapter.executeQuery(
+            "SELECT model_name, schema_hash FROM migrations WHERE is_current = 1", {});
+
+        // models without a current row fall back to getLastMigration in migrateModel
+        std::unordered_map<std::string, std::string> hashes;
+        hashes.reserve(result.size());
+        for (auto &row : result)
+            hashes[row["model_name"]] = std::move(row["schema_hash"]);
+        return hashes;
+    }
+
+    AlterPlan MigrationManager::planSchemaChange(const Model &model, const JSON &oldSchema)
+    {
+        AlterPlan plan;
+        plan.tableName = model.getTableName();
+        const JSON &oldFieldList = oldSchema["fields"];
+
+        // indexes go first so a dropped column never leaves a stale index definition behind
+        handleDroppedIndexes(model, oldSchema, plan);
 
         // create hashmap for fast lookup
         std::unordered_map<std::string, JSON> oldFields;
-        for (size_t i = 0; i < oldSchema.size(); i++)
+        for (size_t i = 0; i < oldFieldList.size(); i++)
         {
-            JSON field = oldSchema[i];
+            JSON field = oldFieldList[i];
             // Skip empty or invalid fields
             if (field.isNULL())
             {
@@ -305,56 +611,466 @@ namespace ORM
                 throw std::runtime_error("Invalid field structure: " + std::string(e.what()));
             }
         }
-        // check for modified field
+        // check for new and modified fields
         for (const auto &field : model.getFields())
         {
-            std::string fieldName = field->getName();
-            auto it = oldFields.find(fieldName);
+            auto it = oldFields.find(field->getName());
+            if (it == oldFields.end())
+                handleAddedColumn(*field, plan);
+            else
+                handleFieldChanges(*field, it->second, plan);
+        }
+        // check for droped column
+        handleDroppedColumn(model, oldSchema, plan);
+
+        handleAddedIndexes(model, oldSchema, plan);
+        return plan;
+    }
+
+    void MigrationManager::applyAlterPlan(DatabaseAdapter &adapter, const AlterPlan &plan, std::vector<std::string> &upSql, std::vector<std::string> &downSql)
+    {
+        static const char *const algorithmNames[] = {"INSTANT", "INPLACE", "COPY"};
+
+        AlterAlgorithm algorithm = plan.algorithm();
+        if (algorithm == AlterAlgorithm::COPY)
+        {
+            for (const auto &clause : plan.clauses)
+            {
+                if (clause.algorithm == AlterAlgorithm::COPY)
+                    std::cerr << "Migration: " << plan.tableName << " needs ALGORITHM=COPY: " << clause.reason << std::endl;
+            }
+        }
 
-            if (it == oldFields.end()) // new field found
+        while (true)
+        {
+            if (algorithm == AlterAlgorithm::COPY && onlineSchemaChange &&
+                estimateRows(adapter, plan.tableName) >= onlineSchemaChange->minRows)
+            {
+                std::cerr << "Migration: altering " << plan.tableName << " online through a shadow table" << std::endl;
+                OnlineSchemaChange(adapter, *onlineSchemaChange).run(plan);
+                // marked so migrateToVersion replays it (and its undo) online too
+                upSql.push_back(SqlMigration::onlineStatement(plan.statement(AlterAlgorithm::COPY)));
+                downSql.push_back(SqlMigration::onlineStatement(plan.undoStatement()));
+                return;
+            }
+
+            std::string alterSql = plan.statement(algorithm);
+            if (algorithm == AlterAlgorithm::COPY && rebuildLimits)
+            {
+                PlannedStatement planned = MigrationCostEstimator(adapter, *rebuildLimits).estimate(alterSql);
+                if (planned.refused)
+                    throw std::runtime_error("Refusing to alter " + plan.tableName + " with ALGORITHM=COPY: ~" +
+                                             std::to_string(planned.rows) + " rows, " + std::to_string(planned.tableBytes) +
+                                             " bytes, writes would be blocked for ~" + std::to_string(static_cast<long>(planned.seconds)) + "s");
+            }
+            if (adapter.executeRawQuery(alterSql, {}))
             {
-                std::string alterSql = generateAlterAddColumn(tableName, *field);
                 upSql.push_back(alterSql);
-                downSql.push_back(generateAlterDropColumn(tableName, fieldName));
-                adapter.executeRawQuery(alterSql, {});
+                downSql.push_back(plan.undoStatement());
+                return;
             }
+            // anything but "algorithm not supported" (a duplicate key, a lock wait timeout, ...) fails
+            // the same way with a slower algorithm
+            if (algorithm == AlterAlgorithm::COPY || !isAlgorithmNotSupported(adapter.getLastErrorCode()))
+                throw std::runtime_error("Failed to alter table " + plan.tableName + ": " + adapter.getLastError());
+
+            // e.g. a server too old for INSTANT, or a row format that doesn't support it
+            AlterAlgorithm next = static_cast<AlterAlgorithm>(static_cast<int>(algorithm) + 1);
+            std::cerr << "Migration: ALGORITHM=" << algorithmNames[static_cast<int>(algorithm)] << " failed for "
+                      << plan.tableName << " (" << adapter.getLastError() << "), retrying with ALGORITHM="
+                      << algorithmNames[static_cast<int>(next)] << std::endl;
+            algorithm = next;
+        }
+    }
 
-            else
+    void MigrationManager::replayStatement(DatabaseAdapter &adapter, const std::string &statement)
+    {
+        std::string alterSql;
+        if (SqlMigration::isOnlineStatement(statement, alterSql))
+        {
+            std::cerr << "Migration: replaying an online schema change: " << alterSql << std::endl;
+            OnlineSchemaChange(adapter, onlineSchemaChange ? *onlineSchemaChange : OnlineSchemaChangeOptions{})
+                .run(planFromStatement(alterSql, AlterAlgorithm::COPY));
+            return;
+        }
+
+        // an ALTER that may copy the table (ALGORITHM=COPY, or no ALGORITHM at all) goes through applyAlterPlan,
+        // so it runs online or is refused by the rebuild limits the way dryRunToVersion estimates it
+        std::string upperSql = upper(statement);
+        bool copy = endsWith(upperSql, COPY_SUFFIX);
+        if (upperSql.compare(0, ALTER_TABLE_PREFIX.size(), ALTER_TABLE_PREFIX) == 0 && (copy || upperSql.find("ALGORITHM") == std::string::npos))
+        {
+            std::vector<std::string> upSql, downSql;
+            applyAlterPlan(adapter, planFromStatement(statement, copy ? AlterAlgorithm::COPY : AlterAlgorithm::INSTANT), upSql, downSql);
+            return;
+        }
+
+        if (!adapter.executeRawQuery(statement, {}))
+            throw std::runtime_error(adapter.getLastError());
+    }
+
+    AlterPlan MigrationManager::planFromStatement(const std::string &alterSql, AlterAlgorithm algorithm)
+    {
+        size_t nameEnd = alterSql.find(' ', ALTER_TABLE_PREFIX.size());
+        if (upper(alterSql.substr(0, ALTER_TABLE_PREFIX.size())) != ALTER_TABLE_PREFIX || nameEnd == std::string::npos)
+            throw std::runtime_error("Not an ALTER TABLE statement: " + alterSql);
+
+        // statement(COPY) appends the ALGORITHM option again
+        std::string clauses = alterSql.substr(nameEnd + 1);
+        if (endsWith(upper(clauses), COPY_SUFFIX))
+            clauses.erase(clauses.size() - COPY_SUFFIX.size());
+
+        AlterPlan plan;
+        plan.tableName = alterSql.substr(ALTER_TABLE_PREFIX.size(), nameEnd - ALTER_TABLE_PREFIX.size());
+        plan.clauses.push_back(AlterClause{clauses, "", algorithm, algorithm == AlterAlgorithm::COPY ? "recorded with ALGORITHM=COPY" : ""});
+        return plan;
+    }
+
+    MigrationReport MigrationManager::dryRun(DatabaseAdapter &adapter, const Model &model, const MigrationCostOptions &options)
+    {
+        MigrationCostEstimator estimator(adapter, options, onlineSchemaChange ? &*onlineSchemaChange : nullptr);
+        MigrationReport report;
+        dryRunModel(adapter, model, estimator, report);
+        return report;
+    }
+
+    MigrationReport MigrationManager::dryRunAll(DatabaseAdapter &adapter, const MigrationCostOptions &options)
+    {
+        std::unordered_map<std::string, std::string> currentHashes = getCurrentHashes(adapter);
+        MigrationCostEstimator estimator(adapter, options, onlineSchemaChange ? &*onlineSchemaChange : nullptr);
+        MigrationReport report;
+
+        for (ModelRegistry::ModelFactory create : ModelRegistry::getModels())
+        {
+            std::unique_ptr<Model> model = create();
+            auto current = currentHashes.find(model->getTableName());
+            if (current != currentHashes.end() && current->second == claculateSchemaHash(generateSchemaJSON(*model)))
+                continue; // up to date
+
+            dryRunModel(adapter, *model, estimator, report);
+        }
+        return report;
+    }
+
+    void MigrationManager::dryRunModel(DatabaseAdapter &adapter, const Model &model, MigrationCostEstimator &estimator, MigrationReport &report)
+    {
+        std::string tableName = model.getTableName();
+        JSON lastMigration = getLastMigration(adapter, tableName);
+
+        if (lastMigration.isNULL())
+        {
+            PlannedStatement planned = estimator.estimate(adapter.getCreateTableSTring(model));
+            planned.migration = tableName;
+            report.statements.push_back(std::move(planned));
+            return;
+        }
+        if (lastMigration["schema_hash"].get<std::string>() == claculateSchemaHash(generateSchemaJSON(model)))
+            return;
+
+        AlterPlan plan = planSchemaChange(model, parseSchemaJSON(lastMigration["schema_json"].get<std::string>()));
+        if (plan.empty())
+            return;
+
+        PlannedStatement planned = estimator.estimate(plan.statement(plan.algorithm()));
+        planned.migration = tableName;
+        for (const auto &clause : plan.clauses)
+        {
+            if (clause.algorithm == AlterAlgorithm::COPY)
+                planned.warning += std::string(planned.warning.empty() ? "" : "; ") + "needs COPY: " + clause.reason;
+        }
+        report.statements.push_back(std::move(planned));
+    }
+
+    MigrationReport MigrationManager::dryRunToVersion(DatabaseAdapter &adapter, const std::string &modelName, const std::string &targetVersion,
+                                                      const MigrationCostOptions &options)
+    {
+        MigrationCostEstimator estimator(adapter, options, onlineSchemaChange ? &*onlineSchemaChange : nullptr);
+        MigrationReport report;
+
+        std::string currentVersion = getCurrentVersion(adapter, modelName);
+        if (currentVersion == targetVersion)
+            return report;
+
+        for (const auto &[version, up] : getMigrationSteps(adapter, modelName, currentVersion, targetVersion))
+        {
+            std::string sqlFile;
+            if (!findMigration(modelName, version, sqlFile))
             {
-                // existing field possibly its renamed
-                const JSON &oldField = it->second;
+                report.notes.push_back("Migration " + version + " of " + modelName + " is not registered, migrateToVersion would fail");
+                continue;
+            }
+            if (sqlFile.empty())
+            {
+                report.notes.push_back("Migration " + version + " of " + modelName + " is compiled, its statements can't be listed");
+                continue;
+            }
 
-                if (static_cast<int>(field->getType()) != oldField["type"].get<int>() ||
-                    static_cast<int>(field->getOptions().nullable) != oldField["nullable"].get<bool>() ||
-                    static_cast<int>(field->getOptions().max_length) != oldField["max_length"].get<int>())
-                {
-                    std::string modifySql = generateAlterModifyColumn(tableName, *field);
-                    upSql.push_back(modifySql);
-                    // Down would revert to old field definition
-                    downSql.push_back(generateAlterModifyColumn(tableName,
-                                                                Field(oldField["name"].get<std::string>(),
-                                                                      static_cast<FieldType>(oldField["type"].get<int>()),
-                                                                      FieldOptions{
-                                                                          oldField["primary_key"].get<bool>(),
-                                                                          oldField["auto_increment"].get<bool>(),
-                                                                          oldField["nullable"].get<bool>(),
-                                                                          oldField["unique"].get<bool>(),
-                                                                          oldField["max_length"].get<int>(),
-                                                                          oldField["default_value"].get<std::string>()})));
-                    adapter.executeRawQuery(modifySql, {});
-                }
+            SqlMigration migration = SqlMigration::load(sqlFile);
+            for (const auto &sql : up ? migration.getUpSql() : migration.getDownSql())
+            {
+                std::string alterSql;
+                bool online = SqlMigration::isOnlineStatement(sql, alterSql);
+                PlannedStatement planned = online ? estimator.estimate(alterSql, true) : estimator.estimate(sql);
+                planned.migration = migration.getName() + (up ? " (up)" : " (down)");
+                report.statements.push_back(std::move(planned));
             }
         }
-        // check for droped column
-        handleDroppedColumn(adapter, tableName, model, oldSchema, upSql, downSql);
+        return report;
+    }
+
+    void MigrationManager::enableRebuildLimits(const MigrationCostOptions &options)
+    {
+        rebuildLimits = options;
+    }
+
+    void MigrationManager::disableRebuildLimits()
+    {
+        rebuildLimits.reset();
+    }
+
+    void MigrationManager::enableOnlineSchemaChange(const OnlineSchemaChangeOptions &options)
+    {
+        onlineSchemaChange = options;
+    }
+
+    void MigrationManager::disableOnlineSchemaChange()
+    {
+        onlineSchemaChange.reset();
+    }
+
+    std::string MigrationManager::getPrimaryKey(DatabaseAdapter &adapter, const std::string &tableName)
+    {
+        auto columns = adapter.executeQuery(
+            "SELECT COLUMN_NAME FROM information_schema.KEY_COLUMN_USAGE WHERE TABLE_SCHEMA = DATABASE() "
+            "AND TABLE_NAME = ? AND CONSTRAINT_NAME = 'PRIMARY'",
+            {tableName});
+        return columns.size() == 1 ? columns[0]["COLUMN_NAME"] : "";
+    }
+
+    size_t MigrationManager::estimateRows(DatabaseAdapter &adapter, const std::string &tableName)
+    {
+        auto result = adapter.executeQuery(
+            "SELECT TABLE_ROWS FROM information_schema.TABLES WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ?", {tableName});
+        if (result.empty() || result[0]["TABLE_ROWS"].empty())
+            return 0;
+        return std::stoull(result[0]["TABLE_ROWS"]);
+    }
+
+    AlterAlgorithm AlterPlan::algorithm() const
+    {
+        AlterAlgorithm cheapest = AlterAlgorithm::INSTANT;
+        for (const auto &clause : clauses)
+            cheapest = std::max(cheapest, clause.algorithm);
+        return cheapest;
+    }
+
+    std::string AlterPlan::statement(AlterAlgorithm algorithm) const
+    {
+        std::string sql = "ALTER TABLE " + tableName + " ";
+        for (const auto &clause : clauses)
+            sql += clause.sql + ", ";
+
+        switch (algorithm)
+        {
+        case AlterAlgorithm::INSTANT:
+            return sql + "ALGORITHM=INSTANT";
+        case AlterAlgorithm::INPLACE:
+            return sql + "ALGORITHM=INPLACE, LOCK=NONE";
+        case AlterAlgorithm::COPY:
+            break;
+        }
+        return sql + "ALGORITHM=COPY";
+    }
+
+    std::string AlterPlan::undoStatement() const
+    {
+        std::string sql = "ALTER TABLE " + tableName + " ";
+        for (size_t i = clauses.size(); i-- > 0;)
+        {
+            sql += clauses[i].undoSql;
+            if (i > 0)
+                sql += ", ";
+        }
+        return sql;
+    }
+
+    void MigrationManager::handleAddedColumn(const Field &field, AlterPlan &plan)
+    {
+        AlterClause clause{generateAddColumnClause(field), generateDropColumnClause(field.getName()), AlterAlgorithm::INSTANT, ""};
+
+        // plain columns are appended to the row format in place
+        if (field.getOptions().primary_key || field.getOptions().auto_increment)
+        {
+            clause.algorithm = AlterAlgorithm::COPY;
+            clause.reason = "adding primary key/auto increment column " + field.getName();
+        }
+        else if (field.getOptions().unique)
+        {
+            clause.algorithm = AlterAlgorithm::INPLACE;
+            clause.reason = "adding column " + field.getName() + " builds a unique index";
+        }
+        plan.clauses.push_back(std::move(clause));
+    }
+
+    void MigrationManager::handleFieldChanges(const Field &newField, const JSON &oldField, AlterPlan &plan)
+    {
+        const std::string &name = newField.getName();
+        const FieldOptions &options = newField.getOptions();
+        int oldType = oldField["type"].get<int>();
+        int oldMaxLength = oldField["max_length"].get<int>();
+        std::string oldDefault = oldField["default_value"].get<std::string>();
+
+        bool typeChanged = static_cast<int>(newField.getType()) != oldType;
+        bool nullableChanged = options.nullable != oldField["nullable"].get<bool>();
+        bool lengthChanged = static_cast<int>(options.max_length) != oldMaxLength;
+        bool autoIncrementChanged = options.auto_increment != oldField["auto_increment"].get<bool>();
+        bool primaryKeyChanged = options.primary_key != oldField["primary_key"].get<bool>();
+        bool uniqueChanged = options.unique != oldField["unique"].get<bool>();
+
+        // keys are separate clauses, MODIFY COLUMN would add a second UNIQUE index instead of replacing one
+        if (primaryKeyChanged)
+        {
+            AlterClause clause{options.primary_key ? "ADD PRIMARY KEY (" + name + ")" : "DROP PRIMARY KEY",
+                               options.primary_key ? "DROP PRIMARY KEY" : "ADD PRIMARY KEY (" + name + ")",
+                               AlterAlgorithm::COPY,
+                               (options.primary_key ? "adding" : "dropping") + std::string(" the primary key on ") + name};
+            plan.clauses.push_back(std::move(clause));
+        }
+        if (uniqueChanged)
+        {
+            // generateColumnDefination's UNIQUE creates an index named after the column
+            AlterClause clause{options.unique ? generateAddIndexClause(name, "(" + name + ")", true) : generateDropIndexClause(name),
+                               options.unique ? generateDropIndexClause(name) : generateAddIndexClause(name, "(" + name + ")", true),
+                               AlterAlgorithm::INPLACE,
+                               (options.unique ? "adding" : "dropping") + std::string(" the unique index on ") + name};
+            plan.clauses.push_back(std::move(clause));
+        }
+
+        if (!typeChanged && !nullableChanged && !lengthChanged && !autoIncrementChanged)
+        {
+            if (options.default_value == oldDefault)
+                return;
+
+            // only the default changed: a metadata update, unlike MODIFY COLUMN
+            plan.clauses.push_back(AlterClause{generateSetDefaultClause(name, options.default_value),
+                                               generateSetDefaultClause(name, oldDefault),
+                                               AlterAlgorithm::INSTANT, ""});
+            return;
+        }
+
+        AlterClause clause{generateModifyColumnClause(newField),
+                           generateModifyColumnClause(fieldFromSchemaJSON(oldField)),
+                           AlterAlgorithm::INPLACE, "modifying column " + name};
+        if (typeChanged)
+        {
+            clause.algorithm = AlterAlgorithm::COPY;
+            clause.reason = "changing the type of column " + name;
+        }
+        else if (autoIncrementChanged)
+        {
+            clause.algorithm = AlterAlgorithm::COPY;
+            clause.reason = (options.auto_increment ? "adding" : "removing") + std::string(" AUTO_INCREMENT on column ") + name;
+        }
+        else if (lengthChanged && newField.getType() == FieldType::STRING)
+        {
+            // VARCHAR(0) is generated as VARCHAR(255)
+            int oldLength = oldMaxLength > 0 ? oldMaxLength : 255;
+            int newLength = options.max_length > 0 ? static_cast<int>(options.max_length) : 255;
+            // a utf8mb4 VARCHAR longer than 63 characters has a 2 byte length prefix instead of 1
+            if (newLength < oldLength)
+            {
+                clause.algorithm = AlterAlgorithm::COPY;
+                clause.reason = "shrinking VARCHAR column " + name;
+            }
+            else if ((oldLength > 63) != (newLength > 63))
+            {
+                clause.algorithm = AlterAlgorithm::COPY;
+                clause.reason = "VARCHAR column " + name + " grows past 255 bytes, its length prefix changes";
+            }
+        }
+        plan.clauses.push_back(std::move(clause));
+    }
+
+    Field MigrationManager::fieldFromSchemaJSON(const JSON &fieldJson)
+    {
+        FieldOptions options;
+        options.primary_key = fieldJson["primary_key"].get<bool>();
+        options.auto_increment = fieldJson["auto_increment"].get<bool>();
+        options.nullable = fieldJson["nullable"].get<bool>();
+        options.unique = fieldJson["unique"].get<bool>();
+        options.max_length = fieldJson["max_length"].get<int>();
+        options.default_value = fieldJson["default_value"].get<std::string>();
+
+        return Field(fieldJson["name"].get<std::string>(), static_cast<FieldType>(fieldJson["type"].get<int>()), options);
+    }
+
+    std::string MigrationManager::columnListFromSchemaJSON(const JSON &columns)
+    {
+        std::string list = "(";
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            if (i > 0)
+                list += ", ";
+            list += columns[i].get<std::string>();
+        }
+        return list + ")";
+    }
+
+    void MigrationManager::handleDroppedIndexes(const Model &model, const JSON &oldSchema, AlterPlan &plan)
+    {
+        std::unordered_map<std::string, IndexDefinition> currentIndexes;
+        for (const auto &index : model.collectIndexes())
+        {
+            currentIndexes[index.name] = index;
+        }
+
+        const JSON &oldIndexes = oldSchema["indexes"];
+        for (size_t i = 0; i < oldIndexes.size(); i++)
+        {
+            const JSON &oldIndex = oldIndexes[i];
+            std::string indexName = oldIndex["name"].get<std::string>();
+            std::string oldColumns = columnListFromSchemaJSON(oldIndex["columns"]);
+            bool oldUnique = oldIndex["unique"].get<bool>();
+
+            auto it = currentIndexes.find(indexName);
+            if (it != currentIndexes.end() && it->second.columnList() == oldColumns && it->second.unique == oldUnique)
+                continue; // unchanged
+
+            // removed or redefined, a redefined index is added back by handleAddedIndexes
+            plan.clauses.push_back(AlterClause{generateDropIndexClause(indexName),
+                                               generateAddIndexClause(indexName, oldColumns, oldUnique),
+                                               AlterAlgorithm::INPLACE, "dropping index " + indexName});
+        }
+    }
+
+    void MigrationManager::handleAddedIndexes(const Model &model, const JSON &oldSchema, AlterPlan &plan)
+    {
+        std::unordered_map<std::string, std::pair<std::string, bool>> oldIndexes;
+        const JSON &oldIndexList = oldSchema["indexes"];
+        for (size_t i = 0; i < oldIndexList.size(); i++)
+        {
+            const JSON &oldIndex = oldIndexList[i];
+            oldIndexes[oldIndex["name"].get<std::string>()] = {columnListFromSchemaJSON(oldIndex["columns"]), oldIndex["unique"].get<bool>()};
+        }
+
+        for (const auto &index : model.collectIndexes())
+        {
+            auto it = oldIndexes.find(index.name);
+            if (it != oldIndexes.end() && it->second.first == index.columnList() && it->second.second == index.unique)
+                continue; // unchanged
+
+            plan.clauses.push_back(AlterClause{generateAddIndexClause(index.name, index.columnList(), index.unique),
+                                               generateDropIndexClause(index.name),
+                                               AlterAlgorithm::INPLACE, "building index " + index.name});
+        }
     }
 
     void MigrationManager::alterTable(DatabaseAdapter &adapter, const Model &model, const JSON &oldSchema)
     {
-        // compareAndUpdateSchema(adapter, model, oldSchema);
+        // applyAlterPlan(adapter, planSchemaChange(model, oldSchema), upSql, downSql);
     }
 
-    void MigrationManager::handleDroppedColumn(DatabaseAdapter &adapter, const std::string &tableName, const Model &model, const JSON &oldSchema, std::vector<std::string> &upSql, std::vector<std::string> &downSql)
+    void MigrationManager::handleDroppedColumn(const Model &model, const JSON &oldSchema, AlterPlan &plan)
     {
         std::unordered_set<std::string> currentFields;
         for (const auto &field : model.getFields())
@@ -362,47 +1078,55 @@ namespace ORM
             currentFields.insert(field->getName());
         }
 
-        for (size_t i = 0; i < oldSchema.size(); i++)
+        const JSON &oldFields = oldSchema["fields"];
+        for (size_t i = 0; i < oldFields.size(); i++)
         {
-            JSON oldField = oldSchema[i];
+            JSON oldField = oldFields[i];
             std::string fieldName = oldField["name"].get<std::string>();
 
             if (currentFields.find(fieldName) == currentFields.end())
             {
-                std::string dropSql = generateAlterDropColumn(tableName, fieldName);
-                upSql.push_back(dropSql);
-
                 // down would recreate the column
-                downSql.push_back(generateAlterAddColumn(tableName,
-                                                         Field(oldField["name"].get<std::string>(),
-                                                               static_cast<FieldType>(oldField["type"].get<int>()),
-                                                               FieldOptions{
-                                                                   oldField["primary_key"].get<bool>(),
-                                                                   oldField["auto_increment"].get<bool>(),
-                                                                   oldField["nullable"].get<bool>(),
-                                                                   oldField["unique"].get<bool>(),
-                                                                   oldField["max_length"].get<int>(), // Fix typo: max_lenght -> max_length
-                                                                   oldField["default_value"].get<std::string>()})));
+                AlterClause clause{generateDropColumnClause(fieldName),
+                                   generateAddColumnClause(fieldFromSchemaJSON(oldField)),
+                                   AlterAlgorithm::INSTANT, ""};
 
-                adapter.executeRawQuery(dropSql, {});
+                // INSTANT drop needs MySQL 8.0.29, older servers fall back to an in place rebuild
+                if (oldField["primary_key"].get<bool>())
+                {
+                    clause.algorithm = AlterAlgorithm::COPY;
+                    clause.reason = "dropping primary key column " + fieldName;
+                }
+                else if (oldField["unique"].get<bool>())
+                {
+                    clause.algorithm = AlterAlgorithm::INPLACE;
+                    clause.reason = "dropping indexed column " + fieldName;
+                }
+                plan.clauses.push_back(std::move(clause));
             }
         }
     }
 
     std::string MigrationManager::generateVersionNumber()
     {
-        auto now = std::chrono::system_clock::now();
-        auto in_time_t = std::chrono::system_clock::to_time_t(now);
-
+        // milliseconds, never repeated within a process even if the clock is coarse or steps back
+        static long long lastMillis = 0;
+        long long millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+        millis = std::max(millis, lastMillis + 1);
+        lastMillis = millis;
+
+        std::time_t in_time_t = static_cast<std::time_t>(millis / 1000);
         std::tm tm;
         localtime_r(&in_time_t, &tm);
 
         std::ostringstream ss;
-        ss << std::put_time(&tm, "%Y%m%d_%H%M%S");
+        ss << std::put_time(&tm, "%Y%m%d_%H%M%S") << '_' << std::setw(3) << std::setfill('0') << millis % 1000;
         return ss.str();
     }
 
-    std::string MigrationManager::generateColumnDefination(const Field &field)
+    std::string MigrationManager::generateColumnDefination(const Field &field, bool withKeys)
     {
         std::ostringstream ss;
 
@@ -429,23 +1153,27 @@ namespace ORM
         case FieldType::DATETIME:
             ss << "DATETIME";
             break;
+        case FieldType::BLOB:
+            ss << "BLOB";
+            break;
         }
 
-        if (field.getOptions().primary_key)
+        if (!field.getOptions().nullable)
         {
-            ss << " PRIMARY KEY";
-            if (field.getOptions().auto_increment)
-            {
-                ss << " AUTOINCREMENT";
-            }
+            ss << " NOT NULL";
         }
 
-        if (!field.getOptions().nullable)
+        if (field.getOptions().auto_increment)
         {
-            ss << " NOT NULL";
+            ss << " AUTO_INCREMENT";
+        }
+
+        if (withKeys && field.getOptions().primary_key)
+        {
+            ss << " PRIMARY KEY";
         }
 
-        if (field.getOptions().unique)
+        if (withKeys && field.getOptions().unique)
         {
             ss << " UNIQUE";
         }
@@ -457,47 +1185,83 @@ namespace ORM
         return ss.str();
     }
 
-    std::string MigrationManager::generateAlterAddColumn(const std::string &tableName, const Field &field)
+    std::string MigrationManager::generateAddColumnClause(const Field &field)
+    {
+        return "ADD COLUMN " + field.getName() + " " + generateColumnDefination(field);
+    }
+
+    std::string MigrationManager::generateModifyColumnClause(const Field &field)
+    {
+        // keys are left alone, handleFieldChanges adds or drops them with their own clauses
+        return "MODIFY COLUMN " + field.getName() + " " + generateColumnDefination(field, false);
+    }
+
+    std::string MigrationManager::generateDropColumnClause(const std::string &columnName)
+    {
+        return "DROP COLUMN " + columnName;
+    }
+
+    std::string MigrationManager::generateSetDefaultClause(const std::string &columnName, const std::string &defaultValue)
     {
-        return "ALTER TABLE " + tableName + " ADD COLUMN " + field.getName() + " " + generateColumnDefination(field);
+        // same convention as generateColumnDefination: an empty default means none
+        if (defaultValue.empty())
+            return "ALTER COLUMN " + columnName + " DROP DEFAULT";
+        return "ALTER COLUMN " + columnName + " SET DEFAULT '" + defaultValue + "'";
     }
 
-    std::string MigrationManager::generateAlterModifyColumn(const std::string &tableName, const Field &field)
+    std::string MigrationManager::generateAddIndexClause(const std::string &indexName, const std::string &columnList, bool unique)
     {
-        return "ALTER TABLE " + tableName + " MODIFY COLUMN " + field.getName() + " " + generateColumnDefination(field);
+        return (unique ? "ADD UNIQUE INDEX " : "ADD INDEX ") + indexName + " " + columnList;
     }
 
-    std::string MigrationManager::generateAlterDropColumn(const std::string &tableName, const std::string &columnName)
+    std::string MigrationManager::generateDropIndexClause(const std::string &indexName)
     {
-        return "ALTER TABLE " + tableName + " DROP COLUMN " + columnName;
+        return "DROP INDEX " + indexName;
     }
 
     std::vector<std::pair<std::string, JSON>> MigrationManager::getAllMigration(DatabaseAdapter &adapter, const std::string &modelName)
     {
-        auto result = adapter.executeQuery("SELECT version, schema_json FROM migrations WHERE model_name = ? ORDER BY applied_at ASC", {modelName});
+        auto result = adapter.executeQuery("SELECT version, schema_json FROM migrations WHERE model_name = ? AND applied_at IS NOT NULL "
+                                           "ORDER BY applied_at ASC, id ASC",
+                                           {modelName});
 
         std::vector<std::pair<std::string, JSON>> migrations;
+        // history can be long and callers usually look at a few entries only
         for (const auto &row : result)
-            migrations.emplace_back(row.at("version"), parseSchemaJSON(row.at("schema_json")));
+            migrations.emplace_back(row.at("version"), parseSchemaJSON(row.at("schema_json"), true));
         return migrations;
     }
 
-    bool MigrationManager::applyMigration(DatabaseAdapter &adapter, const std::string &modelName, const std::string &version, bool up)
+    std::function<std::unique_ptr<MigrationInterface>()> MigrationManager::findMigration(const std::string &modelName, const std::string &version, std::string &sqlFile)
     {
-        // Try both naming patterns
-        std::string fullVersionName1 = version + "_after_" + modelName;
-        std::string fullVersionName2 = version + "_create_" + modelName;
-
-        auto it = migrationRegistry.find(fullVersionName1);
-        if (it == migrationRegistry.end())
+        // compiled migrations first, then SQL files
+        for (const std::string &name : {version + "_after_" + modelName, version + "_create_" + modelName})
         {
-            it = migrationRegistry.find(fullVersionName2);
+            auto registered = migrationRegistry.find(name);
+            if (registered != migrationRegistry.end())
+                return registered->second;
+
+            auto file = migrationFiles.find(name);
+            if (file != migrationFiles.end())
+            {
+                sqlFile = file->second;
+                std::string path = sqlFile;
+                return [path]
+                { return std::make_unique<SqlMigration>(SqlMigration::load(path)); };
+            }
         }
+        return nullptr;
+    }
 
-        if (it == migrationRegistry.end())
+    bool MigrationManager::applyMigration(DatabaseAdapter &adapter, const std::string &modelName, const std::string &version, bool up)
+    {
+        std::string sqlFile;
+        auto create = findMigration(modelName, version, sqlFile);
+
+        if (!create)
         {
             std::cerr << "Migration not registered for version: " << version
-                      << " (tried: " << fullVersionName1 << " and " << fullVersionName2 << ")" << std::endl;
+                      << " (tried: " << version << "_after_" << modelName << " and " << version << "_create_" << modelName << ")" << std::endl;
             return false;
         }
 
@@ -514,7 +1278,7 @@ namespace ORM
             }
 
             // Execute migration
-            auto migration = it->second();
+            auto migration = create();
             if (up)
             {
                 migration->up(adapter);
@@ -536,12 +1300,51 @@ namespace ORM
         }
     }
 
+    std::vector<std::pair<std::string, bool>> MigrationManager::getMigrationSteps(DatabaseAdapter &adapter, const std::string &modelName,
+                                                                                  const std::string &currentVersion, const std::string &targetVersion)
+    {
+        auto allMigrations = getAllMigration(adapter, modelName);
+
+        // Find positions in the migration sequence
+        size_t current = 0;
+        if (!currentVersion.empty())
+        {
+            auto currentIt = std::find_if(allMigrations.begin(), allMigrations.end(),
+                                          [&currentVersion](const auto &m)
+                                          { return m.first == currentVersion; });
+            if (currentIt == allMigrations.end())
+            {
+                throw std::runtime_error("Current version " + currentVersion + " not found in migration history");
+            }
+            current = currentIt - allMigrations.begin();
+        }
+
+        auto targetIt = std::find_if(allMigrations.begin(), allMigrations.end(),
+                                     [&targetVersion](const auto &m)
+                                     { return m.first == targetVersion; });
+
+        if (targetIt == allMigrations.end())
+        {
+            throw std::runtime_error("Target version " + targetVersion + " not found in migration history");
+        }
+        size_t target = targetIt - allMigrations.begin();
+
+        std::vector<std::pair<std::string, bool>> steps;
+        // Migrate forward
+        for (size_t i = current; current < target && i <= target; i++)
+            steps.emplace_back(allMigrations[i].first, true);
+        // Migrate backward, the current migration is rolled back first
+        for (size_t i = current + 1; current > target && i-- > target;)
+            steps.emplace_back(allMigrations[i].first, false);
+        return steps;
+    }
+
     bool MigrationManager::migrateToVersion(DatabaseAdapter &adapter, const std::string &modelName, const std::string &targetVersion)
     {
         try
         {
+            MigrationLock lock(adapter, lockTimeout);
             std::string currentVersion = getCurrentVersion(adapter, modelName);
-            auto allMigrations = getAllMigration(adapter, modelName);
 
             if (currentVersion == targetVersion)
             {
@@ -549,27 +1352,7 @@ namespace ORM
                 return true;
             }
 
-            // Find positions in the migration sequence
-            auto currentIt = allMigrations.begin();
-            if (!currentVersion.empty())
-            {
-                currentIt = std::find_if(allMigrations.begin(), allMigrations.end(),
-                                         [&currentVersion](const auto &m)
-                                         { return m.first == currentVersion; });
-                if (currentIt == allMigrations.end())
-                {
-                    throw std::runtime_error("Current version " + currentVersion + " not found in migration history");
-                }
-            }
-
-            auto targetIt = std::find_if(allMigrations.begin(), allMigrations.end(),
-                                         [&targetVersion](const auto &m)
-                                         { return m.first == targetVersion; });
-
-            if (targetIt == allMigrations.end())
-            {
-                throw std::runtime_error("Target version " + targetVersion + " not found in migration history");
-            }
+            auto steps = getMigrationSteps(adapter, modelName, currentVersion, targetVersion);
 
             // First clear any current flags for this model
             if (!adapter.executeRawQuery("UPDATE migrations SET is_current = 0 WHERE model_name = ?", {modelName}))
@@ -577,31 +1360,17 @@ namespace ORM
                 throw std::runtime_error("Failed to clear current version flags.");
             }
 
-            // Migrate forward
-            if (currentIt < targetIt)
+            if (!steps.empty())
             {
-                std::cout << "Migrating forward from " << currentVersion << " to " << targetVersion << std::endl;
-                for (auto it = currentIt; it <= targetIt; ++it)
-                {
-                    std::cout << "Applying migration: " << it->first << std::endl;
-                    if (!applyMigration(adapter, modelName, it->first, true))
-                    {
-                        throw std::runtime_error("Failed to apply migration: " + it->first);
-                    }
-                }
+                std::cout << "Migrating " << (steps.front().second ? "forward" : "backward") << " from "
+                          << currentVersion << " to " << targetVersion << std::endl;
             }
-            // Migrate backward
-            else if (currentIt > targetIt)
+            for (const auto &[version, up] : steps)
             {
-                std::cout << "Migrating backward from " << currentVersion << " to " << targetVersion << std::endl;
-                // Need to start from currentIt-1 because we want to roll back the current migration first
-                for (auto it = currentIt; it >= targetIt; --it)
+                std::cout << (up ? "Applying migration: " : "Reverting migration: ") << version << std::endl;
+                if (!applyMigration(adapter, modelName, version, up))
                 {
-                    std::cout << "Reverting migration: " << it->first << std::endl;
-                    if (!applyMigration(adapter, modelName, it->first, false))
-                    {
-                        throw std::runtime_error("Failed to revert migration: " + it->first);
-                    }
+                    throw std::runtime_error(std::string(up ? "Failed to apply migration: " : "Failed to revert migration: ") + version);
                 }
             }
             // After changes, set the target version as current
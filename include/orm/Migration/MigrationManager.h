@@ -3,6 +3,10 @@
 #include "jsonparser.h"
 #include "ModelMacros.h"
 #include "DatabaseTypes.h"
+#include "OnlineSchemaChange.h"
+#include "Backfill.h"
+#include "MigrationLock.h"
+#include "MigrationPlanner.h"
 
 #include <openssl/sha.h>
 #include <string>
@@ -12,7 +16,9 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
+#include <optional>
 #include <ctime>
+#include <chrono>
 #include <functional>
 
 namespace ORM
@@ -25,18 +31,84 @@ namespace ORM
         virtual void down(DatabaseAdapter &adapter) = 0;
     };
 
+    /// ALGORITHM of a MySQL ALTER TABLE, cheapest first
+    enum class AlterAlgorithm
+    {
+        INSTANT, ///< Metadata only
+        INPLACE, ///< No table copy, reads and writes continue (LOCK=NONE)
+        COPY     ///< Rows copied into a rebuilt table, writes blocked meanwhile
+    };
+
+    /// One change of an ALTER TABLE statement
+    struct AlterClause
+    {
+        std::string sql;          ///< e.g. "ADD COLUMN bio TEXT", without "ALTER TABLE <name>"
+        std::string undoSql;      ///< Clause reverting it
+        AlterAlgorithm algorithm; ///< Cheapest algorithm MySQL allows for it
+        std::string reason;       ///< Why it can't be INSTANT, empty if it can
+    };
+
+    /**
+     * @brief Schema changes of one table, computed without touching the database
+     *
+     * All clauses are applied by a single ALTER TABLE, so the table is rebuilt at
+     * most once whatever the number of changes.
+     */
+    struct AlterPlan
+    {
+        std::string tableName;
+        std::vector<AlterClause> clauses;
+
+        bool empty() const { return clauses.empty(); }
+
+        /// Cheapest algorithm every clause allows
+        AlterAlgorithm algorithm() const;
+
+        /// ALTER TABLE applying every clause, with the ALGORITHM (and LOCK) options of algorithm
+        std::string statement(AlterAlgorithm algorithm) const;
+
+        /// ALTER TABLE reverting the plan
+        std::string undoStatement() const;
+    };
+
     class MigrationManager
     {
     public:
         // Intialize the migration system
         static void intialize(DatabaseAdapter &adapter);
 
+        /**
+         * @brief How long an instance waits for another one to finish migrating
+         *
+         * intialize, migrateModel, migrateAll and migrateToVersion hold a MigrationLock
+         * while they change the schema, so concurrent instances don't race on the
+         * same ALTERs. Defaults to 10 minutes.
+         */
+        static void setLockTimeout(std::chrono::seconds timeout);
+
         static void registerMigration(const std::string &version, std::function<std::unique_ptr<MigrationInterface>()> creator);
 
         // main migration method
         static void migrateModel(DatabaseAdapter &adapter, const Model &model);
 
-        // Migration file operation
+        /**
+         * @brief Migrates every model registered with BEGIN_MODEL_DEFINITION
+         *
+         * Loads the current schema hash of all models in one query and hashes each
+         * schema once, so only models whose schema changed (or that were never
+         * migrated) cost any further queries. The migration lock is only taken when
+         * something is out of date; the hashes are read again once it is held, since
+         * the instance that held it before has usually migrated everything already.
+         */
+        static void migrateAll(DatabaseAdapter &adapter);
+
+        /**
+         * @brief Writes migrations/<name>.sql, applied later by migrateToVersion
+         *
+         * The file holds the up and down statements with a checksum (see SqlMigration),
+         * nothing has to be compiled. Migrations registered with registerMigration take
+         * precedence over a file of the same name.
+         */
         static void createMigrationFile(const std::string &name, const std::vector<std::string> &upSql, const std::vector<std::string> &downSql);
 
         // version control
@@ -44,37 +116,169 @@ namespace ORM
         // migrating to specfic version
         static bool migrateToVersion(DatabaseAdapter &adater, const std::string &modelName, const std::string &targetVersion);
 
+        /**
+         * @brief Diffs a model against its last recorded schema
+         * @param model Current model definition
+         * @param oldSchema Schema JSON of the last migration
+         * @return Clauses turning the old table into the model's, empty if there is no DDL to run
+         */
+        static AlterPlan planSchemaChange(const Model &model, const JSON &oldSchema);
+
+        /**
+         * @brief Runs a plan as one ALTER TABLE, with the cheapest algorithm that works
+         *
+         * INSTANT is tried first when every clause allows it, then INPLACE with
+         * LOCK=NONE, then COPY. The next algorithm is only tried when the server
+         * rejects the current one as unsupported, every fallback is logged with its reason.
+         *
+         * @param upSql Receives the statement that was executed, marked with
+         *              SqlMigration::onlineStatement if it ran as an OnlineSchemaChange
+         * @param downSql Receives the statement reverting it, marked the same way
+         * @throws std::runtime_error if the ALTER fails for another reason, or even with ALGORITHM=COPY
+         */
+        static void applyAlterPlan(DatabaseAdapter &adapter, const AlterPlan &plan, std::vector<std::string> &upSql, std::vector<std::string> &downSql);
+
+        /**
+         * @brief Runs one statement of a migration file
+         *
+         * Statements recorded from an online schema change (SqlMigration::onlineStatement)
+         * run as an OnlineSchemaChange again, with the options of enableOnlineSchemaChange
+         * or the defaults. ALTER TABLE statements with ALGORITHM=COPY or without an
+         * ALGORITHM run through applyAlterPlan (the latter trying INSTANT first), so they
+         * go online or are refused by enableRebuildLimits as in migrateModel. Other
+         * statements are executed as they are.
+         *
+         * @throws std::runtime_error if the statement fails
+         */
+        static void replayStatement(DatabaseAdapter &adapter, const std::string &statement);
+
+        /**
+         * @brief Apply changes that need ALGORITHM=COPY with an OnlineSchemaChange instead
+         * @param options Chunking and throttling, tables with fewer than options.minRows
+         *                estimated rows are still copied by the ALTER itself
+         */
+        static void enableOnlineSchemaChange(const OnlineSchemaChangeOptions &options);
+        static void disableOnlineSchemaChange();
+
+        /// Lowercase hex SHA1 of data
+        static std::string sha1Hex(const std::string &data);
+
+        /**
+         * @brief Lists what migrateModel would run for a model, with cost estimates, without running it
+         * @return The CREATE TABLE or the ALTER TABLE (with the algorithm tried first), empty if up to date
+         */
+        static MigrationReport dryRun(DatabaseAdapter &adapter, const Model &model, const MigrationCostOptions &options = {});
+
+        /// dryRun of every model migrateAll would migrate
+        static MigrationReport dryRunAll(DatabaseAdapter &adapter, const MigrationCostOptions &options = {});
+
+        /**
+         * @brief Lists the statements migrateToVersion would run, with cost estimates
+         *
+         * Statements of SQL migration files are listed and estimated as replayStatement
+         * runs them, ALTERs without an ALGORITHM at their worst (COPY). Compiled
+         * migrations only get a note since their statements can't be inspected.
+         *
+         * @throws std::runtime_error if the current or target version isn't in the history
+         */
+        static MigrationReport dryRunToVersion(DatabaseAdapter &adapter, const std::string &modelName, const std::string &targetVersion,
+                                               const MigrationCostOptions &options = {});
+
+        /**
+         * @brief Refuse ALGORITHM=COPY rebuilds of tables above the limits, unless options.allowLargeRebuilds
+         *
+         * applyAlterPlan, and so migrateModel and the ALTERs replayed by migrateToVersion,
+         * then throws instead of blocking writes to a large table for the duration of
+         * the copy. Online schema changes are not affected.
+         */
+        static void enableRebuildLimits(const MigrationCostOptions &options);
+        static void disableRebuildLimits();
+
+        /**
+         * @brief Primary key column of a table, from information_schema
+         * @return The column name, empty if the table has no primary key or a composite one
+         */
+        static std::string getPrimaryKey(DatabaseAdapter &adapter, const std::string &tableName);
+
     private:
         static std::unordered_map<std::string, std::function<std::unique_ptr<MigrationInterface>()>> migrationRegistry;
+        // set while online schema changes are enabled
+        static std::optional<OnlineSchemaChangeOptions> onlineSchemaChange;
+        static std::chrono::seconds lockTimeout;
+        // set while large rebuilds are refused
+        static std::optional<MigrationCostOptions> rebuildLimits;
+        // migrations/*.sql found by intialize, path by migration name
+        static std::unordered_map<std::string, std::string> migrationFiles;
+
+        static void migrateModel(DatabaseAdapter &adapter, const Model &model, const JSON &schemaJSON, const std::string &schemaHash);
 
         // schema opertaions
-        static std::string claculateSchemaHash(const Model &model);
+        static std::string claculateSchemaHash(const JSON &schemaJSON);
         static JSON generateSchemaJSON(const Model &model);
-        static JSON parseSchemaJSON(const std::string &json);
+        // lazy leaves nested field/index definitions unparsed until they are read
+        static JSON parseSchemaJSON(const std::string &json, bool lazy = false);
 
         // Migration Tracking
+        // layout of the migrations table created by this build, upgraded to on intialize
+        static constexpr int MIGRATION_TABLE_VERSION = 2;
         static void ensureMigrationTable(DatabaseAdapter &adapter);
+        static int getMigrationTableVersion(DatabaseAdapter &adapter);
+        static void upgradeMigrationTable(DatabaseAdapter &adapter, int fromVersion);
         static bool migrationExists(DatabaseAdapter &adapter, const std::string &tableName, const std::string &hash);
+        // records a migration before its DDL runs, as pending (applied_at NULL) until markMigrationApplied
         static void createMigrationRecord(DatabaseAdapter &adapter, const std::string &tableName, const std::string &hash, const JSON &schemaJson, const std::string &version);
+        // makes a pending migration the applied, current one of its model
+        static void markMigrationApplied(DatabaseAdapter &adapter, const std::string &tableName, const std::string &version);
+        // stores a new hash and schema JSON on a recorded migration, for a hash change that needs no DDL
+        static void refreshMigrationRecord(DatabaseAdapter &adapter, const std::string &tableName, const std::string &version, const std::string &hash, const JSON &schemaJson);
+        // removes a pending migration whose DDL failed
+        static void discardMigrationRecord(DatabaseAdapter &adapter, const std::string &tableName, const std::string &version);
+        // resolves pending migrations left by a crash: applied if the table already has their schema,
+        // otherwise removed so the change is planned again
+        static void resolveInterruptedMigrations(DatabaseAdapter &adapter, const std::string &tableName);
+        // whether the live table (information_schema) has the columns and indexes of a schema JSON
+        static bool tableMatchesSchema(DatabaseAdapter &adapter, const std::string &tableName, const JSON &schema);
         static JSON getLastMigration(DatabaseAdapter &adapter, const std::string &tableName);
+        // row count estimate from information_schema, 0 if unknown
+        static size_t estimateRows(DatabaseAdapter &adapter, const std::string &tableName);
+        // schema hash of every model with a current migration, by model name
+        static std::unordered_map<std::string, std::string> getCurrentHashes(DatabaseAdapter &adapter);
 
         // Schema Compariasion and alteration
-        static void compareAndUpdateSchema(DatabaseAdapter &adapter, const Model &model, const JSON &oldSchema, std::vector<std::string> &upSql, std::vector<std::string> &downSql);
         static void alterTable(DatabaseAdapter &adapter, const Model &model, const JSON &oldSchema);
-        static void handleFieldChanges(DatabaseAdapter &adapter, const std::string &tableaName, const Field &newField, const JSON &oldField);
-        static void handleDroppedColumn(DatabaseAdapter &adapter, const std::string &tableName, const Model &model, const JSON &oldSchema, std::vector<std::string> &upSql, std::vector<std::string> &downSql);
+        static void handleAddedColumn(const Field &field, AlterPlan &plan);
+        static void handleFieldChanges(const Field &newField, const JSON &oldField, AlterPlan &plan);
+        static void handleDroppedColumn(const Model &model, const JSON &oldSchema, AlterPlan &plan);
+        static void handleDroppedIndexes(const Model &model, const JSON &oldSchema, AlterPlan &plan);
+        static void handleAddedIndexes(const Model &model, const JSON &oldSchema, AlterPlan &plan);
+        static Field fieldFromSchemaJSON(const JSON &fieldJson);
+        // single clause plan whose statement(COPY) is alterSql, as OnlineSchemaChange::run needs;
+        // algorithm is the one applyAlterPlan tries first
+        static AlterPlan planFromStatement(const std::string &alterSql, AlterAlgorithm algorithm);
+        static std::string columnListFromSchemaJSON(const JSON &columns);
 
-        // Version generation
+        // Version generation: local time with milliseconds, e.g. 20250101_120000_000, increasing within a process
         static std::string generateVersionNumber();
 
         // SQL generation helpers
-        static std::string generateColumnDefination(const Field &field);
-        static std::string generateAlterAddColumn(const std::string &tableName, const Field &field);
-        static std::string generateAlterModifyColumn(const std::string &tableName, const Field &field);
-        static std::string generateAlterDropColumn(const std::string &tableName, const std::string &columnName);
+        // withKeys = false leaves out PRIMARY KEY and UNIQUE, for MODIFY COLUMN
+        static std::string generateColumnDefination(const Field &field, bool withKeys = true);
+        // ALTER TABLE clauses, without the "ALTER TABLE <name>" prefix
+        static std::string generateAddColumnClause(const Field &field);
+        static std::string generateModifyColumnClause(const Field &field);
+        static std::string generateDropColumnClause(const std::string &columnName);
+        static std::string generateSetDefaultClause(const std::string &columnName, const std::string &defaultValue);
+        static std::string generateAddIndexClause(const std::string &indexName, const std::string &columnList, bool unique);
+        static std::string generateDropIndexClause(const std::string &indexName);
 
         // migrating to specfic helper function
         static std::vector<std::pair<std::string, JSON>> getAllMigration(DatabaseAdapter &adapter, const std::string &modelName);
         static bool applyMigration(DatabaseAdapter &adapter, const std::string &modelName, const std::string &version, bool up);
+        // versions migrateToVersion runs, in order, with true to apply and false to revert
+        static std::vector<std::pair<std::string, bool>> getMigrationSteps(DatabaseAdapter &adapter, const std::string &modelName,
+                                                                           const std::string &currentVersion, const std::string &targetVersion);
+        // compiled migration or SQL file of a version, empty if neither exists; sqlFile is set for files
+        static std::function<std::unique_ptr<MigrationInterface>()> findMigration(const std::string &modelName, const std::string &version, std::string &sqlFile);
+        static void dryRunModel(DatabaseAdapter &adapter, const Model &model, MigrationCostEstimator &estimator, MigrationReport &report);
     };
 }
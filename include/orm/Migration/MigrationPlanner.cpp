@@ -0,0 +1,196 @@
+#include "MigrationPlanner.h"
+#include "OnlineSchemaChange.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+
+namespace ORM
+{
+    static std::string upper(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                       { return std::toupper(c); });
+        return text;
+    }
+
+    // table name of CREATE/ALTER/DROP TABLE, empty for other statements
+    static std::string statementTable(const std::string &sql, std::string &verb)
+    {
+        std::istringstream in(sql);
+        std::vector<std::string> words;
+        std::string word;
+        while (words.size() < 6 && in >> word)
+            words.push_back(word);
+        if (words.size() < 3 || upper(words[1]) != "TABLE")
+            return "";
+
+        verb = upper(words[0]);
+        size_t i = 2;
+        if (upper(words[2]) == "IF")
+            i = verb == "CREATE" ? 5 : 4; // IF NOT EXISTS, IF EXISTS
+        if (i >= words.size())
+            return "";
+        return words[i].substr(0, words[i].find('('));
+    }
+
+    static std::string formatBytes(uint64_t bytes)
+    {
+        static const char *const units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+        double size = static_cast<double>(bytes);
+        size_t unit = 0;
+        while (size >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0]))
+        {
+            size /= 1024;
+            unit++;
+        }
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << size << " " << units[unit];
+        return out.str();
+    }
+
+    bool MigrationReport::refused() const
+    {
+        for (const auto &statement : statements)
+        {
+            if (statement.refused)
+                return true;
+        }
+        return false;
+    }
+
+    double MigrationReport::seconds() const
+    {
+        double total = 0;
+        for (const auto &statement : statements)
+            total += statement.seconds;
+        return total;
+    }
+
+    void MigrationReport::print(std::ostream &out) const
+    {
+        if (empty())
+        {
+            out << "Nothing to migrate" << std::endl;
+            return;
+        }
+        for (const auto &statement : statements)
+        {
+            out << (statement.refused ? "REFUSED " : "") << "[" << statement.migration << "] " << statement.sql << std::endl;
+            if (!statement.algorithm.empty() || !statement.lock.empty())
+            {
+                out << "    algorithm " << (statement.algorithm.empty() ? "-" : statement.algorithm)
+                    << ", lock " << statement.lock << ", ~" << statement.rows << " rows ("
+                    << formatBytes(statement.tableBytes) << "), ~" << std::fixed << std::setprecision(1)
+                    << statement.seconds << "s, extra disk " << formatBytes(statement.diskBytes) << std::endl;
+            }
+            if (!statement.warning.empty())
+                out << "    " << statement.warning << std::endl;
+        }
+        for (const auto &note : notes)
+            out << note << std::endl;
+        out << "Estimated total: ~" << std::fixed << std::setprecision(1) << seconds() << "s"
+            << (refused() ? ", refused" : "") << std::endl;
+    }
+
+    MigrationCostEstimator::MigrationCostEstimator(DatabaseAdapter &adapter, MigrationCostOptions options,
+                                                   const OnlineSchemaChangeOptions *online)
+        : adapter_(adapter), options_(std::move(options)), online_(online) {}
+
+    PlannedStatement MigrationCostEstimator::estimate(const std::string &sql, bool online)
+    {
+        PlannedStatement planned;
+        planned.sql = sql;
+
+        std::string verb;
+        std::string tableName = statementTable(sql, verb);
+        planned.tableName = tableName;
+
+        if (verb == "CREATE")
+        {
+            planned.lock = "NONE";
+            return planned;
+        }
+        if (verb == "DROP")
+        {
+            planned.lock = "EXCLUSIVE"; // metadata lock, held briefly
+            return planned;
+        }
+        if (tableName.empty() || verb != "ALTER")
+        {
+            planned.warning = "Not estimated, only CREATE, ALTER and DROP TABLE are";
+            return planned;
+        }
+
+        std::string upperSql = upper(sql);
+        const TableStats &stats = tableStats(tableName);
+        planned.rows = stats.rows;
+        planned.tableBytes = stats.bytes;
+        if (upperSql.find("ALGORITHM=INSTANT") != std::string::npos)
+        {
+            planned.algorithm = "INSTANT";
+            planned.lock = "NONE";
+            return planned;
+        }
+
+        // INPLACE and COPY both may write a full copy of the table before dropping the old one
+        planned.seconds = options_.rowsPerSecond > 0 ? stats.rows / options_.rowsPerSecond : 0;
+        planned.diskBytes = stats.bytes;
+        bool large = stats.rows > options_.maxRebuildRows || stats.bytes > options_.maxRebuildBytes;
+
+        if (upperSql.find("ALGORITHM=INPLACE") != std::string::npos)
+        {
+            planned.algorithm = "INPLACE";
+            planned.lock = "NONE";
+            if (large)
+                planned.warning = "Large table rebuilt in place, writes continue but it takes long and needs disk space";
+            return planned;
+        }
+
+        bool assumed = upperSql.find("ALGORITHM=COPY") == std::string::npos;
+        if (online || (online_ && stats.rows >= online_->minRows))
+        {
+            planned.algorithm = "ONLINE";
+            planned.lock = "NONE";
+            if (large)
+                planned.warning = "Large table copied through a shadow table, writes continue";
+            return planned;
+        }
+
+        planned.algorithm = "COPY";
+        planned.lock = "SHARED";
+        if (large)
+        {
+            planned.refused = !options_.allowLargeRebuilds;
+            planned.warning = "Large table copied while writes are blocked";
+            if (planned.refused)
+                planned.warning += ", refused: enable online schema changes or allow large rebuilds";
+        }
+        if (assumed)
+            planned.warning += std::string(planned.warning.empty() ? "" : "; ") + "no ALGORITHM given, estimated as COPY";
+        return planned;
+    }
+
+    const MigrationCostEstimator::TableStats &MigrationCostEstimator::tableStats(const std::string &tableName)
+    {
+        auto cached = stats_.find(tableName);
+        if (cached != stats_.end())
+            return cached->second;
+
+        TableStats stats;
+        auto result = adapter_.executeQuery(
+            "SELECT TABLE_ROWS, DATA_LENGTH, INDEX_LENGTH FROM information_schema.TABLES "
+            "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ?",
+            {tableName});
+        if (!result.empty())
+        {
+            auto &row = result[0];
+            // NULL (fetched as "") for views and tables without statistics
+            stats.rows = row["TABLE_ROWS"].empty() ? 0 : std::stoull(row["TABLE_ROWS"]);
+            stats.bytes = (row["DATA_LENGTH"].empty() ? 0 : std::stoull(row["DATA_LENGTH"])) +
+                          (row["INDEX_LENGTH"].empty() ? 0 : std::stoull(row["INDEX_LENGTH"]));
+        }
+        return stats_.emplace(tableName, stats).first->second;
+    }
+}
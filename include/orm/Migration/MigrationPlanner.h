@@ -0,0 +1,98 @@
+// include/orm/Migration/MigrationPlanner.h
+#pragma once
+#include "DatabaseTypes.h"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ORM
+{
+    struct OnlineSchemaChangeOptions;
+
+    /**
+     * @struct MigrationCostOptions
+     * @brief Limits and throughput used to judge a migration before it runs
+     */
+    struct MigrationCostOptions
+    {
+        size_t maxRebuildRows = 1000000;       /**< Rebuilds of bigger tables are large */
+        uint64_t maxRebuildBytes = 1ull << 30; /**< Rebuilds of tables with more data and indexes are large */
+        bool allowLargeRebuilds = false;       /**< Large rebuilds that block writes are refused unless set */
+        double rowsPerSecond = 50000;          /**< Copy throughput assumed for duration estimates */
+    };
+
+    /// One statement of a dry run with its estimated cost
+    struct PlannedStatement
+    {
+        std::string migration;     ///< Model or migration the statement belongs to
+        std::string tableName;     ///< Table it changes, empty if it couldn't be parsed
+        std::string sql;
+        std::string algorithm;     ///< INSTANT, INPLACE, COPY or ONLINE (shadow table copy), empty if not an ALTER
+        std::string lock;          ///< Writes allowed meanwhile: NONE, SHARED (reads only) or EXCLUSIVE
+        uint64_t rows = 0;         ///< Estimated rows of the table
+        uint64_t tableBytes = 0;   ///< Data and index size of the table
+        double seconds = 0;        ///< Estimated duration
+        uint64_t diskBytes = 0;    ///< Extra disk space needed while it runs (upper bound)
+        std::string warning;       ///< Why it deserves a look, empty if it doesn't
+        bool refused = false;      ///< A large rebuild blocking writes, not allowed by the options
+    };
+
+    /**
+     * @struct MigrationReport
+     * @brief Result of a dry run: what would run, in order, and what it costs
+     */
+    struct MigrationReport
+    {
+        std::vector<PlannedStatement> statements;
+        std::vector<std::string> notes; ///< What the dry run couldn't inspect, e.g. compiled migrations
+
+        bool empty() const { return statements.empty() && notes.empty(); }
+        /// Whether any statement is refused
+        bool refused() const;
+        /// Sum of the estimated durations
+        double seconds() const;
+        void print(std::ostream &out) const;
+    };
+
+    /**
+     * @class MigrationCostEstimator
+     * @brief Estimates duration, lock level and disk space of DDL statements.
+     *
+     * Table sizes come from information_schema.TABLES (TABLE_ROWS, DATA_LENGTH,
+     * INDEX_LENGTH), which InnoDB only approximates. The algorithm is read from the
+     * statement's ALGORITHM option; an ALTER TABLE without one is assumed to copy
+     * the table. Statements other than CREATE, ALTER and DROP TABLE are listed
+     * without an estimate.
+     */
+    class MigrationCostEstimator
+    {
+    public:
+        /**
+         * @param online Set when ALGORITHM=COPY changes of large tables run as an OnlineSchemaChange
+         */
+        MigrationCostEstimator(DatabaseAdapter &adapter, MigrationCostOptions options,
+                               const OnlineSchemaChangeOptions *online = nullptr);
+
+        /**
+         * @param online Set when sql runs as an OnlineSchemaChange whatever the table size,
+         *               e.g. a replayed one (see SqlMigration::onlineStatement)
+         */
+        PlannedStatement estimate(const std::string &sql, bool online = false);
+
+    private:
+        struct TableStats
+        {
+            uint64_t rows = 0;
+            uint64_t bytes = 0;
+        };
+
+        DatabaseAdapter &adapter_;
+        MigrationCostOptions options_;
+        const OnlineSchemaChangeOptions *online_;
+        std::map<std::string, TableStats> stats_; // by table, queried once
+
+        const TableStats &tableStats(const std::string &tableName);
+    };
+}
@@ -0,0 +1,231 @@
+#include "OnlineSchemaChange.h"
+#include "KeyRangeChunks.h"
+#include "MigrationManager.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace ORM
+{
+    static std::string shadowTableName(const std::string &tableName)
+    {
+        return "_" + tableName + "_new";
+    }
+
+    static std::string oldTableName(const std::string &tableName)
+    {
+        return "_" + tableName + "_old";
+    }
+
+    static std::string triggerName(const std::string &tableName, const char *event)
+    {
+        return tableName + "_osc_" + event;
+    }
+
+    static std::string joinColumns(const std::vector<std::string> &columns, const std::string &prefix)
+    {
+        std::string list;
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            if (i > 0)
+                list += ", ";
+            list += prefix + columns[i];
+        }
+        return list;
+    }
+
+    OnlineSchemaChange::OnlineSchemaChange(DatabaseAdapter &adapter, OnlineSchemaChangeOptions options)
+        : adapter_(adapter), options_(std::move(options))
+    {
+        if (options_.chunkSize == 0)
+            options_.chunkSize = 1;
+    }
+
+    void OnlineSchemaChange::run(const AlterPlan &plan)
+    {
+        const std::string &tableName = plan.tableName;
+        std::string alterSql = plan.statement(AlterAlgorithm::COPY);
+
+        ensureCheckpointTable();
+        auto checkpoint = adapter_.executeQuery(
+            "SELECT alter_sql, state, copied_key, max_key, copied_chunks FROM online_schema_changes WHERE table_name = ?",
+            {tableName});
+
+        if (!checkpoint.empty() && !tableExists(shadowTableName(tableName)) && tableExists(oldTableName(tableName)))
+        {
+            // interrupted after the swap, only the clean up is left
+            finish(tableName);
+            return;
+        }
+
+        bool resume = !checkpoint.empty() && checkpoint[0]["alter_sql"] == alterSql &&
+                      tableExists(shadowTableName(tableName)) && triggersExist(tableName);
+        if (resume)
+        {
+            std::cerr << "Online schema change: resuming " << tableName << " after "
+                      << checkpoint[0]["copied_chunks"] << " chunks" << std::endl;
+        }
+        else
+        {
+            if (!checkpoint.empty())
+                std::cerr << "Online schema change: discarding the unfinished change of " << tableName << std::endl;
+            abort(tableName);
+            start(plan, alterSql);
+            checkpoint = adapter_.executeQuery(
+                "SELECT alter_sql, state, copied_key, max_key, copied_chunks FROM online_schema_changes WHERE table_name = ?",
+                {tableName});
+            if (checkpoint.empty())
+                throw std::runtime_error("Online schema change: checkpoint of " + tableName + " not found");
+        }
+
+        copyRows(tableName, std::move(checkpoint[0]));
+        swap(tableName);
+        finish(tableName);
+    }
+
+    void OnlineSchemaChange::abort(const std::string &tableName)
+    {
+        for (const char *event : {"ins", "upd", "del"})
+            execute("DROP TRIGGER IF EXISTS " + triggerName(tableName, event));
+        execute("DROP TABLE IF EXISTS " + shadowTableName(tableName));
+        execute("DELETE FROM online_schema_changes WHERE table_name = ?", {tableName});
+    }
+
+    void OnlineSchemaChange::ensureCheckpointTable()
+    {
+        execute(R"(
+            CREATE TABLE IF NOT EXISTS online_schema_changes (
+                table_name VARCHAR(64) PRIMARY KEY,
+                alter_sql TEXT NOT NULL,
+                state VARCHAR(16) NOT NULL,
+                copied_key VARCHAR(255) NOT NULL DEFAULT '',
+                max_key VARCHAR(255) NOT NULL DEFAULT '',
+                copied_chunks BIGINT NOT NULL DEFAULT 0,
+                updated_at DATETIME DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP
+            )
+        )");
+    }
+
+    void OnlineSchemaChange::start(const AlterPlan &plan, const std::string &alterSql)
+    {
+        const std::string &tableName = plan.tableName;
+        std::string shadow = shadowTableName(tableName);
+
+        std::string key = MigrationManager::getPrimaryKey(adapter_, tableName);
+        if (key.empty())
+            throw std::runtime_error("Online schema change: " + tableName + " needs a single column primary key");
+
+        execute("CREATE TABLE " + shadow + " LIKE " + tableName);
+        AlterPlan shadowPlan = plan;
+        shadowPlan.tableName = shadow;
+        execute(shadowPlan.statement(AlterAlgorithm::COPY)); // the shadow table is still empty
+
+        std::vector<std::string> columns = copiedColumns(tableName);
+        if (MigrationManager::getPrimaryKey(adapter_, shadow) != key)
+        {
+            abort(tableName);
+            throw std::runtime_error("Online schema change: the plan changes the primary key of " + tableName);
+        }
+
+        // from here on every write to the table reaches the shadow table too
+        std::string replace = "REPLACE INTO " + shadow + " (" + joinColumns(columns, "") + ") VALUES (" + joinColumns(columns, "NEW.") + ")";
+        execute("CREATE TRIGGER " + triggerName(tableName, "ins") + " AFTER INSERT ON " + tableName + " FOR EACH ROW " + replace);
+        execute("CREATE TRIGGER " + triggerName(tableName, "upd") + " AFTER UPDATE ON " + tableName + " FOR EACH ROW BEGIN " +
+                "DELETE IGNORE FROM " + shadow + " WHERE " + key + " = OLD." + key + " AND OLD." + key + " <> NEW." + key + "; " +
+                replace + "; END");
+        execute("CREATE TRIGGER " + triggerName(tableName, "del") + " AFTER DELETE ON " + tableName + " FOR EACH ROW " +
+                "DELETE IGNORE FROM " + shadow + " WHERE " + key + " = OLD." + key);
+
+        // rows above the current maximum are inserted after the triggers exist and need no copy
+        auto last = adapter_.executeQuery("SELECT " + key + " AS max_key FROM " + tableName + " ORDER BY " + key + " DESC LIMIT 1", {});
+        std::string state = last.empty() ? "copied" : "copying";
+        std::string maxKey = last.empty() ? "" : last[0]["max_key"];
+
+        execute("INSERT INTO online_schema_changes (table_name, alter_sql, state, max_key) VALUES (?, ?, ?, ?)",
+                {tableName, alterSql, state, maxKey});
+        std::cerr << "Online schema change: copying " << tableName << " into " << shadow << std::endl;
+    }
+
+    void OnlineSchemaChange::copyRows(const std::string &tableName, std::map<std::string, std::string> checkpoint)
+    {
+        if (checkpoint["state"] == "copied")
+            return;
+
+        std::string shadow = shadowTableName(tableName);
+        std::string key = MigrationManager::getPrimaryKey(adapter_, tableName);
+        std::string columnList = joinColumns(copiedColumns(tableName), "");
+
+        KeyRangeChunks chunks(adapter_, tableName, key, options_.chunkSize, options_, "Online schema change");
+        chunks.run(std::stoll(checkpoint["copied_chunks"]) > 0, checkpoint["copied_key"], checkpoint["max_key"],
+                   [&](const std::string &range, const std::vector<std::string> &params)
+                   {
+                       // IGNORE keeps rows the triggers already wrote, they are newer
+                       execute("INSERT IGNORE INTO " + shadow + " (" + columnList + ") SELECT " + columnList + " FROM " + tableName +
+                                   " WHERE " + range + " LOCK IN SHARE MODE",
+                               params);
+                   },
+                   [&](const std::string &chunkEnd, bool done)
+                   {
+                       execute("UPDATE online_schema_changes SET copied_key = ?, copied_chunks = copied_chunks + 1, state = ? WHERE table_name = ?",
+                               {chunkEnd, done ? "copied" : "copying", tableName});
+                   });
+    }
+
+    void OnlineSchemaChange::swap(const std::string &tableName)
+    {
+        execute("RENAME TABLE " + tableName + " TO " + oldTableName(tableName) + ", " +
+                shadowTableName(tableName) + " TO " + tableName);
+    }
+
+    void OnlineSchemaChange::finish(const std::string &tableName)
+    {
+        // the triggers moved to the old table with the rename
+        for (const char *event : {"ins", "upd", "del"})
+            execute("DROP TRIGGER IF EXISTS " + triggerName(tableName, event));
+        if (options_.dropOldTable)
+            execute("DROP TABLE IF EXISTS " + oldTableName(tableName));
+        execute("DELETE FROM online_schema_changes WHERE table_name = ?", {tableName});
+        std::cerr << "Online schema change: " << tableName << " swapped" << std::endl;
+    }
+
+    bool OnlineSchemaChange::tableExists(const std::string &tableName)
+    {
+        return !adapter_.executeQuery(
+                            "SELECT 1 AS found FROM information_schema.TABLES WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ?",
+                            {tableName})
+                    .empty();
+    }
+
+    bool OnlineSchemaChange::triggersExist(const std::string &tableName)
+    {
+        auto triggers = adapter_.executeQuery(
+            "SELECT COUNT(*) AS triggers FROM information_schema.TRIGGERS WHERE TRIGGER_SCHEMA = DATABASE() "
+            "AND EVENT_OBJECT_TABLE = ? AND TRIGGER_NAME IN (?, ?, ?)",
+            {tableName, triggerName(tableName, "ins"), triggerName(tableName, "upd"), triggerName(tableName, "del")});
+        return !triggers.empty() && triggers[0]["triggers"] == "3";
+    }
+
+    std::vector<std::string> OnlineSchemaChange::copiedColumns(const std::string &tableName)
+    {
+        // columns in both tables: dropped ones are left behind, added ones take their default
+        auto rows = adapter_.executeQuery(
+            "SELECT c.COLUMN_NAME FROM information_schema.COLUMNS c JOIN information_schema.COLUMNS s "
+            "ON s.TABLE_SCHEMA = c.TABLE_SCHEMA AND s.TABLE_NAME = ? AND s.COLUMN_NAME = c.COLUMN_NAME "
+            "WHERE c.TABLE_SCHEMA = DATABASE() AND c.TABLE_NAME = ? AND c.EXTRA NOT LIKE '%GENERATED%' "
+            "AND s.EXTRA NOT LIKE '%GENERATED%' ORDER BY c.ORDINAL_POSITION",
+            {shadowTableName(tableName), tableName});
+
+        std::vector<std::string> columns;
+        for (auto &row : rows)
+            columns.push_back(row["COLUMN_NAME"]);
+        if (columns.empty())
+            throw std::runtime_error("Online schema change: no columns to copy from " + tableName);
+        return columns;
+    }
+
+    void OnlineSchemaChange::execute(const std::string &sql, const std::vector<std::string> &params)
+    {
+        if (!adapter_.executeRawQuery(sql, params))
+            throw std::runtime_error("Online schema change failed: " + adapter_.getLastError() + "\n" + sql);
+    }
+}
@@ -0,0 +1,81 @@
+// include/orm/Migration/OnlineSchemaChange.h
+#pragma once
+#include "DatabaseTypes.h"
+#include "LoadThrottle.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ORM
+{
+    struct AlterPlan;
+
+    /**
+     * @struct OnlineSchemaChangeOptions
+     * @brief Chunking and throttling of an OnlineSchemaChange
+     */
+    struct OnlineSchemaChangeOptions : ThrottleOptions
+    {
+        size_t chunkSize = 1000;  /**< Rows per INSERT ... SELECT */
+        size_t minRows = 1000000; /**< MigrationManager alters smaller tables with ALGORITHM=COPY */
+        bool dropOldTable = true; /**< Drop the original table once swapped out */
+    };
+
+    /**
+     * @class OnlineSchemaChange
+     * @brief Applies an AlterPlan without blocking writes to the table.
+     *
+     * A shadow table _<table>_new is created with the new schema and filled
+     * in primary key chunks, while triggers on the original copy every insert,
+     * update and delete into it. Once all rows are copied both tables are swapped
+     * with a single atomic RENAME TABLE.
+     *
+     * Copying pauses while a replica lags behind or the server is busy. Progress is
+     * checkpointed in the online_schema_changes table in the transaction of every
+     * chunk (see KeyRangeChunks), so running the same plan again after a crash
+     * resumes where it stopped.
+     *
+     * The table needs a single column primary key that the plan keeps. Foreign keys
+     * are not copied to the shadow table.
+     *
+     * @example
+     * ORM::OnlineSchemaChangeOptions options;
+     * options.replicas = {&replicaAdapter};
+     * ORM::OnlineSchemaChange(adapter, options).run(MigrationManager::planSchemaChange(User{}, oldSchema));
+     */
+    class OnlineSchemaChange
+    {
+    public:
+        explicit OnlineSchemaChange(DatabaseAdapter &adapter, OnlineSchemaChangeOptions options = {});
+
+        /**
+         * Apply the plan, or resume an interrupted run of the same plan.
+         *
+         * @throws std::runtime_error if the table can't be changed online or a statement fails
+         */
+        void run(const AlterPlan &plan);
+
+        /**
+         * Drop the triggers, shadow table and checkpoint of an unfinished change.
+         * The original table is left untouched.
+         */
+        void abort(const std::string &tableName);
+
+    private:
+        DatabaseAdapter &adapter_;
+        OnlineSchemaChangeOptions options_;
+
+        void ensureCheckpointTable();
+        void start(const AlterPlan &plan, const std::string &alterSql);
+        void copyRows(const std::string &tableName, std::map<std::string, std::string> checkpoint);
+        void swap(const std::string &tableName);
+        void finish(const std::string &tableName);
+
+        // Schema lookups through information_schema
+        bool tableExists(const std::string &tableName);
+        bool triggersExist(const std::string &tableName);
+        std::vector<std::string> copiedColumns(const std::string &tableName);
+
+        void execute(const std::string &sql, const std::vector<std::string> &params = {});
+    };
+}
@@ -0,0 +1,137 @@
+#include "SqlMigration.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace ORM
+{
+    static const char NAME_PREFIX[] = "-- migration: ";
+    static const char CHECKSUM_PREFIX[] = "-- checksum: ";
+    // kept as the first line of the statement it marks, in the file and in memory
+    static const char ONLINE_MARKER[] = "-- online";
+
+    static bool startsWith(const std::string &text, const char *prefix)
+    {
+        return text.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+    }
+
+    SqlMigration SqlMigration::load(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Cannot open migration file " + path);
+        std::stringstream content;
+        content << file.rdbuf();
+        std::string text = content.str();
+
+        // header: name and checksum lines, the checksum covers everything after them
+        size_t nameEnd = text.find('\n');
+        size_t checksumEnd = nameEnd == std::string::npos ? nameEnd : text.find('\n', nameEnd + 1);
+        if (checksumEnd == std::string::npos || !startsWith(text, NAME_PREFIX) ||
+            text.compare(nameEnd + 1, sizeof(CHECKSUM_PREFIX) - 1, CHECKSUM_PREFIX) != 0)
+            throw std::runtime_error("Migration file " + path + " has no migration/checksum header");
+
+        SqlMigration migration;
+        migration.name_ = text.substr(sizeof(NAME_PREFIX) - 1, nameEnd - (sizeof(NAME_PREFIX) - 1));
+        size_t checksumStart = nameEnd + sizeof(CHECKSUM_PREFIX);
+        std::string checksum = text.substr(checksumStart, checksumEnd - checksumStart);
+        std::string body = text.substr(checksumEnd + 1);
+        if (MigrationManager::sha1Hex(body) != checksum)
+            throw std::runtime_error("Migration file " + path + " was modified, its checksum doesn't match");
+
+        std::vector<std::string> *section = nullptr;
+        std::string statement;
+        std::istringstream lines(body);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (statement.empty() && startsWith(line, "--"))
+            {
+                if (line == ONLINE_MARKER && section)
+                    statement = line;
+                else if (line == "-- up")
+                    section = &migration.upSql_;
+                else if (line == "-- down")
+                    section = &migration.downSql_;
+                continue;
+            }
+
+            size_t end = line.find_last_not_of(" \t\r");
+            if (end == std::string::npos && statement.empty())
+                continue;
+            if (!section)
+                throw std::runtime_error("Migration file " + path + " has SQL outside of the up/down sections");
+
+            if (!statement.empty())
+                statement += '\n';
+            statement += line;
+            if (end != std::string::npos && line[end] == ';')
+            {
+                statement.erase(statement.find_last_of(';'));
+                section->push_back(std::move(statement));
+                statement.clear();
+            }
+        }
+        if (!statement.empty())
+            throw std::runtime_error("Migration file " + path + " ends inside a statement (missing ';')");
+        return migration;
+    }
+
+    void SqlMigration::write(const std::string &path, const std::string &name,
+                             const std::vector<std::string> &upSql, const std::vector<std::string> &downSql)
+    {
+        std::string body = "-- up\n";
+        for (const auto &sql : upSql)
+            body += sql + ";\n";
+        body += "-- down\n";
+        for (const auto &sql : downSql)
+            body += sql + ";\n";
+
+        std::ofstream file(path, std::ios::binary);
+        file << NAME_PREFIX << name << "\n"
+             << CHECKSUM_PREFIX << MigrationManager::sha1Hex(body) << "\n"
+             << body;
+        if (!file)
+            throw std::runtime_error("Failed to write migration file " + path);
+    }
+
+    std::string SqlMigration::onlineStatement(const std::string &alterSql)
+    {
+        return std::string(ONLINE_MARKER) + "\n" + alterSql;
+    }
+
+    bool SqlMigration::isOnlineStatement(const std::string &statement, std::string &alterSql)
+    {
+        if (!startsWith(statement, ONLINE_MARKER) || statement.size() <= sizeof(ONLINE_MARKER) ||
+            statement[sizeof(ONLINE_MARKER) - 1] != '\n')
+            return false;
+        alterSql = statement.substr(sizeof(ONLINE_MARKER));
+        return true;
+    }
+
+    void SqlMigration::up(DatabaseAdapter &adapter)
+    {
+        run(adapter, upSql_);
+    }
+
+    void SqlMigration::down(DatabaseAdapter &adapter)
+    {
+        run(adapter, downSql_);
+    }
+
+    void SqlMigration::run(DatabaseAdapter &adapter, const std::vector<std::string> &statements) const
+    {
+        for (const auto &sql : statements)
+        {
+            try
+            {
+                MigrationManager::replayStatement(adapter, sql);
+            }
+            catch (const std::exception &e)
+            {
+                throw std::runtime_error("Migration " + name_ + " failed: " + e.what() + "\n" + sql);
+            }
+        }
+    }
+}
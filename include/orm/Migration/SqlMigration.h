@@ -0,0 +1,73 @@
+// include/orm/Migration/SqlMigration.h
+#pragma once
+#include "MigrationManager.h"
+#include <string>
+#include <vector>
+
+namespace ORM
+{
+    /**
+     * @class SqlMigration
+     * @brief Migration stored as a plain SQL file, loaded at runtime.
+     *
+     * The file lists the up and down statements, each ending with ';' at the end
+     * of a line, after a header with the migration name and a checksum of the rest
+     * of the file:
+     *
+     * @code
+     * -- migration: 20250101_120000_000_after_users
+     * -- checksum: 3f786850e387550fdab836ed7e6dc881de23001b
+     * -- up
+     * ALTER TABLE users ADD COLUMN bio TEXT;
+     * -- down
+     * ALTER TABLE users DROP COLUMN bio;
+     * @endcode
+     *
+     * A file whose checksum doesn't match was edited after it was written and is
+     * refused. A "-- online" line marks the ALTER TABLE after it as one that ran as
+     * an OnlineSchemaChange; it is replayed the same way (see
+     * MigrationManager::replayStatement). Other lines starting with "--" are comments.
+     */
+    class SqlMigration : public MigrationInterface
+    {
+    public:
+        /**
+         * Read and verify a migration file.
+         *
+         * @throws std::runtime_error if the file can't be read, is malformed or fails its checksum
+         */
+        static SqlMigration load(const std::string &path);
+
+        /**
+         * Write a migration file, with its checksum.
+         *
+         * @throws std::runtime_error if the file can't be written
+         */
+        static void write(const std::string &path, const std::string &name,
+                          const std::vector<std::string> &upSql, const std::vector<std::string> &downSql);
+
+        /// alterSql marked to be replayed through an OnlineSchemaChange
+        static std::string onlineStatement(const std::string &alterSql);
+
+        /**
+         * Whether a statement was marked by onlineStatement.
+         *
+         * @param alterSql Receives the statement without the marker
+         */
+        static bool isOnlineStatement(const std::string &statement, std::string &alterSql);
+
+        void up(DatabaseAdapter &adapter) override;
+        void down(DatabaseAdapter &adapter) override;
+
+        const std::string &getName() const { return name_; }
+        const std::vector<std::string> &getUpSql() const { return upSql_; }
+        const std::vector<std::string> &getDownSql() const { return downSql_; }
+
+    private:
+        std::string name_;
+        std::vector<std::string> upSql_;
+        std::vector<std::string> downSql_;
+
+        void run(DatabaseAdapter &adapter, const std::vector<std::string> &statements) const;
+    };
+}
@@ -7,6 +7,7 @@
 #include <typeinfo>
 #include <typeindex>
 #include <map>
+#include <memory_resource>
 
 namespace ORM
 {
@@ -33,6 +34,43 @@ namespace ORM
         }
 
     public:
+        /// Creates a default constructed instance of a model
+        using ModelFactory = std::unique_ptr<Model> (*)();
+
+    private:
+        static std::vector<ModelFactory> &getModelFactories()
+        {
+            static std::vector<ModelFactory> factories;
+            return factories;
+        }
+
+    public:
+        /**
+         * @brief Add a model type to the list returned by getModels().
+         *
+         * Called by BEGIN_MODEL_DEFINITION during static initialization, so every
+         * model defined in the program is registered before main() runs.
+         *
+         * @param factory Creates an instance of the model.
+         * @return Always true, to initialize a static flag.
+         */
+        static bool registerModel(ModelFactory factory)
+        {
+            getModelFactories().push_back(factory);
+            return true;
+        }
+
+        /**
+         * @brief Factories of every model defined with BEGIN_MODEL_DEFINITION.
+         *
+         * Models of one translation unit are in definition order, the order
+         * between translation units is unspecified.
+         */
+        static const std::vector<ModelFactory> &getModels()
+        {
+            return getModelFactories();
+        }
+
         /**
          * @brief Retrieve or create a field list for a given model type.
          *
@@ -50,6 +88,19 @@ namespace ORM
             auto type = std::type_index(typeid(T));
             return registry[type];
         }
+
+        /**
+         * @brief Retrieve or create the model level index list for a given model type.
+         *
+         * @tparam T The model type for which to retrieve the index list.
+         * @return Reference to the vector of IndexDefinition objects.
+         */
+        template <typename T>
+        static std::vector<IndexDefinition> &getIndexes()
+        {
+            static std::vector<IndexDefinition> indexes;
+            return indexes;
+        }
     };
 }
 
@@ -57,54 +108,80 @@ namespace ORM
     class className : public ORM::Model                                                     \
     {                                                                                       \
     public:                                                                                 \
-        className()                                                                         \
+        className() : className(std::pmr::get_default_resource()) {}                        \
+        /* Field values are allocated from resource, e.g. a RequestArena */                 \
+        explicit className(std::pmr::memory_resource *resource) : fieldValues_(resource)    \
         {                                                                                   \
             static bool registered = []() { \
             registerFields(); \
             return true; }();                                            \
+            (void)registered;                                                               \
+            fieldValues_.resize(getFields().size());                                        \
         }                                                                                   \
         const std::string &getTableName() const override                                    \
         {                                                                                   \
             static std::string name = tableName;                                            \
             return name;                                                                    \
         }                                                                                   \
+        static std::unique_ptr<ORM::Model> createInstance()                                 \
+        {                                                                                   \
+            return std::make_unique<className>();                                           \
+        }                                                                                   \
+        /* Lists the model in ORM::ModelRegistry::getModels() before main() */              \
+        inline static const bool modelRegistered_ =                                         \
+            ORM::ModelRegistry::registerModel(&className::createInstance);                  \
         const std::vector<std::unique_ptr<ORM::Field>> &getFields() const override          \
         {                                                                                   \
             return ORM::ModelRegistry::getFields<className>();                              \
         }                                                                                   \
+        const std::vector<ORM::IndexDefinition> &getIndexes() const override               \
+        {                                                                                   \
+            return ORM::ModelRegistry::getIndexes<className>();                             \
+        }                                                                                   \
         void setFieldValue(const std::string &fieldName, const std::string &value) override \
         {                                                                                   \
-            bool fieldExists = false;                                                       \
-            for (const auto &field : getFields())                                           \
+            const auto &fields = getFields();                                               \
+            for (size_t i = 0; i < fields.size(); i++)                                      \
             {                                                                               \
-                if (field->getName() == fieldName)                                          \
+                if (fields[i]->getName() == fieldName)                                      \
                 {                                                                           \
-                    fieldExists = true;                                                     \
-                    break;                                                                  \
+                    fieldValues_[i].assign(value.data(), value.size());                     \
+                    return;                                                                 \
                 }                                                                           \
             }                                                                               \
-            if (!fieldExists)                                                               \
-            {                                                                               \
-                throw std::runtime_error("Field '" + fieldName + "' does not exist");       \
-            }                                                                               \
-            fieldValues_[fieldName] = value;                                                \
+            throw std::runtime_error("Field '" + fieldName + "' does not exist");           \
         }                                                                                   \
         std::string getFieldValue(const std::string &fieldName) const override              \
         {                                                                                   \
-            auto it = fieldValues_.find(fieldName);                                         \
-            return it != fieldValues_.end() ? it->second : "";                              \
+            const auto &fields = getFields();                                               \
+            for (size_t i = 0; i < fields.size(); i++)                                      \
+            {                                                                               \
+                if (fields[i]->getName() == fieldName)                                      \
+                    return std::string(fieldValues_[i].data(), fieldValues_[i].size());     \
+            }                                                                               \
+            return "";                                                                      \
         }                                                                                   \
                                                                                             \
     private:                                                                                \
-        std::unordered_map<std::string, std::string> fieldValues_;                          \
+        /* One value per registered field, in FIELD order */                                \
+        std::pmr::vector<std::pmr::string> fieldValues_;                                    \
         static void registerFields()                                                        \
         {                                                                                   \
-            auto &fields = ORM::ModelRegistry::getFields<className>();
+            auto &fields = ORM::ModelRegistry::getFields<className>();                      \
+            auto &indexes = ORM::ModelRegistry::getIndexes<className>();                    \
+            (void)indexes;
 
 #define FIELD(name, type, ...)                                                    \
     fields.emplace_back(std::make_unique<ORM::Field>(#name, ORM::FieldType::type, \
                                                      ORM::FieldOptions{__VA_ARGS__}));
 
+// Composite / covering index, columns are names or ORM::IndexColumn{"name", prefixLength}
+#define INDEX(name, ...) \
+    indexes.push_back(ORM::IndexDefinition{#name, {__VA_ARGS__}, false});
+
+#define UNIQUE_INDEX(name, ...) \
+    indexes.push_back(ORM::IndexDefinition{#name, {__VA_ARGS__}, true});
+
 #define END_MODEL_DEFINITION() \
     }                          \
     }                          \
@@ -0,0 +1,61 @@
+// include/orm/RequestArena.h
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace ORM
+{
+    /**
+     * @class RequestArena
+     * @brief Monotonic memory arena for everything allocated while serving one request.
+     *
+     * Allocations are bump-pointer cheap and individual frees are no-ops; all memory
+     * is returned at once by release() or when the arena is destroyed. Result sets,
+     * models and JSON documents created with resource() must not outlive the arena.
+     *
+     * @example
+     * ORM::RequestArena arena;
+     * auto rows = adapter.fetchAllFromQuery("SELECT * FROM users", arena.resource());
+     * User user(arena.resource());
+     */
+    class RequestArena
+    {
+    public:
+        /**
+         * @param initialSize Size of the first block, further blocks are taken from upstream.
+         *        0 means no owned block, every block comes from upstream
+         * @param upstream Resource the arena grows from once the first block is used up
+         */
+        explicit RequestArena(size_t initialSize = 64 * 1024,
+                              std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : buffer_(initialSize > 0 ? std::make_unique<std::byte[]>(initialSize) : nullptr),
+              resource_(makeResource(buffer_.get(), initialSize, upstream)) {}
+
+        RequestArena(const RequestArena &) = delete;
+        RequestArena &operator=(const RequestArena &) = delete;
+
+        /**
+         * Get the memory resource to pass to pmr containers and ORM calls.
+         */
+        std::pmr::memory_resource *resource() { return &resource_; }
+
+        /**
+         * Free everything allocated from the arena in one shot, the first block is reused.
+         */
+        void release() { resource_.release(); }
+
+    private:
+        // monotonic_buffer_resource requires a non-null buffer of non-zero size
+        static std::pmr::monotonic_buffer_resource makeResource(std::byte *buffer, size_t size,
+                                                                std::pmr::memory_resource *upstream)
+        {
+            if (size == 0)
+                return std::pmr::monotonic_buffer_resource(upstream);
+            return std::pmr::monotonic_buffer_resource(buffer, size, upstream);
+        }
+
+        std::unique_ptr<std::byte[]> buffer_;         /**< First block, owned by the arena */
+        std::pmr::monotonic_buffer_resource resource_; /**< Bump allocator over buffer_ */
+    };
+}
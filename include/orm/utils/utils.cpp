@@ -1,4 +1,6 @@
 #include "utils.h"
+#include "DatabaseTypes.h"
+#include <charconv>
 
 std::string getCurrentDateTime()
 {
@@ -90,15 +92,202 @@ void printRow(const std::map<std::string, std::string> &row)
 JSON serializationTOJSONNode(std::vector<std::map<std::string, std::string>> &rows)
 {
     JSON jsonArray(JSONType::ARRAY);
+    jsonArray.reserve(rows.size());
 
+    // every row has the same column names, store each one once
+    JSONKeyTable columns;
     for (const auto &row : rows)
     {
-        JSON obj(JSONType::OBJECT);
+        JSON &obj = jsonArray.emplaceArray(JSONType::OBJECT);
+        obj.reserve(row.size());
         for (const auto &pair : row)
         {
-            obj[pair.first] = JSON(pair.second);
+            obj.tryEmplace(pair.first, JSON(pair.second), &columns);
         }
-        jsonArray.appendArray(obj);
     }
     return jsonArray;
+}
+
+void serializationTOJSON(const std::vector<std::map<std::string, std::string>> &rows, JSONWriter &writer)
+{
+    writer.beginArray();
+    for (const auto &row : rows)
+    {
+        writer.beginObject();
+        for (const auto &pair : row)
+        {
+            writer.key(pair.first).value(pair.second);
+        }
+        writer.endObject();
+    }
+    writer.endArray();
+}
+
+namespace
+{
+    /**
+     * FNV-1a hash of the field names and types, stored in every model record so a
+     * record is never decoded against a different field list.
+     */
+    uint32_t fieldListFingerprint(const ORM::Model &model)
+    {
+        uint32_t hash = 2166136261u;
+        auto mix = [&hash](unsigned char c)
+        {
+            hash ^= c;
+            hash *= 16777619u;
+        };
+        for (const auto &field : model.getFields())
+        {
+            for (char c : field->getName())
+                mix(static_cast<unsigned char>(c));
+            mix(static_cast<unsigned char>(field->getType()));
+        }
+        return hash;
+    }
+
+    // Value header varints: 0/1 (or 0 for doubles) select the compact form,
+    // anything above carries the length of a verbatim string.
+    constexpr uint64_t RAW_INTEGER_BASE = 1;
+    constexpr uint64_t RAW_DOUBLE_BASE = 1;
+    constexpr uint64_t RAW_BOOLEAN_BASE = 2;
+
+    void writeFieldValue(BinaryWriter &writer, ORM::FieldType type, const std::string &value)
+    {
+        const char *begin = value.data();
+        const char *end = value.data() + value.size();
+        char buf[32];
+
+        switch (type)
+        {
+        case ORM::FieldType::INTEGER:
+        {
+            int64_t number;
+            auto [ptr, ec] = std::from_chars(begin, end, number);
+            if (ec == std::errc() && ptr == end && std::to_chars(buf, buf + sizeof(buf), number).ptr - buf == static_cast<long>(value.size()))
+            {
+                writer.writeVarint(0);
+                writer.writeZigZag(number);
+                return;
+            }
+            writer.writeVarint(value.size() + RAW_INTEGER_BASE);
+            writer.writeRaw(value);
+            return;
+        }
+        case ORM::FieldType::FLOAT:
+        case ORM::FieldType::DOUBLE:
+        {
+            double number;
+            auto [ptr, ec] = std::from_chars(begin, end, number);
+            if (ec == std::errc() && ptr == end)
+            {
+                auto out = std::to_chars(buf, buf + sizeof(buf), number);
+                if (out.ec == std::errc() && std::string_view(buf, out.ptr - buf) == value)
+                {
+                    writer.writeVarint(0);
+                    writer.writeDouble(number);
+                    return;
+                }
+            }
+            writer.writeVarint(value.size() + RAW_DOUBLE_BASE);
+            writer.writeRaw(value);
+            return;
+        }
+        case ORM::FieldType::BOOLEAN:
+            if (value == "0" || value == "1")
+            {
+                writer.writeVarint(value == "1");
+                return;
+            }
+            writer.writeVarint(value.size() + RAW_BOOLEAN_BASE);
+            writer.writeRaw(value);
+            return;
+        default:
+            writer.writeString(value);
+            return;
+        }
+    }
+
+    std::string readFieldValue(BinaryReader &reader, ORM::FieldType type)
+    {
+        char buf[32];
+
+        switch (type)
+        {
+        case ORM::FieldType::INTEGER:
+        {
+            uint64_t header = reader.readVarint();
+            if (header >= RAW_INTEGER_BASE)
+                return std::string(reader.readRaw(header - RAW_INTEGER_BASE));
+            auto out = std::to_chars(buf, buf + sizeof(buf), reader.readZigZag());
+            return std::string(buf, out.ptr);
+        }
+        case ORM::FieldType::FLOAT:
+        case ORM::FieldType::DOUBLE:
+        {
+            uint64_t header = reader.readVarint();
+            if (header >= RAW_DOUBLE_BASE)
+                return std::string(reader.readRaw(header - RAW_DOUBLE_BASE));
+            auto out = std::to_chars(buf, buf + sizeof(buf), reader.readDouble());
+            return std::string(buf, out.ptr);
+        }
+        case ORM::FieldType::BOOLEAN:
+        {
+            uint64_t header = reader.readVarint();
+            if (header >= RAW_BOOLEAN_BASE)
+                return std::string(reader.readRaw(header - RAW_BOOLEAN_BASE));
+            return header ? "1" : "0";
+        }
+        default:
+            return std::string(reader.readString());
+        }
+    }
+}
+
+std::string serializationTOBinary(const ORM::Model &model)
+{
+    const auto &fields = model.getFields();
+
+    std::string out;
+    out.reserve(16 + fields.size() * 8);
+    BinaryWriter writer(out);
+    writer.writeByte(BINARY_TAG_MODEL);
+    writer.writeByte(BINARY_FORMAT_VERSION);
+    writer.writeVarint(fieldListFingerprint(model));
+    writer.writeVarint(fields.size());
+
+    // presence bitmap, unset (empty) fields are not written at all
+    size_t bitmap = writer.position();
+    out.append((fields.size() + 7) / 8, '\0');
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        std::string value = model.getFieldValue(fields[i]->getName());
+        if (value.empty())
+            continue;
+
+        out[bitmap + i / 8] = static_cast<char>(out[bitmap + i / 8] | (1u << (i % 8)));
+        writeFieldValue(writer, fields[i]->getType(), value);
+    }
+    return out;
+}
+
+void deserializationFROMBinary(std::string_view data, ORM::Model &model)
+{
+    const auto &fields = model.getFields();
+
+    BinaryReader reader(data);
+    reader.readHeader(BINARY_TAG_MODEL);
+    if (reader.readVarint() != fieldListFingerprint(model) || reader.readVarint() != fields.size())
+        throw std::runtime_error("binary record does not match the fields of " + model.getTableName());
+
+    std::string_view present = reader.readRaw((fields.size() + 7) / 8);
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        if (!(static_cast<uint8_t>(present[i / 8]) & (1u << (i % 8))))
+        {
+            model.setFieldValue(fields[i]->getName(), "");
+            continue;
+        }
+        model.setFieldValue(fields[i]->getName(), readFieldValue(reader, fields[i]->getType()));
+    }
 }
\ No newline at end of file
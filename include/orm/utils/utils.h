@@ -4,6 +4,13 @@
 #include <ctime>
 #include <map>
 #include "serializer/jsonparser.h"
+#include "serializer/binaryserializer.h"
+#include "serializer/jsonwriter.h"
+
+namespace ORM
+{
+    class Model;
+}
 
 std::string getCurrentDateTime();
 
@@ -11,4 +18,28 @@ void printRows(const std::vector<std::map<std::string, std::string>> &rows);
 
 void printRow(const std::map<std::string, std::string> &row);
 
-JSON serializationTOJSONNode(std::vector<std::map<std::string, std::string>> &rows);
\ No newline at end of file
+JSON serializationTOJSONNode(std::vector<std::map<std::string, std::string>> &rows);
+
+/**
+ * Write rows as a JSON array of objects (all values as strings) straight into
+ * writer, without building a JSON tree first.
+ */
+void serializationTOJSON(const std::vector<std::map<std::string, std::string>> &rows, JSONWriter &writer);
+
+/**
+ * Encode a model into the compact binary model format.
+ *
+ * Fields are written in the order of the model's FIELD list, behind a presence
+ * bitmap and a fingerprint of the field names/types. INTEGER and BOOLEAN values
+ * become varints, FLOAT/DOUBLE 8 byte doubles and everything else length
+ * prefixed strings. Values that would not reproduce the exact same text (e.g.
+ * "007" in an INTEGER field) are kept as strings.
+ */
+std::string serializationTOBinary(const ORM::Model &model);
+
+/**
+ * Decode a binary model record into an existing model instance.
+ *
+ * @throws std::runtime_error if the record is malformed or was written for a different field list
+ */
+void deserializationFROMBinary(std::string_view data, ORM::Model &model);
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "binaryserializer.h"
+
+BinaryRowSetReader::BinaryRowSetReader(std::string_view data) : d_reader(data)
+{
+    d_reader.readHeader(BINARY_TAG_ROWSET);
+
+    // counts come from the input: every column name takes at least one byte
+    uint64_t columnCount = d_reader.readVarint();
+    if (columnCount > d_reader.remaining())
+        throw std::runtime_error("binary result set has more columns than bytes");
+    d_columns.reserve(columnCount);
+    for (uint64_t i = 0; i < columnCount; i++)
+    {
+        d_columns.push_back(d_reader.readString());
+    }
+    d_rows = d_reader.readVarint();
+    // every row takes at least its null bitmap, a result set without columns has no rows
+    size_t rowSize = (d_columns.size() + 7) / 8;
+    if (rowSize == 0 ? d_rows != 0 : d_rows > d_reader.remaining() / rowSize)
+        throw std::runtime_error("binary result set has more rows than bytes");
+}
+
+bool BinaryRowSetReader::next(std::vector<std::optional<std::string_view>> &row)
+{
+    if (d_read == d_rows)
+        return false;
+
+    std::string_view nulls = d_reader.readRaw((d_columns.size() + 7) / 8);
+    row.resize(d_columns.size());
+    for (size_t i = 0; i < d_columns.size(); i++)
+    {
+        if (static_cast<uint8_t>(nulls[i / 8]) & (1u << (i % 8)))
+            row[i] = std::nullopt;
+        else
+            row[i] = d_reader.readString();
+    }
+    d_read++;
+    return true;
+}
+
+std::string encodeRowSet(const std::vector<std::map<std::string, std::string>> &rows)
+{
+    std::string out;
+    BinaryWriter writer(out);
+    writer.writeByte(BINARY_TAG_ROWSET);
+    writer.writeByte(BINARY_FORMAT_VERSION);
+
+    std::vector<const std::string *> columns;
+    if (!rows.empty())
+    {
+        for (const auto &pair : rows[0])
+        {
+            columns.push_back(&pair.first);
+        }
+    }
+    writer.writeVarint(columns.size());
+    for (const auto *column : columns)
+    {
+        writer.writeString(*column);
+    }
+
+    // a result set without columns has no rows (see BinaryRowSetReader), its rows write nothing
+    writer.writeVarint(columns.empty() ? 0 : rows.size());
+    size_t bitmapSize = (columns.size() + 7) / 8;
+    for (const auto &row : rows)
+    {
+        size_t bitmap = writer.position();
+        out.append(bitmapSize, '\0');
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            auto it = row.find(*columns[i]);
+            if (it == row.end() || it->second == "NULL")
+            {
+                out[bitmap + i / 8] = static_cast<char>(out[bitmap + i / 8] | (1u << (i % 8)));
+                continue;
+            }
+            writer.writeString(it->second);
+        }
+    }
+    return out;
+}
+
+std::vector<std::map<std::string, std::string>> decodeRowSet(std::string_view data)
+{
+    BinaryRowSetReader reader(data);
+    std::vector<std::map<std::string, std::string>> rows;
+    rows.reserve(reader.rowCount()); // bounded by the input size in the reader
+
+    std::vector<std::optional<std::string_view>> values;
+    while (reader.next(values))
+    {
+        std::map<std::string, std::string> row;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            row.emplace(reader.columns()[i], values[i] ? *values[i] : std::string_view("NULL"));
+        }
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
@@ -0,0 +1,239 @@
+#ifndef _BINARY_SERIALIZER_H_
+#define _BINARY_SERIALIZER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file binaryserializer.h
+ * @brief Compact, versioned binary encoding primitives
+ *
+ * Layout conventions shared by every binary record:
+ * - unsigned integers are LEB128 varints
+ * - signed integers are zigzag encoded varints
+ * - doubles are 8 byte little-endian IEEE 754
+ * - strings are a varint length followed by the raw bytes
+ *
+ * Every record starts with a one byte record tag and a one byte format version.
+ */
+
+/// Current version of the binary record formats
+constexpr uint8_t BINARY_FORMAT_VERSION = 1;
+
+/// Record tag of an encoded model instance
+constexpr uint8_t BINARY_TAG_MODEL = 'M';
+
+/// Record tag of an encoded result set
+constexpr uint8_t BINARY_TAG_ROWSET = 'R';
+
+/**
+ * @class BinaryWriter
+ * @brief Appends binary encoded values to a caller provided buffer
+ */
+class BinaryWriter
+{
+    std::string &d_out; ///< Destination buffer
+
+public:
+    explicit BinaryWriter(std::string &out) : d_out(out) {}
+
+    void writeByte(uint8_t value)
+    {
+        d_out.push_back(static_cast<char>(value));
+    }
+
+    void writeVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            d_out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        d_out.push_back(static_cast<char>(value));
+    }
+
+    void writeZigZag(int64_t value)
+    {
+        writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void writeDouble(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++)
+        {
+            d_out.push_back(static_cast<char>(bits >> (i * 8)));
+        }
+    }
+
+    void writeRaw(std::string_view bytes)
+    {
+        d_out.append(bytes.data(), bytes.size());
+    }
+
+    /// Length prefixed string
+    void writeString(std::string_view value)
+    {
+        writeVarint(value.size());
+        writeRaw(value);
+    }
+
+    /// Current size of the destination buffer, used to patch bitmaps in place
+    size_t position() const { return d_out.size(); }
+
+    std::string &buffer() { return d_out; }
+};
+
+/**
+ * @class BinaryReader
+ * @brief Reads binary encoded values from a buffer without copying it
+ *
+ * Strings are returned as views into the source buffer, which must outlive them.
+ * @throws std::runtime_error on truncated or malformed input
+ */
+class BinaryReader
+{
+    const char *d_pos; ///< Current read position
+    const char *d_end; ///< End of the input
+
+    void require(size_t n) const
+    {
+        if (static_cast<size_t>(d_end - d_pos) < n)
+            throw std::runtime_error("binary record is truncated");
+    }
+
+public:
+    explicit BinaryReader(std::string_view data) : d_pos(data.data()), d_end(data.data() + data.size()) {}
+
+    uint8_t readByte()
+    {
+        require(1);
+        return static_cast<uint8_t>(*d_pos++);
+    }
+
+    uint64_t readVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = readByte();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("binary varint is too long");
+    }
+
+    int64_t readZigZag()
+    {
+        uint64_t value = readVarint();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    double readDouble()
+    {
+        require(8);
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            bits |= static_cast<uint64_t>(static_cast<uint8_t>(d_pos[i])) << (i * 8);
+        }
+        d_pos += 8;
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string_view readRaw(size_t n)
+    {
+        require(n);
+        std::string_view bytes(d_pos, n);
+        d_pos += n;
+        return bytes;
+    }
+
+    /// Length prefixed string, as a view into the input
+    std::string_view readString()
+    {
+        return readRaw(readVarint());
+    }
+
+    /**
+     * @brief Reads and checks the record tag and format version
+     * @throws std::runtime_error if the tag or version doesn't match
+     */
+    void readHeader(uint8_t tag)
+    {
+        if (readByte() != tag)
+            throw std::runtime_error("binary record has an unexpected type");
+        if (readByte() != BINARY_FORMAT_VERSION)
+            throw std::runtime_error("binary record has an unsupported format version");
+    }
+
+    bool atEnd() const { return d_pos == d_end; }
+
+    /// Bytes left to read, bounds counts read from untrusted input
+    size_t remaining() const { return static_cast<size_t>(d_end - d_pos); }
+};
+
+/**
+ * @class BinaryRowSetReader
+ * @brief Zero-copy cursor over an encoded result set
+ *
+ * Result set layout (after the 'R' tag and version):
+ * varint column count, column names, varint row count, then per row
+ * a null bitmap (one bit per column) followed by the non-null values.
+ *
+ * @example
+ * BinaryRowSetReader reader(buffer);
+ * std::vector<std::optional<std::string_view>> row;
+ * while (reader.next(row)) { ... }
+ */
+class BinaryRowSetReader
+{
+    BinaryReader d_reader;
+    std::vector<std::string_view> d_columns;
+    uint64_t d_rows = 0;
+    uint64_t d_read = 0;
+
+public:
+    explicit BinaryRowSetReader(std::string_view data);
+
+    /// Column names, as views into the input buffer
+    const std::vector<std::string_view> &columns() const { return d_columns; }
+
+    /// Total number of rows in the result set
+    uint64_t rowCount() const { return d_rows; }
+
+    /**
+     * @brief Reads the next row
+     * @param row Receives one entry per column, std::nullopt for SQL NULL
+     * @return false once all rows have been read
+     */
+    bool next(std::vector<std::optional<std::string_view>> &row);
+};
+
+/**
+ * @brief Encodes result set rows into the binary result set format
+ *
+ * Columns are taken from the first row. A column missing from a row, or holding "NULL" as
+ * fetchAllFromQuery renders SQL NULL, is encoded as NULL.
+ */
+std::string encodeRowSet(const std::vector<std::map<std::string, std::string>> &rows);
+
+/**
+ * @brief Decodes a binary result set back into rows
+ *
+ * SQL NULL comes back as the string "NULL", like MySQLAdapter::fetchAllFromQuery renders it.
+ * @throws std::runtime_error on malformed input
+ */
+std::vector<std::map<std::string, std::string>> decodeRowSet(std::string_view data);
+
+#endif
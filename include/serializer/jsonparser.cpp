@@ -1,319 +1,1115 @@
 #include "jsonparser.h"
+#include "jsonstructural.h"
+#include "jsonwriter.h"
 
-/**
- * @brief Finds matching pairs of opening and closing braces in a given string.
- *
- * @param s The input string containing braces.
- * @param bracePairs A reference to an unordered_map that stores
- *                   matched brace pairs (opening index -> closing index).
- */
-void findBarcePairs(const std::string &s, std::unordered_map<int, int> &bracePairs)
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JSON_HAVE_MMAP 1
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+/// Text and structural index shared by all lazy nodes of one parseLazy document
+struct JSONNode::LazyDocument
+{
+    std::string text;
+    std::vector<uint32_t> index; ///< Token offsets, see buildStructuralIndex
+    std::vector<uint32_t> match; ///< For '{' / '[' tokens, the token number of the closing bracket
+};
+
+/// Payload of a lazy array/object: where its opening bracket is, and the parsed
+/// array/object once a reader needed it
+struct JSONNode::Lazy
+{
+    Lazy(std::shared_ptr<const LazyDocument> document, uint32_t token) : document(std::move(document)), token(token) {}
+
+    std::shared_ptr<const LazyDocument> document;
+    uint32_t token; ///< Token number of the opening bracket
+    std::mutex parsing;               ///< Held by the reader parsing the text
+    std::atomic<bool> parsed{false}; ///< Set (release) once node holds the parsed array/object
+    JSONNode node;
+};
+
+namespace
 {
-    std::vector<int> stack;
-    int n = s.length();
-    for (int i = 0; i < n; i++)
+    /// Header in front of the characters of a SHARED_STRING node
+    struct SharedStringHeader
     {
-        if (s[i] == '[' || s[i] == '{')
+        std::atomic<uint32_t> references;
+    };
+
+    SharedStringHeader *sharedHeader(const char *chars)
+    {
+        return reinterpret_cast<SharedStringHeader *>(const_cast<char *>(chars) - sizeof(SharedStringHeader));
+    }
+}
+
+JSONNode::JSONNode(JSONType type) : d_number(0), d_type(type)
+{
+    switch (type)
+    {
+    case JSONType::STRING:
+        d_chars = "";
+        break;
+    case JSONType::BOOL:
+        d_bool = false;
+        break;
+    case JSONType::ARRAY:
+        d_array = new Array();
+        d_flags = OWNS_PAYLOAD;
+        break;
+    case JSONType::OBJECT:
+        d_object = new Object();
+        d_flags = OWNS_PAYLOAD;
+        break;
+    case JSONType::NUMBER:
+    case JSONType::NULLT:
+        break;
+    }
+}
+
+JSONNode::JSONNode(const std::vector<JSONNode> &nodes) : d_array(new Array(nodes.begin(), nodes.end())), d_type(JSONType::ARRAY), d_flags(OWNS_PAYLOAD) {}
+
+void JSONNode::setString(std::string_view value)
+{
+    if (value.empty())
+    {
+        d_chars = "";
+        d_length = 0;
+        return;
+    }
+    if (value.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("JSON string is too long");
+
+    char *chars = new char[value.size() + 1];
+    std::memcpy(chars, value.data(), value.size());
+    chars[value.size()] = '\0';
+    d_chars = chars;
+    d_length = static_cast<uint32_t>(value.size());
+    d_flags |= OWNS_PAYLOAD;
+}
+
+void JSONNode::setString(std::string_view value, std::pmr::memory_resource *arena)
+{
+    if (value.empty())
+    {
+        d_chars = "";
+        d_length = 0;
+        return;
+    }
+    if (value.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("JSON string is too long");
+
+    char *chars = static_cast<char *>(arena->allocate(value.size(), 1));
+    std::memcpy(chars, value.data(), value.size());
+    d_chars = chars;
+    d_length = static_cast<uint32_t>(value.size());
+}
+
+void JSONNode::setSharedString(std::string_view value)
+{
+    if (value.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("JSON string is too long");
+
+    char *block = new char[sizeof(SharedStringHeader) + value.size() + 1];
+    new (block) SharedStringHeader{{1}};
+    char *chars = block + sizeof(SharedStringHeader);
+    std::memcpy(chars, value.data(), value.size());
+    chars[value.size()] = '\0';
+    d_chars = chars;
+    d_length = static_cast<uint32_t>(value.size());
+    d_flags |= OWNS_PAYLOAD | SHARED_STRING;
+}
+
+void JSONNode::copyFrom(const JSONNode &other)
+{
+    d_type = other.d_type;
+    switch (d_type)
+    {
+    case JSONType::NUMBER:
+        if (other.d_flags & INTEGER_NUMBER)
+            d_integer = other.d_integer;
+        else
+            d_number = other.d_number;
+        d_flags = other.d_flags & INTEGER_NUMBER;
+        break;
+    case JSONType::BOOL:
+        d_bool = other.d_bool;
+        break;
+    case JSONType::STRING:
+        if (other.d_flags & SHARED_STRING)
+        {
+            sharedHeader(other.d_chars)->references.fetch_add(1, std::memory_order_relaxed);
+            d_chars = other.d_chars;
+            d_length = other.d_length;
+            d_flags = OWNS_PAYLOAD | SHARED_STRING;
+        }
+        else
+        {
+            setString(other.stringView());
+        }
+        break;
+    case JSONType::ARRAY:
+    case JSONType::OBJECT:
+        if ((other.d_flags & LAZY_PAYLOAD) && !other.d_lazy->parsed.load(std::memory_order_acquire))
+        {
+            // still unparsed, share the document
+            d_lazy = new Lazy{other.d_lazy->document, other.d_lazy->token};
+            d_flags = OWNS_PAYLOAD | LAZY_PAYLOAD;
+        }
+        else if (d_type == JSONType::ARRAY)
         {
-            stack.push_back(i);
+            d_array = new Array(other.arrayStorage());
+            d_flags = OWNS_PAYLOAD;
         }
-        else if (s[i] == ']' || s[i] == '}')
+        else
         {
-            bracePairs[stack.back()] = i;
-            stack.pop_back();
+            d_object = new Object(other.objectStorage());
+            d_flags = OWNS_PAYLOAD;
         }
+        break;
+    case JSONType::NULLT:
+        break;
     }
 }
 
-/**
- * @brief Checks if a given character is a whitespace character.
- *
- * @param c The character to check.
- * @return true if c is a whitespace character, false otherwise.
- */
-bool isWhiteSpace(char c)
+void JSONNode::takeFrom(JSONNode &other) noexcept
 {
-    return c == ' ' || c == '\n';
+    switch (other.d_type)
+    {
+    case JSONType::NUMBER:
+        if (other.d_flags & INTEGER_NUMBER)
+            d_integer = other.d_integer;
+        else
+            d_number = other.d_number;
+        break;
+    case JSONType::BOOL:
+        d_bool = other.d_bool;
+        break;
+    case JSONType::STRING:
+        d_chars = other.d_chars;
+        break;
+    case JSONType::ARRAY:
+        d_array = other.d_array;
+        break;
+    case JSONType::OBJECT:
+        d_object = other.d_object;
+        break;
+    case JSONType::NULLT:
+        break;
+    }
+    d_length = other.d_length;
+    d_type = other.d_type;
+    d_flags = other.d_flags;
+
+    other.d_type = JSONType::NULLT;
+    other.d_length = 0;
+    other.d_flags = 0;
 }
 
-/**
- * @brief Checks if a given string represents a valid floating-point number (double).
- *
- * @param s The input string to check.
- * @return true if the string represents a valid double, false otherwise.
- */
-bool isDouble(const std::string &s)
+void JSONNode::release() noexcept
 {
-    if (s.empty()) return false;
-    int i = 0;
-    if (s[0] == '+' || s[0] == '-')
-        i++;
-
-    bool dotseen = 0;
-
-    while (i < s.length())
+    switch (d_type)
     {
-        // if charctot is not number and not . then return false
-        if (!std::isdigit(s[i]) && s[i] != '.')
-            return false;
-
-        if (s[i] == '.')
+    case JSONType::STRING:
+        if (!(d_flags & SHARED_STRING))
+        {
+            delete[] d_chars;
+        }
+        else if (sharedHeader(d_chars)->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
         {
-            // if dot is already seen return false
-            if (dotseen)
-                return false;
-            dotseen = true;
+            SharedStringHeader *header = sharedHeader(d_chars);
+            header->~SharedStringHeader();
+            delete[] reinterpret_cast<char *>(header);
         }
-        i++;
+        break;
+    case JSONType::ARRAY:
+        if (d_flags & LAZY_PAYLOAD)
+            delete d_lazy;
+        else
+            delete d_array;
+        break;
+    case JSONType::OBJECT:
+        if (d_flags & LAZY_PAYLOAD)
+            delete d_lazy;
+        else
+            delete d_object;
+        break;
+    default:
+        break;
+    }
+    d_flags &= ~(OWNS_PAYLOAD | LAZY_PAYLOAD | SHARED_STRING);
+}
+
+namespace
+{
+    size_t hashKey(std::string_view key)
+    {
+        return std::hash<std::string_view>{}(key);
     }
-    return true;
 }
 
-bool isInteger(const std::string &s)
+const JSONNode *JSONNode::findMember(std::string_view key) const
 {
-    if (s.empty()) return false;
-    int i = 0;
-    if (s[0] == '+' || s[0] == '-')
-        i++;
+    const Object &object = objectStorage();
+    if (object.slots.empty())
+    {
+        for (const Member &member : object.members)
+        {
+            if (member.key.stringView() == key)
+                return &member.value;
+        }
+        return nullptr;
+    }
 
-    while (i < s.length())
+    size_t mask = object.slots.size() - 1;
+    for (size_t i = hashKey(key) & mask; object.slots[i]; i = (i + 1) & mask)
     {
-        if (!std::isdigit(s[i]))
-            return false;
-        i++;
+        const Member &member = object.members[object.slots[i] - 1];
+        if (member.key.stringView() == key)
+            return &member.value;
     }
-    return true;
+    return nullptr;
 }
 
-JSONNode getValue(const std::string &s)
+JSONNode &JSONNode::member(std::string_view key)
 {
-    int i = 0, j = s.length() - 1;
+    if (const JSONNode *found = findMember(key))
+        return const_cast<JSONNode &>(*found);
 
-    // Trim whitespace
-    while (i <= j && isWhiteSpace(s[i])) i++;
-    while (j >= i && isWhiteSpace(s[j])) j--;
+    return addMember(makeKey(key));
+}
 
-    if (i > j) return JSONNode(); // Empty string becomes null
+JSONNode JSONNode::makeKey(std::string_view key) const
+{
+    JSONNode name;
+    name.d_type = JSONType::STRING;
+    // arena objects keep their keys in the arena too
+    if (d_flags & OWNS_PAYLOAD)
+        name.setString(key);
+    else
+        name.setString(key, objectStorage().members.get_allocator().resource());
+    return name;
+}
 
-    std::string temp = s.substr(i, j - i + 1);
+JSONNode &JSONNode::addMember(JSONNode &&key)
+{
+    Object &object = objectStorage();
+    object.members.emplace_back();
+    Member &added = object.members.back();
+    added.key = std::move(key);
 
-    if (temp.empty()) return JSONNode();
+    size_t count = object.members.size();
+    if (object.slots.empty() && count <= OBJECT_HASH_THRESHOLD)
+        return added.value;
 
-    if (temp[0] == '"') {
-        if (temp.length() < 2 || temp.back() != '"') {
-            return JSONNode(); // Invalid string
-        }
-        return JSONNode(temp.substr(1, temp.length() - 2));
+    // keep the table at most half full, rebuild it when it grows
+    if (object.slots.size() < count * 2)
+    {
+        indexMembers(count);
+        return added.value;
     }
+    size_t mask = object.slots.size() - 1;
+    size_t i = hashKey(added.key.stringView()) & mask;
+    while (object.slots[i])
+        i = (i + 1) & mask;
+    object.slots[i] = static_cast<uint32_t>(count);
+    return added.value;
+}
 
-    if (temp == "true") return JSONNode(true);
-    if (temp == "false") return JSONNode(false);
-    if (temp == "null") return JSONNode();
+void JSONNode::indexMembers(size_t expected)
+{
+    Object &object = objectStorage();
+    size_t capacity = 64;
+    while (capacity < expected * 2)
+        capacity *= 2;
+    object.slots.assign(capacity, 0);
+    for (size_t m = 0; m < object.members.size(); m++)
+    {
+        size_t i = hashKey(object.members[m].key.stringView()) & (capacity - 1);
+        while (object.slots[i])
+            i = (i + 1) & (capacity - 1);
+        object.slots[i] = static_cast<uint32_t>(m + 1);
+    }
+}
 
-    // Numeric handling
-    if (isDouble(temp)) {
-        try {
-            if (isInteger(temp)) {
-                try {
-                    return JSONNode(std::stoi(temp));
-                } catch (...) {
-                    return JSONNode(std::stod(temp));
-                }
-            }
-            return JSONNode(std::stod(temp));
-        } catch (...) {
-            return JSONNode(temp);
-        }
+void JSONNode::reserve(size_t count)
+{
+    if (isArray())
+    {
+        arrayStorage().reserve(count);
+        return;
     }
+    if (!isObject())
+        throw std::runtime_error("reserve() called on non-array/non-object JSONNode");
 
-    return JSONNode(temp);
+    Object &object = objectStorage();
+    object.members.reserve(count);
+    // size the hash index once instead of rebuilding it while filling
+    if (count > OBJECT_HASH_THRESHOLD && object.slots.size() < count * 2)
+        indexMembers(count);
 }
 
-JSONNode JSONNode::parse(const std::string &s)
+std::pair<JSONNode *, bool> JSONNode::tryEmplace(std::string_view key, JSONNode &&value, JSONKeyTable *keys)
 {
-    std::unordered_map<int, int> bracePairs;
-    findBarcePairs(s, bracePairs); // find all braces { and [ from string s
+    limitToObject();
+    if (const JSONNode *found = findMember(key))
+        return {const_cast<JSONNode *>(found), false};
 
-    int i = 0;
+    // shared keys are reference counted, arena objects never release theirs
+    JSONNode name = keys && (d_flags & OWNS_PAYLOAD) ? JSONNode(keys->intern(key)) : makeKey(key);
+    JSONNode &added = addMember(std::move(name));
+    added = std::move(value);
+    return {&added, true};
+}
 
-    while (isWhiteSpace(s[i])) // remove whitespaces
-        i++;
+const JSONNode &JSONKeyTable::intern(std::string_view name)
+{
+    auto found = d_keys.find(name);
+    if (found != d_keys.end())
+        return found->second;
 
-    // start will be current i and end can be find from bracePairs[i]
-    if (s[i] == '[')
-        return parseArray(s, i, bracePairs[i], bracePairs);
+    JSONNode key;
+    key.d_type = JSONType::STRING;
+    key.setSharedString(name);
+    std::string_view chars = key.stringView();
+    return d_keys.emplace(chars, std::move(key)).first->second;
+}
 
-    return parseObject(s, i, bracePairs[i], bracePairs);
+namespace
+{
+    std::runtime_error parseError(size_t offset, const char *message)
+    {
+        return std::runtime_error("JSON parse error at offset " + std::to_string(offset) + ": " + message);
+    }
 }
 
-JSONNode parseObject(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair)
+/**
+ * @class JSONParser
+ * @brief Single pass recursive descent JSON parser
+ *
+ * Walks the input once, building the node tree as it goes. Strings are copied
+ * in runs between escapes, numbers are validated against the JSON grammar and
+ * converted with std::from_chars, so no exceptions are used on the happy path.
+ * Array elements and object members are collected on a stack shared by all
+ * nesting levels, so every container is allocated once at its final size.
+ *
+ * When given an arena the tree is allocated from it and strings without
+ * escapes point straight into the input.
+ *
+ * When given a structural index (see jsonstructural.h) the parser runs as stage
+ * two: whitespace runs are skipped by jumping to the next recorded token and
+ * UTF-8 in strings is not validated again.
+ *
+ * When given a lazy document it parses a single array/object; nested arrays and
+ * objects become lazy nodes and are skipped using the matched brackets.
+ */
+class JSONParser
 {
-    int i = start;
-    JSONNode ans(JSONType::OBJECT);
+    const char *d_begin; ///< Start of the input, for error offsets
+    const char *d_pos;   ///< Current position
+    const char *d_end;   ///< End of the input
+
+    bool d_indexed = false;              ///< Input was validated and indexed by stage one
+    const uint32_t *d_token = nullptr;   ///< Next candidate token in the structural index
+    const uint32_t *d_tokenEnd = nullptr; ///< End of the structural index
+
+    std::shared_ptr<const JSONNode::LazyDocument> d_document; ///< Set in lazy mode
+    std::pmr::memory_resource *d_arena = nullptr;             ///< Set when parsing into an arena
+
+    std::vector<JSONNode> d_elements;        ///< Elements of the arrays being parsed, innermost last
+    std::vector<JSONNode::Member> d_members; ///< Members of the objects being parsed, innermost last
+    std::string d_unescaped;                 ///< Last string that had escapes
 
-    while (i < end)
+    /// Nesting limit, protects the recursion against hostile input
+    static constexpr int MAX_DEPTH = 512;
+
+    [[noreturn]] void fail(const char *message) const
     {
-        // Skip non-quote characters (with bounds check)
-        while (i < end && s[i] != '"')
-            i++;
-        if (i >= end)
-            break; // Exit if no more keys
+        throw parseError(d_pos - d_begin, message);
+    }
 
-        i++; // Move past opening '"'
+    static bool isWhiteSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
 
-        std::string key;
-        // Extract key (with bounds check)
-        while (i < end && s[i] != '"')
+    void skipWhiteSpace()
+    {
+        if (d_pos >= d_end || !isWhiteSpace(*d_pos))
+            return;
+
+        if (d_indexed)
         {
-            key += s[i];
-            i++;
+            // outside strings the first non-whitespace byte always starts a token
+            uint32_t offset = static_cast<uint32_t>(d_pos - d_begin);
+            while (d_token < d_tokenEnd && *d_token < offset)
+                d_token++;
+            d_pos = d_token < d_tokenEnd ? d_begin + *d_token : d_end;
+            return;
         }
-        if (i >= end)
-            throw std::runtime_error("Unterminated key");
-        i++; // Move past closing '"'
 
-        // Find colon
-        while (i < end && s[i] != ':')
-            i++;
-        if (i >= end)
-            throw std::runtime_error("Expected ':' after key");
-        i++; // Skip ':'
+        do
+            d_pos++;
+        while (d_pos < d_end && isWhiteSpace(*d_pos));
+    }
+
+    /// Consumes c after optional whitespace, or fails
+    void expect(char c, const char *message)
+    {
+        skipWhiteSpace();
+        if (d_pos >= d_end || *d_pos != c)
+            fail(message);
+        d_pos++;
+    }
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
 
-        // Skip whitespace after colon
-        while (i < end && isWhiteSpace(s[i]))
-            i++;
-        if (i >= end)
-            throw std::runtime_error("Expected value after ':'");
+    unsigned readHex4()
+    {
+        if (d_end - d_pos < 4)
+            fail("truncated \\u escape");
+        unsigned code = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            int v = hexValue(d_pos[i]);
+            if (v < 0)
+                fail("invalid \\u escape");
+            code = (code << 4) | static_cast<unsigned>(v);
+        }
+        d_pos += 4;
+        return code;
+    }
 
-        // Parse value
-        std::string value;
-        if (s[i] == '{')
+    static void appendUTF8(std::string &out, unsigned code)
+    {
+        if (code < 0x80)
         {
-            ans[key] = parseObject(s, i, bracePair[i], bracePair);
-            i = bracePair[i] + 1;
+            out += static_cast<char>(code);
         }
-        else if (s[i] == '[')
+        else if (code < 0x800)
         {
-            ans[key] = parseArray(s, i, bracePair[i], bracePair);
-            i = bracePair[i] + 1;
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
         }
         else
         {
-            while (i < end && s[i] != ',' && s[i] != '}')
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    /// Advances to the next quote, escape or control character in a string body
+    void skipPlainRun()
+    {
+        while (d_pos < d_end)
+        {
+            unsigned char c = static_cast<unsigned char>(*d_pos);
+            if (c - 0x20u < 0x60u && c != '"' && c != '\\')
+            {
+                d_pos++;
+                continue;
+            }
+            if (c < 0x80)
+                break;
+            if (d_indexed)
             {
-                value += s[i];
-                i++;
+                d_pos++;
+                continue;
             }
-            ans[key] = getValue(value);
+            size_t length = utf8SequenceLength(d_pos, d_end);
+            if (!length)
+                fail("invalid UTF-8 in string");
+            d_pos += length;
         }
+    }
 
-        // Skip comma
-        if (i < end && s[i] == ',')
-            i++;
+    /**
+     * @brief Parses a string body, d_pos is just past the opening quote
+     * @return The string, pointing into the input when it has no escapes,
+     *         otherwise into d_unescaped (valid until the next string)
+     */
+    std::string_view parseString()
+    {
+        const char *start = d_pos;
+        skipPlainRun();
+        if (d_pos < d_end && *d_pos == '"')
+            return std::string_view(start, d_pos++ - start);
+
+        d_unescaped.assign(start, d_pos - start);
+        appendString(d_unescaped);
+        return d_unescaped;
     }
-    return ans;
-}
 
-// Example fix for parseArray to handle nested elements:
-JSONNode parseArray(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair)
-{
-    int i = start + 1; // Skip '['
-    JSONNode ans(JSONType::ARRAY);
+    /// Unescapes the rest of a string body into out, up to and including the closing quote
+    void appendString(std::string &out)
+    {
+        while (true)
+        {
+            // copy the run up to the next quote, escape or control character in one go
+            const char *run = d_pos;
+            skipPlainRun();
+            out.append(run, d_pos - run);
+
+            if (d_pos >= d_end)
+                fail("unterminated string");
+
+            char c = *d_pos++;
+            if (c == '"')
+                return;
+            if (c != '\\')
+            {
+                d_pos--;
+                fail("control character in string");
+            }
+            if (d_pos >= d_end)
+                fail("unterminated escape");
 
-    while (i < end)
+            switch (*d_pos++)
+            {
+            case '"':
+                out += '"';
+                break;
+            case '\\':
+                out += '\\';
+                break;
+            case '/':
+                out += '/';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                unsigned code = readHex4();
+                if (code >= 0xD800 && code <= 0xDBFF)
+                {
+                    // high surrogate, must be followed by an escaped low surrogate
+                    if (d_end - d_pos < 2 || d_pos[0] != '\\' || d_pos[1] != 'u')
+                        fail("unpaired surrogate in \\u escape");
+                    d_pos += 2;
+                    unsigned low = readHex4();
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        fail("invalid low surrogate in \\u escape");
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (code >= 0xDC00 && code <= 0xDFFF)
+                {
+                    fail("unpaired surrogate in \\u escape");
+                }
+                appendUTF8(out, code);
+                break;
+            }
+            default:
+                d_pos--;
+                fail("invalid escape sequence");
+            }
+        }
+    }
+
+    JSONNode parseNumber()
     {
-        // Skip whitespace
-        while (i < end && isWhiteSpace(s[i]))
-            i++;
-        if (i >= end)
-            break;
+        const char *start = d_pos;
 
-        // Handle empty elements (just skip them)
-        if (s[i] == ',') {
-            i++;
-            continue;
+        // validate against the JSON number grammar, from_chars alone is more permissive
+        if (d_pos < d_end && *d_pos == '-')
+            d_pos++;
+        if (d_pos >= d_end || !std::isdigit(static_cast<unsigned char>(*d_pos)))
+            fail("invalid number");
+        if (*d_pos == '0')
+            d_pos++;
+        else
+            while (d_pos < d_end && std::isdigit(static_cast<unsigned char>(*d_pos)))
+                d_pos++;
+
+        // integers are kept exact as int64, unless they overflow it (or are -0)
+        if (d_pos >= d_end || (*d_pos != '.' && *d_pos != 'e' && *d_pos != 'E'))
+        {
+            int64_t integer = 0;
+            auto result = std::from_chars(start, d_pos, integer);
+            if (result.ec == std::errc() && !(integer == 0 && *start == '-'))
+                return JSONNode(integer);
         }
 
-        if (s[i] == '{' || s[i] == '[')
+        if (d_pos < d_end && *d_pos == '.')
         {
-            int closingIndex = bracePair[i];
-            if (s[i] == '{')
-            {
-                ans.appendArray(parseObject(s, i, closingIndex, bracePair));
-            }
+            d_pos++;
+            if (d_pos >= d_end || !std::isdigit(static_cast<unsigned char>(*d_pos)))
+                fail("invalid number fraction");
+            while (d_pos < d_end && std::isdigit(static_cast<unsigned char>(*d_pos)))
+                d_pos++;
+        }
+        if (d_pos < d_end && (*d_pos == 'e' || *d_pos == 'E'))
+        {
+            d_pos++;
+            if (d_pos < d_end && (*d_pos == '+' || *d_pos == '-'))
+                d_pos++;
+            if (d_pos >= d_end || !std::isdigit(static_cast<unsigned char>(*d_pos)))
+                fail("invalid number exponent");
+            while (d_pos < d_end && std::isdigit(static_cast<unsigned char>(*d_pos)))
+                d_pos++;
+        }
+
+        double value = 0;
+        auto result = std::from_chars(start, d_pos, value);
+        if (result.ec == std::errc::result_out_of_range)
+        {
+            // overflow / underflow: fall back to strtod for +-HUGE_VAL / 0
+            value = std::strtod(std::string(start, d_pos).c_str(), nullptr);
+        }
+        return JSONNode(value);
+    }
+
+    void parseLiteral(const char *literal, size_t length)
+    {
+        if (static_cast<size_t>(d_end - d_pos) < length || std::memcmp(d_pos, literal, length) != 0)
+            fail("invalid literal");
+        d_pos += length;
+    }
+
+    /// String node, borrowed from the input or copied into the arena when parsing into one
+    JSONNode makeString(std::string_view value)
+    {
+        JSONNode node;
+        node.d_type = JSONType::STRING;
+        if (!d_arena)
+        {
+            node.setString(value);
+        }
+        else if (value.data() != d_unescaped.data())
+        {
+            if (value.size() > std::numeric_limits<uint32_t>::max())
+                throw std::runtime_error("JSON string is too long");
+            node.d_chars = value.data();
+            node.d_length = static_cast<uint32_t>(value.size());
+        }
+        else
+        {
+            node.setString(value, d_arena);
+        }
+        return node;
+    }
+
+    /// Empty array/object, in the arena when parsing into one
+    JSONNode makeContainer(JSONType type)
+    {
+        if (!d_arena)
+            return JSONNode(type);
+
+        JSONNode node;
+        node.d_type = type;
+        if (type == JSONType::ARRAY)
+            node.d_array = new (d_arena->allocate(sizeof(JSONNode::Array), alignof(JSONNode::Array))) JSONNode::Array(d_arena);
+        else
+            node.d_object = new (d_arena->allocate(sizeof(JSONNode::Object), alignof(JSONNode::Object))) JSONNode::Object(d_arena);
+        return node;
+    }
+
+    /// Builds the object from the members stacked above base
+    JSONNode finishObject(size_t base)
+    {
+        JSONNode node = makeContainer(JSONType::OBJECT);
+        node.d_object->members.reserve(d_members.size() - base);
+        for (size_t i = base; i < d_members.size(); i++)
+        {
+            JSONNode::Member &added = d_members[i];
+            // a repeated key keeps its first position and its last value
+            if (const JSONNode *found = node.findMember(added.key.stringView()))
+                const_cast<JSONNode &>(*found) = std::move(added.value);
             else
+                node.addMember(std::move(added.key)) = std::move(added.value);
+        }
+        d_members.resize(base);
+        return node;
+    }
+
+    /// Builds the array from the elements stacked above base
+    JSONNode finishArray(size_t base)
+    {
+        JSONNode node = makeContainer(JSONType::ARRAY);
+        node.d_array->assign(std::make_move_iterator(d_elements.begin() + base),
+                             std::make_move_iterator(d_elements.end()));
+        d_elements.resize(base);
+        return node;
+    }
+
+    JSONNode parseObject(int depth)
+    {
+        size_t base = d_members.size();
+        skipWhiteSpace();
+        if (d_pos < d_end && *d_pos == '}')
+        {
+            d_pos++;
+            return finishObject(base);
+        }
+
+        while (true)
+        {
+            expect('"', "expected object key");
+            JSONNode key = makeString(parseString());
+            expect(':', "expected ':' after object key");
+            JSONNode value = parseValue(depth);
+            d_members.push_back(JSONNode::Member{std::move(key), std::move(value)});
+
+            skipWhiteSpace();
+            if (d_pos >= d_end)
+                fail("unterminated object");
+            char c = *d_pos++;
+            if (c == '}')
+                return finishObject(base);
+            if (c != ',')
             {
-                ans.appendArray(parseArray(s, i, closingIndex, bracePair));
+                d_pos--;
+                fail("expected ',' or '}' in object");
             }
-            i = closingIndex + 1;
         }
-        else
+    }
+
+    JSONNode parseArray(int depth)
+    {
+        size_t base = d_elements.size();
+        skipWhiteSpace();
+        if (d_pos < d_end && *d_pos == ']')
         {
-            int valueStart = i;
-            while (i < end && s[i] != ',')
-                i++;
-            std::string valueStr = s.substr(valueStart, i - valueStart);
-            JSONNode value = getValue(valueStr);
-            if (!value.isNULL()) {  // Only append non-null values
-                ans.appendArray(value);
+            d_pos++;
+            return finishArray(base);
+        }
+
+        while (true)
+        {
+            d_elements.push_back(parseValue(depth));
+
+            skipWhiteSpace();
+            if (d_pos >= d_end)
+                fail("unterminated array");
+            char c = *d_pos++;
+            if (c == ']')
+                return finishArray(base);
+            if (c != ',')
+            {
+                d_pos--;
+                fail("expected ',' or ']' in array");
             }
-            i++; // Skip ','
         }
+    }
+
+    /// Lazy node for the array/object at d_pos, continues after its closing bracket
+    JSONNode lazyContainer()
+    {
+        // the cursor only lags behind when no whitespace preceded the bracket
+        uint32_t offset = static_cast<uint32_t>(d_pos - d_begin);
+        while (d_token < d_tokenEnd && *d_token < offset)
+            d_token++;
+        uint32_t token = static_cast<uint32_t>(d_token - d_document->index.data());
+        uint32_t close = d_document->match[token];
 
-        // Skip whitespace after value
-        while (i < end && isWhiteSpace(s[i]))
-            i++;
+        JSONNode node;
+        node.d_type = *d_pos == '{' ? JSONType::OBJECT : JSONType::ARRAY;
+        node.d_lazy = new JSONNode::Lazy{d_document, token};
+        node.d_flags = JSONNode::OWNS_PAYLOAD | JSONNode::LAZY_PAYLOAD;
+
+        d_token = d_document->index.data() + close + 1;
+        d_pos = d_begin + d_document->index[close] + 1;
+        return node;
     }
-    return ans;
-}
 
-std::string JSONNode::stringify(const JSONNode &node)
-{
-    switch (node.d_type)
+    JSONNode parseValue(int depth)
     {
-    case JSONType::BOOL:
-        return node.d_value.d_bool ? "true" : "false";
+        skipWhiteSpace();
+        if (d_pos >= d_end)
+            fail("unexpected end of input");
 
-    case JSONType::NULLT:
-        return "null";
+        if (d_document && (*d_pos == '{' || *d_pos == '['))
+            return lazyContainer();
 
-    case JSONType::NUMBER:
-        return std::to_string(node.d_value.d_number);
+        switch (*d_pos)
+        {
+        case '{':
+            if (depth >= MAX_DEPTH)
+                fail("maximum nesting depth exceeded");
+            d_pos++;
+            return parseObject(depth + 1);
+        case '[':
+            if (depth >= MAX_DEPTH)
+                fail("maximum nesting depth exceeded");
+            d_pos++;
+            return parseArray(depth + 1);
+        case '"':
+            d_pos++;
+            return makeString(parseString());
+        case 't':
+            parseLiteral("true", 4);
+            return JSONNode(true);
+        case 'f':
+            parseLiteral("false", 5);
+            return JSONNode(false);
+        case 'n':
+            parseLiteral("null", 4);
+            return JSONNode();
+        default:
+            return parseNumber();
+        }
+    }
 
-    case JSONType::STRING:
+public:
+    explicit JSONParser(std::string_view s) : d_begin(s.data()), d_pos(s.data()), d_end(s.data() + s.size()) {}
+
+    /// Stage two constructor, index must come from buildStructuralIndex(s)
+    JSONParser(std::string_view s, const std::vector<uint32_t> &index)
+        : JSONParser(s)
     {
-        std::string ans = "\"";
-        ans += node.d_value.d_string;
-        ans += '"';
-        return ans;
+        d_indexed = true;
+        d_token = index.data();
+        d_tokenEnd = index.data() + index.size();
     }
 
-    case JSONType::ARRAY:
+    /// Lazy mode constructor
+    explicit JSONParser(const std::shared_ptr<const JSONNode::LazyDocument> &document)
+        : JSONParser(document->text, document->index)
+    {
+        d_document = document;
+    }
+
+    /**
+     * @brief Parses a whole document, picking single pass or two stage by mode
+     * @param arena Where the tree is allocated, nullptr for ordinary heap nodes
+     */
+    static JSONNode parse(std::string_view s, JSONParseMode mode, std::pmr::memory_resource *arena)
     {
-        std::string ans = "[";
-        for (auto v : node.d_array)
+        // AUTO is single pass, and index offsets are 32 bit
+        if (mode != JSONParseMode::TWO_STAGE || s.size() > std::numeric_limits<uint32_t>::max())
         {
-            ans += stringify(v); // recusively stringify again
-            ans += ',';
+            JSONParser parser(s);
+            parser.d_arena = arena;
+            return parser.parseDocument();
         }
-        ans[ans.length() - 1] = ']'; // add last charactor as ]
-        return ans;
+
+        std::vector<uint32_t> index;
+        buildStructuralIndex(s.data(), s.size(), index);
+        JSONParser parser(s, index);
+        parser.d_arena = arena;
+        return parser.parseDocument();
     }
 
-    case JSONType::OBJECT:
+    /// Lazy mode: parses the array/object starting at the given token, one level deep
+    JSONNode parseContainer(uint32_t token)
     {
-        std::string ans = "{";
-        for (auto &k : node.d_data)
+        d_token = d_document->index.data() + token;
+        d_pos = d_begin + *d_token;
+        d_token++;
+        return *d_pos++ == '{' ? parseObject(1) : parseArray(1);
+    }
+
+    /// Parses exactly one JSON value, only whitespace may follow it
+    JSONNode parseDocument()
+    {
+        JSONNode root = parseValue(0);
+        skipWhiteSpace();
+        if (d_pos != d_end)
+            fail("unexpected data after JSON value");
+        return root;
+    }
+};
+
+JSONNode JSONNode::parse(const std::string &s, JSONParseMode mode)
+{
+    return JSONParser::parse(s, mode, nullptr);
+}
+
+JSONNode JSONNode::parse(std::string_view input, std::pmr::memory_resource *arena, JSONParseMode mode)
+{
+    return JSONParser::parse(input, mode, arena);
+}
+
+JSONNode JSONNode::parseLazy(std::string s)
+{
+    if (s.size() > std::numeric_limits<uint32_t>::max())
+        return JSONParser(s).parseDocument();
+
+    auto document = std::make_shared<LazyDocument>();
+    document->text = std::move(s);
+    const std::string &text = document->text;
+    std::vector<uint32_t> &index = document->index;
+    buildStructuralIndex(text.data(), text.size(), index);
+
+    // match brackets once, lazy nodes use it to skip over their children
+    document->match.assign(index.size(), 0);
+    std::vector<uint32_t> open;
+    for (uint32_t token = 0; token < index.size(); token++)
+    {
+        char c = text[index[token]];
+        if (c == '{' || c == '[')
         {
-            ans += '"';
-            ans += k.first;
-            ans += '"';
-            ans += ':';
-            ans += stringify(k.second); // recursively stringify again
-            ans += ',';
+            open.push_back(token);
+            continue;
         }
-        ans[ans.length() - 1] = '}'; // add last charactor as }
-        return ans;
+        if (c != '}' && c != ']')
+            continue;
+        if (open.empty() || text[index[open.back()]] != (c == '}' ? '{' : '['))
+            throw parseError(index[token], "unbalanced brackets");
+        document->match[open.back()] = token;
+        open.pop_back();
     }
+    if (!open.empty())
+        throw parseError(index[open.back()], "unterminated array or object");
+
+    // scalar documents are parsed right away
+    if (index.empty() || (text[index[0]] != '{' && text[index[0]] != '['))
+        return JSONParser(text, index).parseDocument();
+    if (document->match[0] != index.size() - 1)
+        throw parseError(index[document->match[0] + 1], "unexpected data after JSON value");
+
+    JSONNode root;
+    root.d_type = text[index[0]] == '{' ? JSONType::OBJECT : JSONType::ARRAY;
+    root.d_lazy = new Lazy{std::move(document), 0};
+    root.d_flags = OWNS_PAYLOAD | LAZY_PAYLOAD;
+    return root;
+}
+
+#ifdef JSON_HAVE_MMAP
+namespace
+{
+    /// Read-only mapping of a whole file, unmapped on destruction
+    class MappedFile
+    {
+        void *d_data = nullptr;
+        size_t d_size = 0;
+
+    public:
+        explicit MappedFile(const std::string &path)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("cannot open JSON file " + path + ": " + std::strerror(errno));
+
+            struct stat info;
+            if (::fstat(fd, &info) != 0)
+            {
+                int error = errno;
+                ::close(fd);
+                throw std::runtime_error("cannot stat JSON file " + path + ": " + std::strerror(error));
+            }
+            d_size = static_cast<size_t>(info.st_size);
+
+            // empty files can't be mapped, they parse as empty input
+            if (d_size > 0)
+            {
+                d_data = ::mmap(nullptr, d_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (d_data == MAP_FAILED)
+                {
+                    int error = errno;
+                    ::close(fd);
+                    throw std::runtime_error("cannot map JSON file " + path + ": " + std::strerror(error));
+                }
+                ::madvise(d_data, d_size, MADV_SEQUENTIAL);
+            }
+            ::close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (d_data)
+                ::munmap(d_data, d_size);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        std::string_view text() const
+        {
+            return d_data ? std::string_view(static_cast<const char *>(d_data), d_size) : std::string_view();
+        }
+    };
+}
+
+JSONNode JSONNode::parseFile(const std::string &path, JSONParseMode mode)
+{
+    MappedFile file(path);
+    return JSONParser::parse(file.text(), mode, nullptr);
+}
+#else
+JSONNode JSONNode::parseFile(const std::string &path, JSONParseMode mode)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("cannot open JSON file " + path);
+    std::ostringstream text;
+    text << file.rdbuf();
+    return JSONParser::parse(text.str(), mode, nullptr);
+}
+#endif
+
+const JSONNode &JSONNode::lazyPayload() const
+{
+    Lazy &lazy = *d_lazy;
+    if (!lazy.parsed.load(std::memory_order_acquire))
+    {
+        // a throwing parse leaves the flag unset, the next access throws again
+        std::lock_guard<std::mutex> lock(lazy.parsing);
+        if (!lazy.parsed.load(std::memory_order_relaxed))
+        {
+            lazy.node = JSONParser(lazy.document).parseContainer(lazy.token);
+            lazy.parsed.store(true, std::memory_order_release);
+        }
     }
-}
\ No newline at end of file
+    return lazy.node;
+}
+
+std::string JSONNode::stringify(const JSONNode &node)
+{
+    std::string out;
+    JSONWriter(out).write(node);
+    return out;
+}
+
+std::ostream &operator<<(std::ostream &stream, const JSONNode &json)
+{
+    JSONWriter(stream, 4).write(json);
+    return stream;
+}
@@ -1,12 +1,17 @@
 #ifndef _JSON_PARSER_H_
 #define _JSON_PARSER_H_
 
+#include <cstddef> // For nullptr_t
+#include <cstdint>
 #include <iostream>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
-#include <string>
-#include <new>     // For placement new
-#include <cstddef> // For nullptr_t
 
 /**
  * @enum JSONType
@@ -16,14 +21,27 @@
  */
 enum class JSONType : short
 {
-    NUMBER, ///< JSON number (e.g., 123, 4.56)
+    NUMBER, ///< JSON number (e.g., 123, 4.56), stored as int64 or double
     STRING, ///< JSON string (e.g., "hello")
     BOOL,   ///< JSON boolean (true/false)
     NULLT,  ///< JSON null value
-    OBJECT, ///< JSON object (unordered key-value pairs)
+    OBJECT, ///< JSON object (key-value pairs, kept in insertion order)
     ARRAY   ///< JSON array (ordered list of values)
 };
 
+/**
+ * @enum JSONParseMode
+ * @brief Parser selection for JSONNode::parse
+ */
+enum class JSONParseMode : short
+{
+    AUTO,        ///< The faster parser, single pass: two stage is still slower end to end on every bench-json corpus
+    SINGLE_PASS, ///< Recursive descent directly over the text
+    TWO_STAGE    ///< SIMD structural index first, then the tree is built from it
+};
+
+class JSONKeyTable;
+
 /**
  * @class JSONNode
  * @brief Represents a node in a JSON document tree
@@ -32,45 +50,78 @@ enum class JSONType : short
  * - Type-safe value storage
  * - Recursive object/array structures
  * - Value conversion operators
- * - Memory-efficient union storage
+ * - Compact 16 byte tagged storage
+ *
+ * Numbers without fraction or exponent are kept as exact int64 values (see
+ * isInteger()), other numbers as doubles.
+ *
+ * Scalars live inline in the node. Strings, arrays and objects keep a single
+ * pointer to heap storage. Objects are a flat vector of members in insertion
+ * order, searched linearly while small; a hash index is only built once an
+ * object has more than OBJECT_HASH_THRESHOLD members.
+ *
+ * Trees parsed into an arena (see parse(std::string_view, std::pmr::memory_resource *))
+ * own nothing: containers live in the arena and strings either point into the
+ * input or were unescaped into the arena, so destroying them is free. Copying
+ * a node out of such a tree gives an ordinary heap tree.
  */
 class JSONNode
 {
-    JSONType d_type; ///< Type of this JSON node
-
-    /// Object storage (only used when d_type == OBJECT)
-    std::unordered_map<std::string, JSONNode> d_data;
-
-    /// Array storage (only used when d_type == ARRAY)
-    std::vector<JSONNode> d_array;
+    struct Member;
+    struct Object;
+    struct LazyDocument;
+    struct Lazy;
+    using Array = std::pmr::vector<JSONNode>;
+
+    /// Payload, the active member is determined by d_type
+    union
+    {
+        double d_number;     ///< JSONType::NUMBER
+        int64_t d_integer;   ///< JSONType::NUMBER with INTEGER_NUMBER set
+        bool d_bool;         ///< JSONType::BOOL
+        const char *d_chars; ///< JSONType::STRING, not NUL terminated when borrowed from the input
+        Array *d_array;      ///< JSONType::ARRAY
+        Object *d_object;    ///< JSONType::OBJECT
+        Lazy *d_lazy;        ///< JSONType::OBJECT / ARRAY with LAZY_PAYLOAD set
+    };
+    uint32_t d_length = 0; ///< String length in bytes (JSONType::STRING)
+    JSONType d_type;       ///< Type of this JSON node
+    uint16_t d_flags = 0;  ///< OWNS_PAYLOAD / INTEGER_NUMBER / LAZY_PAYLOAD / SHARED_STRING bits
+
+    /// The string/array/object storage was allocated by this node and is freed with it,
+    /// unset for arena and borrowed storage
+    static constexpr uint16_t OWNS_PAYLOAD = 1;
+
+    /// The number is held in d_integer
+    static constexpr uint16_t INTEGER_NUMBER = 2;
+
+    /// Array/object not parsed yet, d_lazy points at its text (see parseLazy)
+    static constexpr uint16_t LAZY_PAYLOAD = 4;
+
+    /// d_chars is reference counted and shared by copies (interned keys, see JSONKeyTable)
+    static constexpr uint16_t SHARED_STRING = 8;
+
+    friend class JSONKeyTable;
+    friend class JSONParser;
+    friend class JSONPointer;
+    friend class JSONWriter;
+    friend class JSONPushParser;
 
     /**
-     * @union value
-     * @brief Union for storing primitive JSON values
+     * The parsed form of a lazy array/object, built one level deep on first use
+     * (nested containers stay lazy). The node itself never changes representation,
+     * so concurrent const access to a lazy tree is safe: the first reader parses
+     * under the payload's mutex and the others wait for it.
      *
-     * Only one member is active at a time, determined by d_type
+     * @throws std::runtime_error on syntax errors in the subtree, retried on the next access
      */
-    union value
-    {
-        std::string d_string; ///< String value (JSONType::STRING)
-        double d_number;      ///< Numeric value (JSONType::NUMBER)
-        bool d_bool;          ///< Boolean value (JSONType::BOOL)
-
-        value() {}  ///< Default constructor
-        ~value() {} ///< Destructor
+    const JSONNode &lazyPayload() const;
 
-        /// Conversion to std::string
-        operator std::string() { return d_string; }
+    /// Array storage, for lazy nodes the parsed one. No type check
+    Array &arrayStorage() const { return *((d_flags & LAZY_PAYLOAD) ? lazyPayload().d_array : d_array); }
 
-        /// Conversion to double
-        operator double() { return d_number; }
-
-        /// Conversion to int (truncates decimal)
-        operator int() { return d_number; }
-
-        /// Conversion to bool
-        operator bool() { return d_bool; }
-    } d_value;
+    /// Object storage, for lazy nodes the parsed one. No type check
+    Object &objectStorage() const { return *((d_flags & LAZY_PAYLOAD) ? lazyPayload().d_object : d_object); }
 
     /// @throws std::runtime_error if node is not an array
     void limitToArray() const
@@ -85,50 +136,83 @@ class JSONNode
             throw std::runtime_error("This operation is only available to object node");
     }
 
+    void setString(std::string_view value);
+    /// Copies value into arena, the node doesn't own it
+    void setString(std::string_view value, std::pmr::memory_resource *arena);
+    /// Copies value into a reference counted buffer, copies of the node share it
+    void setSharedString(std::string_view value);
+    void copyFrom(const JSONNode &other);
+    void takeFrom(JSONNode &other) noexcept;
+    void release() noexcept;
+
+    /// Member lookup, nullptr if the key is missing
+    const JSONNode *findMember(std::string_view key) const;
+
+    /// Member lookup, appends a null member if the key is missing
+    JSONNode &member(std::string_view key);
+
+    /// Appends a null member without looking for an existing one
+    JSONNode &addMember(JSONNode &&key);
+
+    /// Key node for a new member, in the arena for arena objects
+    JSONNode makeKey(std::string_view key) const;
+
+    /// Rebuilds the member hash index with room for expected members
+    void indexMembers(size_t expected);
+
+    /// Read-only view of a string node, no type check
+    std::string_view stringView() const { return std::string_view(d_chars, d_length); }
+
 public:
+    /// Objects with more members than this get a hash index
+    static constexpr size_t OBJECT_HASH_THRESHOLD = 16;
+
     // Constructors
     /**
      * @brief Construct with specific JSON type
-     * @param type The JSON type to create
+     * @param type The JSON type to create (empty string/array/object, 0, false or null)
      */
-    explicit JSONNode(JSONType type) : d_type(type) {};
+    explicit JSONNode(JSONType type);
 
     ~JSONNode()
     {
-        if (d_type == JSONType::STRING)
-        {
-            d_value.d_string.~basic_string();
-        }
+        if (d_flags & OWNS_PAYLOAD)
+            release();
     }
 
     /// Default constructor creates null node
-    JSONNode() : d_type(JSONType::NULLT) {};
+    JSONNode() : d_number(0), d_type(JSONType::NULLT) {};
 
     /// Construct null node (explicit nullptr overload)
-    JSONNode(std::nullptr_t value) : JSONNode() {};
+    JSONNode(std::nullptr_t) : JSONNode() {};
 
     /**
      * @brief Construct number node from double
      * @param value Numeric value
      */
-    explicit JSONNode(double value) : d_type(JSONType::NUMBER)
-    {
-        d_value.d_number = value;
-    }
+    explicit JSONNode(double value) : d_number(value), d_type(JSONType::NUMBER) {}
 
     /**
      * @brief Construct array node
      * @param nodes Initial array elements
      */
-    explicit JSONNode(const std::vector<JSONNode> &nodes) : d_type(JSONType::ARRAY), d_array(nodes) {}
+    explicit JSONNode(const std::vector<JSONNode> &nodes);
 
     /**
-     * @brief Construct number node from int
-     * @param value Integer value
+     * @brief Construct number node from any integer type
+     * @param value Integer value, kept exactly (unsigned values above INT64_MAX become doubles)
      */
-    explicit JSONNode(int value) : d_type(JSONType::NUMBER)
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    explicit JSONNode(T value) : d_integer(static_cast<int64_t>(value)), d_type(JSONType::NUMBER), d_flags(INTEGER_NUMBER)
     {
-        d_value.d_number = value;
+        if constexpr (std::is_unsigned_v<T>)
+        {
+            if (static_cast<uint64_t>(value) > static_cast<uint64_t>(INT64_MAX))
+            {
+                d_number = static_cast<double>(value);
+                d_flags = 0;
+            }
+        }
     }
 
     /**
@@ -137,7 +221,7 @@ public:
      */
     explicit JSONNode(const std::string &value) : d_type(JSONType::STRING)
     {
-        new (&d_value.d_string) std::string(value);
+        setString(value);
     }
 
     /**
@@ -146,85 +230,32 @@ public:
      */
     explicit JSONNode(const char *value) : d_type(JSONType::STRING)
     {
-        new (&d_value.d_string) std::string(value);
+        setString(value);
     }
 
     /**
      * @brief Construct bool value
      * @param value bool value
      */
-    explicit JSONNode(bool value) : d_type(JSONType::BOOL)
-    {
-        d_value.d_bool = value;
-    }
+    explicit JSONNode(bool value) : d_bool(value), d_type(JSONType::BOOL) {}
 
     /**
      * @brief Gets the size of the array or object
      * @return Size of the array/object
      * @throws std::runtime_error if node is not an array or object
      */
-    size_t size() const
-    {
-        if (isArray())
-        {
-            return d_array.size();
-        }
-        else if (isObject())
-        {
-            return d_data.size();
-        }
-        throw std::runtime_error("size() called on non-array/non-object JSONNode");
-    }
+    size_t size() const;
 
     // Copy constructor
-    JSONNode(const JSONNode &other) : d_type(other.d_type)
+    JSONNode(const JSONNode &other) : d_number(0), d_type(JSONType::NULLT)
     {
-        switch (d_type)
-        {
-        case JSONType::STRING:
-            new (&d_value.d_string) std::string(other.d_value.d_string);
-            break;
-        case JSONType::NUMBER:
-            d_value.d_number = other.d_value.d_number;
-            break;
-        case JSONType::BOOL:
-            d_value.d_bool = other.d_value.d_bool;
-            break;
-        case JSONType::OBJECT:
-            d_data = other.d_data;
-            break;
-        case JSONType::ARRAY:
-            d_array = other.d_array;
-            break;
-        case JSONType::NULLT:
-            break;
-        }
+        copyFrom(other);
     }
 
     // Move constructor
-    JSONNode(JSONNode &&other) noexcept : d_type(other.d_type)
+    JSONNode(JSONNode &&other) noexcept : d_number(0), d_type(JSONType::NULLT)
     {
-        switch (d_type)
-        {
-        case JSONType::STRING:
-            new (&d_value.d_string) std::string(std::move(other.d_value.d_string));
-            break;
-        case JSONType::NUMBER:
-            d_value.d_number = other.d_value.d_number;
-            break;
-        case JSONType::BOOL:
-            d_value.d_bool = other.d_value.d_bool;
-            break;
-        case JSONType::OBJECT:
-            d_data = std::move(other.d_data);
-            break;
-        case JSONType::ARRAY:
-            d_array = std::move(other.d_array);
-            break;
-        case JSONType::NULLT:
-            break;
-        }
-        other.d_type = JSONType::NULLT;
+        takeFrom(other);
     }
 
     // Copy assignment operator
@@ -232,33 +263,9 @@ public:
     {
         if (this != &node)
         {
-            // Destroy existing string if present
-            if (d_type == JSONType::STRING)
-            {
-                d_value.d_string.~basic_string();
-            }
-
-            d_type = node.d_type;
-            d_data = node.d_data;
-            d_array = node.d_array;
-
-            switch (d_type)
-            {
-            case JSONType::STRING:
-                new (&d_value.d_string) std::string(node.d_value.d_string);
-                break;
-            case JSONType::NUMBER:
-                d_value.d_number = node.d_value.d_number;
-                break;
-            case JSONType::BOOL:
-                d_value.d_bool = node.d_value.d_bool;
-                break;
-            case JSONType::NULLT:
-            case JSONType::OBJECT:
-            case JSONType::ARRAY:
-                // No action needed
-                break;
-            }
+            // copy first, node may live inside this tree
+            JSONNode copy(node);
+            *this = std::move(copy);
         }
         return *this;
     }
@@ -268,35 +275,12 @@ public:
     {
         if (this != &node)
         {
-            // Destroy existing string if present
-            if (d_type == JSONType::STRING)
-            {
-                d_value.d_string.~basic_string();
-            }
-
-            d_type = node.d_type;
-            d_data = std::move(node.d_data);
-            d_array = std::move(node.d_array);
-
-            switch (d_type)
-            {
-            case JSONType::STRING:
-                new (&d_value.d_string) std::string(std::move(node.d_value.d_string));
-                node.d_value.d_string.~basic_string();
-                break;
-            case JSONType::NUMBER:
-                d_value.d_number = node.d_value.d_number;
-                break;
-            case JSONType::BOOL:
-                d_value.d_bool = node.d_value.d_bool;
-                break;
-            case JSONType::NULLT:
-            case JSONType::OBJECT:
-            case JSONType::ARRAY:
-                // No action needed
-                break;
-            }
-            node.d_type = JSONType::NULLT;
+            // detach first, node may live inside this tree
+            JSONNode moved;
+            moved.takeFrom(node);
+            if (d_flags & OWNS_PAYLOAD)
+                release();
+            takeFrom(moved);
         }
         return *this;
     }
@@ -336,7 +320,59 @@ public:
     void appendArray(const JSONNode &node)
     {
         limitToArray();
-        d_array.push_back(node);
+        arrayStorage().push_back(node);
+    }
+
+    /**
+     * @brief Appends a node to JSON array without copying it
+     * @param node Node to move in, left null
+     * @throws std::runtime_error if node is not an array
+     */
+    void appendArray(JSONNode &&node)
+    {
+        limitToArray();
+        arrayStorage().push_back(std::move(node));
+    }
+
+    /**
+     * @brief Constructs a node in place at the end of a JSON array
+     * @param args JSONNode constructor arguments, e.g. JSONType::OBJECT
+     * @return Reference to the new element, valid until the array grows
+     * @throws std::runtime_error if node is not an array
+     *
+     * @example
+     * JSON &row = rows.emplaceArray(JSONType::OBJECT);
+     */
+    template <typename... Args>
+    JSONNode &emplaceArray(Args &&...args)
+    {
+        limitToArray();
+        return arrayStorage().emplace_back(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Reserves room for count array elements or object members
+     * @throws std::runtime_error if node is not an array or object
+     */
+    void reserve(size_t count);
+
+    /**
+     * @brief Adds an object member unless the key already exists
+     * @param key Object member name
+     * @param value Moved in only if the member is added
+     * @param keys Optional table to take the key from, so sibling objects share it
+     * @return The member for key, and whether it was added
+     * @throws std::runtime_error if node isn't an object
+     */
+    std::pair<JSONNode *, bool> tryEmplace(std::string_view key, JSONNode &&value, JSONKeyTable *keys = nullptr);
+
+    /**
+     * @brief Checks if node is a number held as an exact int64
+     * @return true for integer numbers (e.g. parsed from "42"), false otherwise
+     */
+    bool isInteger() const
+    {
+        return d_type == JSONType::NUMBER && (d_flags & INTEGER_NUMBER);
     }
 
     /**
@@ -359,7 +395,7 @@ public:
 
     /**
      * @brief Template value extractor
-     * @tparam T Target type (int, double, bool, std::string)
+     * @tparam T Target type (any integer or floating point type, bool, std::string)
      * @return Extracted value
      * @throws std::runtime_error if node isn't a primitive value type
      *
@@ -378,20 +414,20 @@ public:
         case JSONType::STRING:
             if constexpr (std::is_same_v<T, std::string>)
             {
-                return d_value.d_string;
+                return std::string(d_chars, d_length);
             }
             else
             {
                 throw std::runtime_error("type mismatch: requested type is not std::string");
             }
         case JSONType::NUMBER:
-            if constexpr (std::is_same_v<T, double>)
+            if constexpr (std::is_floating_point_v<T>)
             {
-                return d_value.d_number;
+                return isInteger() ? static_cast<T>(d_integer) : static_cast<T>(d_number);
             }
-            else if constexpr (std::is_same_v<T, int>)
+            else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
             {
-                return static_cast<int>(d_value.d_number);
+                return isInteger() ? static_cast<T>(d_integer) : static_cast<T>(d_number);
             }
             else
             {
@@ -400,7 +436,7 @@ public:
         case JSONType::BOOL:
             if constexpr (std::is_same_v<T, bool>)
             {
-                return d_value.d_bool;
+                return d_bool;
             }
             else
             {
@@ -423,13 +459,13 @@ public:
     JSONNode &operator[](int index)
     {
         limitToArray();
-        return d_array[index];
+        return arrayStorage()[index];
     }
 
     const JSONNode &operator[](int index) const
     {
         limitToArray();
-        return d_array[index];
+        return arrayStorage()[index];
     }
 
     /**
@@ -438,12 +474,13 @@ public:
      * @return Reference to JSONNode for key
      * @throws std::runtime_error if node isn't an object
      *
-     * @note Creates the key if it doesn't exist
+     * @note Creates the key if it doesn't exist. Adding members may move the
+     *       others, so don't hold on to the reference across insertions.
      */
     JSONNode &operator[](const std::string &key)
     {
         limitToObject();
-        return d_data[key];
+        return member(key);
     }
 
     /**
@@ -457,25 +494,47 @@ public:
     JSONNode &operator[](const char *key)
     {
         limitToObject();
-        return d_data[key];
+        return member(key);
     }
 
     /**
      * @brief Object member accessor (string key) - const
+     * @throws std::out_of_range if the key doesn't exist
      */
     const JSONNode &operator[](const std::string &key) const
     {
         limitToObject();
-        return d_data.at(key);
+        const JSONNode *node = findMember(key);
+        if (!node)
+            throw std::out_of_range("JSON object has no member " + key);
+        return *node;
     }
 
     /**
      * @brief Object member accessor (C-string key) - const
+     * @throws std::out_of_range if the key doesn't exist
      */
     const JSONNode &operator[](const char *key) const
     {
         limitToObject();
-        return d_data.at(key);
+        const JSONNode *node = findMember(key);
+        if (!node)
+            throw std::out_of_range(std::string("JSON object has no member ") + key);
+        return *node;
+    }
+
+    /**
+     * @brief Checks if an object node has a member
+     * @param key Object member name
+     * @return true if the key exists
+     * @throws std::runtime_error if node isn't an object
+     *
+     * @note Unlike operator[], never creates the key
+     */
+    bool contains(const std::string &key) const
+    {
+        limitToObject();
+        return findMember(key) != nullptr;
     }
 
     /* Value conversion operators */
@@ -483,119 +542,180 @@ public:
     {
         if (d_type != JSONType::STRING)
             throw std::runtime_error("node is not a string");
-        return d_value.d_string;
+        return std::string(d_chars, d_length);
     }
 
     explicit operator int() const
     {
         if (d_type != JSONType::NUMBER)
             throw std::runtime_error("node is not a number");
-        return static_cast<int>(d_value.d_number);
+        return get<int>();
+    }
+
+    explicit operator int64_t() const
+    {
+        if (d_type != JSONType::NUMBER)
+            throw std::runtime_error("node is not a number");
+        return get<int64_t>();
     }
 
     explicit operator bool() const
     {
         if (d_type != JSONType::BOOL)
             throw std::runtime_error("node is not a boolean");
-        return d_value.d_bool;
+        return d_bool;
     }
 
     explicit operator double() const
     {
         if (d_type != JSONType::NUMBER)
             throw std::runtime_error("node is not a number");
-        return d_value.d_number;
+        return get<double>();
     }
 
     /**
      * @brief Parses JSON string into node tree
+     *
+     * Recursive descent over the input: strings are unescaped (including \uXXXX
+     * surrogate pairs) and UTF-8 validated, numbers are read with std::from_chars.
+     * Large inputs are parsed in two stages, see jsonstructural.h. Both modes
+     * accept and reject exactly the same documents.
+     *
      * @param s JSON-formatted string
+     * @param mode Parser selection, see JSONParseMode
+     * @return Root JSONNode
+     * @throws std::runtime_error on parse errors, with the byte offset of the error
+     */
+    static JSONNode parse(const std::string &s, JSONParseMode mode = JSONParseMode::AUTO);
+
+    /**
+     * @brief Parses JSON text into a tree allocated from an arena
+     *
+     * Arrays, objects and unescaped strings are allocated from arena and the
+     * nodes never free anything, so dropping the document costs nothing and the
+     * memory goes away with the arena (e.g. ORM::RequestArena or a
+     * std::pmr::monotonic_buffer_resource). Keys and string values without
+     * escapes are not copied at all, they point into input.
+     *
+     * @param input JSON text, must outlive the document
+     * @param arena Memory resource for the tree, must outlive the document
+     * @param mode Parser selection, see JSONParseMode
+     * @return Root JSONNode
+     * @throws std::runtime_error on parse errors, with the byte offset of the error
+     *
+     * @note Meant for reading. Values later assigned into the tree are heap
+     *       allocated and are not freed with it; copy the document first to edit it.
+     */
+    static JSONNode parse(std::string_view input, std::pmr::memory_resource *arena,
+                          JSONParseMode mode = JSONParseMode::AUTO);
+
+    /**
+     * @brief Parses JSON text on demand
+     *
+     * The text is structurally indexed and its brackets matched once. Arrays and
+     * objects are only parsed, one level at a time, when operator[], size(),
+     * get<T>() etc. first touch them, so untouched subtrees cost nothing beyond
+     * the index. The nodes share ownership of the text.
+     *
+     * @param s JSON-formatted string, moved into the shared document
      * @return Root JSONNode
-     * @throws std::runtime_error on parse errors
+     * @throws std::runtime_error on invalid UTF-8 or unbalanced brackets. Other
+     *         syntax errors inside a subtree are thrown when it is first accessed.
+     *
+     * @note Like any tree, the result may be read from several threads at once
+     *       through const methods; subtrees are parsed once, by the first reader.
      */
-    static JSONNode parse(const std::string &s);
+    static JSONNode parseLazy(std::string s);
 
     /**
-     * @brief Serializes JSONNode to string
+     * @brief Parses a JSON file
+     *
+     * The file is memory mapped and parsed in place, it is never read into a
+     * std::string first. For input arriving in pieces, or files too big to hold
+     * as one tree, see JSONPushParser (jsonstream.h).
+     *
+     * @param path File to parse
+     * @param mode Parser selection, see JSONParseMode
+     * @return Root JSONNode
+     * @throws std::runtime_error if the file can't be read, or on parse errors
+     */
+    static JSONNode parseFile(const std::string &path, JSONParseMode mode = JSONParseMode::AUTO);
+
+    /**
+     * @brief Serializes JSONNode to compact JSON text
      * @param node Node to serialize
      * @return JSON-formatted string
-     * @throws std::runtime_error on circular references
+     *
+     * @note Use JSONWriter directly to append to an existing buffer or stream
      */
     static std::string stringify(const JSONNode &node);
 
     /**
-     * @brief  This code defines an overloaded << operator for std::ostream, allowing a
-     *  JSONNode object to be printed to an output stream (e.g., std::cout) in a pretty-
-     * formatted JSON style.D
-     * @param nodes Initial array elements
+     * @brief Pretty prints a node tree (4 space indentation) to a stream
+     *
+     * Written through JSONWriter, straight into the stream.
      */
-    friend std::ostream &operator<<(std::ostream &stream, const JSONNode &json)
-    {
-        std::string s = JSONNode::stringify(json);
-        int spaces = 0;
-        int tab = 4;
-        for (char c : s)
-        {
-            if (c == '{' || c == '[')
-            {
-                stream << c;
-                stream << '\n';
-                spaces += tab;
-                stream << std::string(spaces, ' ');
-            }
-            else if (c == '}' || c == ']')
-            {
-                spaces -= tab;
-                stream << '\n';
-                stream << std::string(spaces, ' ');
-                stream << c;
-            }
-            else if (c == ',')
-            {
-                stream << c;
-                stream << '\n';
-                stream << std::string(spaces, ' ');
-            }
-            else
-            {
-                stream << c;
-            }
-        }
-        return stream;
-    }
+    friend std::ostream &operator<<(std::ostream &stream, const JSONNode &json);
 };
 
-/**
- * @brief Parses a JSON object from a given JSON string.
- *
- * This function extracts key-value pairs from a JSON-formatted string and
- * constructs a JSONNode object. It handles nested objects and arrays using recursion.
- *
- * @param s The input JSON string.
- * @param start The index of the opening curly brace '{' for this object.
- * @param end The index of the corresponding closing curly brace '}' for this object.
- * @param bracePair A map that maps indices of opening brackets to their corresponding closing brackets.
- *
- * @return A JSONNode object representing the parsed JSON object.
- */
-JSONNode parseObject(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair);
+static_assert(sizeof(JSONNode) == 16, "JSONNode is expected to be a 16 byte tagged value");
+
+/// Object member, the key is a string node so it can share the string storage rules
+struct JSONNode::Member
+{
+    JSONNode key;
+    JSONNode value;
+};
+
+/// Object storage: members in insertion order plus an optional hash index
+struct JSONNode::Object
+{
+    std::pmr::vector<Member> members;
+
+    /// Open addressing table of member index + 1 (0 = empty slot), empty while small
+    std::pmr::vector<uint32_t> slots;
+
+    Object() = default;
+    explicit Object(std::pmr::memory_resource *resource) : members(resource), slots(resource) {}
+};
 
 /**
- * @brief Parses a JSON array from a given JSON string.
- *
- * This function extracts values from a JSON-formatted string and constructs
- * a JSONNode object representing an array. It processes elements sequentially
- * and handles whitespace correctly.
+ * @class JSONKeyTable
+ * @brief Interns object keys repeated across many sibling objects
  *
- * @param s The input JSON string.
- * @param start The index of the opening square bracket '[' for this array.
- * @param end The index of the corresponding closing square bracket ']' for this array.
- * @param bracePair A map that maps indices of opening brackets to their corresponding closing brackets.
- *
- * @return A JSONNode object representing the parsed JSON array.
+ * Members added with JSONNode::tryEmplace(key, value, &table) share one
+ * reference counted copy of each key, so a 100k row result document stores
+ * every column name once. The nodes keep the names alive, the table may go
+ * away before the document does.
  */
-JSONNode parseArray(const std::string &s, int start, int end, std::unordered_map<int, int> &bracePair);
+class JSONKeyTable
+{
+    /// Interned keys, the map key views the node's shared characters
+    std::unordered_map<std::string_view, JSONNode> d_keys;
+
+    friend class JSONNode;
+
+    /// Shared string node for name, created on first use
+    const JSONNode &intern(std::string_view name);
+
+public:
+    /// Number of distinct keys
+    size_t size() const { return d_keys.size(); }
+};
+
+inline size_t JSONNode::size() const
+{
+    if (isArray())
+    {
+        return arrayStorage().size();
+    }
+    else if (isObject())
+    {
+        return objectStorage().members.size();
+    }
+    throw std::runtime_error("size() called on non-array/non-object JSONNode");
+}
 
 using JSON = JSONNode;
 
-#endif
\ No newline at end of file
+#endif
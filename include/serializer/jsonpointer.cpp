@@ -0,0 +1,291 @@
+#include "jsonpointer.h"
+#include "jsonparser.h"
+
+#include <limits>
+#include <stdexcept>
+
+JSONPointer::JSONPointer(std::string_view pointer)
+{
+    if (pointer.empty())
+        return;
+    if (pointer[0] != '/')
+        throw std::runtime_error("JSON pointer must be empty or start with '/': " + std::string(pointer));
+
+    size_t pos = 1;
+    while (true)
+    {
+        size_t end = pointer.find('/', pos);
+        if (end == std::string_view::npos)
+            end = pointer.size();
+
+        Token token;
+        for (size_t i = pos; i < end; i++)
+        {
+            if (pointer[i] != '~')
+            {
+                token.name += pointer[i];
+                continue;
+            }
+            if (i + 1 == end || (pointer[i + 1] != '0' && pointer[i + 1] != '1'))
+                throw std::runtime_error("invalid ~ escape in JSON pointer: " + std::string(pointer));
+            token.name += pointer[++i] == '0' ? '~' : '/';
+        }
+
+        token.wildcard = token.name == "*";
+
+        // array indexes are "0" or digits without a leading zero
+        const std::string &name = token.name;
+        bool digits = !name.empty() && name.size() <= 18 && (name == "0" || name[0] != '0');
+        for (char c : name)
+            digits = digits && c >= '0' && c <= '9';
+        if (digits)
+            token.index = std::stoll(name);
+
+        d_tokens.push_back(std::move(token));
+        if (end == pointer.size())
+            break;
+        pos = end + 1;
+    }
+}
+
+bool JSONPointer::hasWildcard() const
+{
+    for (const Token &token : d_tokens)
+    {
+        if (token.wildcard)
+            return true;
+    }
+    return false;
+}
+
+void JSONPointer::walk(const JSONNode &node, size_t depth, const std::function<bool(const JSONNode &)> &visit, bool &stop) const
+{
+    if (depth == d_tokens.size())
+    {
+        stop = !visit(node);
+        return;
+    }
+
+    const Token &token = d_tokens[depth];
+    if (node.isObject())
+    {
+        if (!token.wildcard)
+        {
+            if (const JSONNode *member = node.findMember(token.name))
+                walk(*member, depth + 1, visit, stop);
+            return;
+        }
+        for (const auto &member : node.objectStorage().members)
+        {
+            walk(member.value, depth + 1, visit, stop);
+            if (stop)
+                return;
+        }
+    }
+    else if (node.isArray())
+    {
+        const auto &elements = node.arrayStorage();
+        if (!token.wildcard)
+        {
+            if (token.index >= 0 && static_cast<uint64_t>(token.index) < elements.size())
+                walk(elements[token.index], depth + 1, visit, stop);
+            return;
+        }
+        for (const JSONNode &element : elements)
+        {
+            walk(element, depth + 1, visit, stop);
+            if (stop)
+                return;
+        }
+    }
+}
+
+const JSONNode *JSONPointer::find(const JSONNode &root) const
+{
+    const JSONNode *found = nullptr;
+    bool stop = false;
+    walk(root, 0, [&found](const JSONNode &node)
+         {
+             found = &node;
+             return false; },
+         stop);
+    return found;
+}
+
+void JSONPointer::forEach(const JSONNode &root, const std::function<void(const JSONNode &)> &visit) const
+{
+    bool stop = false;
+    walk(root, 0, [&visit](const JSONNode &node)
+         {
+             visit(node);
+             return true; },
+         stop);
+}
+
+std::vector<const JSONNode *> JSONPointer::findAll(const JSONNode &root) const
+{
+    std::vector<const JSONNode *> found;
+    forEach(root, [&found](const JSONNode &node)
+            { found.push_back(&node); });
+    return found;
+}
+
+void JSONPathMatcher::add(JSONPointer pointer, std::function<void(JSONNode &&)> onMatch)
+{
+    if (d_paths.size() >= MAX_PATHS)
+        throw std::runtime_error("JSONPathMatcher: too many paths");
+    d_paths.push_back(Path{std::move(pointer), std::move(onMatch)});
+}
+
+void JSONPathMatcher::startValue(uint64_t &prefix, uint64_t &exact)
+{
+    size_t depth = d_frames.size();
+    uint64_t candidates = 0;
+    if (d_frames.empty())
+    {
+        candidates = d_paths.size() == MAX_PATHS ? ~uint64_t(0) : (uint64_t(1) << d_paths.size()) - 1;
+    }
+    else
+    {
+        Frame &parent = d_frames.back();
+        if (!parent.isObject)
+            parent.index++;
+        // only paths still on track below the parent can match here
+        for (size_t path = 0; path < d_paths.size(); path++)
+        {
+            if (!(parent.prefix >> path & 1))
+                continue;
+            const JSONPointer::Token &token = d_paths[path].pointer.tokens()[depth - 1];
+            bool match = parent.isObject ? JSONPointer::matches(token, parent.key)
+                                         : JSONPointer::matches(token, parent.index);
+            if (match)
+                candidates |= uint64_t(1) << path;
+        }
+    }
+
+    prefix = exact = 0;
+    for (size_t path = 0; path < d_paths.size(); path++)
+    {
+        if (!(candidates >> path & 1))
+            continue;
+        if (d_paths[path].pointer.tokens().size() == depth)
+            exact |= uint64_t(1) << path;
+        else
+            prefix |= uint64_t(1) << path;
+    }
+}
+
+bool JSONPathMatcher::startScalar(uint64_t &exact)
+{
+    uint64_t prefix;
+    startValue(prefix, exact);
+    return exact || (!d_frames.empty() && d_frames.back().building);
+}
+
+void JSONPathMatcher::open(bool isObject)
+{
+    uint64_t prefix, exact;
+    startValue(prefix, exact);
+    bool building = exact || (!d_frames.empty() && d_frames.back().building);
+    d_frames.push_back(Frame{prefix, exact, isObject, building, -1, std::string()});
+    if (building)
+        d_nodes.emplace_back(isObject ? JSONType::OBJECT : JSONType::ARRAY);
+}
+
+void JSONPathMatcher::close()
+{
+    Frame frame = std::move(d_frames.back());
+    d_frames.pop_back();
+    if (!frame.building)
+        return;
+
+    JSONNode node = std::move(d_nodes.back());
+    d_nodes.pop_back();
+    complete(std::move(node), frame.exact);
+}
+
+void JSONPathMatcher::complete(JSONNode &&node, uint64_t exact)
+{
+    bool inMatch = !d_frames.empty() && d_frames.back().building;
+
+    // the last callback may take the node unless an enclosing match still needs it
+    for (size_t path = 0; path < d_paths.size(); path++)
+    {
+        if (!(exact >> path & 1))
+            continue;
+        bool last = !(exact >> path >> 1);
+        if (inMatch || !last)
+            d_paths[path].onMatch(JSONNode(node));
+        else
+            d_paths[path].onMatch(std::move(node));
+    }
+
+    if (!inMatch)
+        return;
+    Frame &parent = d_frames.back();
+    JSONNode &container = d_nodes.back();
+    if (parent.isObject)
+        container[parent.key] = std::move(node);
+    else
+        container.appendArray(std::move(node));
+}
+
+void JSONPathMatcher::beginObject()
+{
+    open(true);
+}
+
+void JSONPathMatcher::endObject()
+{
+    close();
+}
+
+void JSONPathMatcher::beginArray()
+{
+    open(false);
+}
+
+void JSONPathMatcher::endArray()
+{
+    close();
+}
+
+void JSONPathMatcher::key(std::string_view name)
+{
+    d_frames.back().key.assign(name.data(), name.size());
+}
+
+void JSONPathMatcher::stringValue(std::string_view value)
+{
+    uint64_t exact;
+    if (startScalar(exact))
+        complete(JSONNode(std::string(value)), exact);
+}
+
+void JSONPathMatcher::integerValue(int64_t value)
+{
+    uint64_t exact;
+    if (startScalar(exact))
+        complete(JSONNode(value), exact);
+}
+
+void JSONPathMatcher::doubleValue(double value)
+{
+    uint64_t exact;
+    if (startScalar(exact))
+        complete(JSONNode(value), exact);
+}
+
+void JSONPathMatcher::boolValue(bool value)
+{
+    uint64_t exact;
+    if (startScalar(exact))
+        complete(JSONNode(value), exact);
+}
+
+void JSONPathMatcher::nullValue()
+{
+    uint64_t exact;
+    if (startScalar(exact))
+        complete(JSONNode(), exact);
+}
@@ -0,0 +1,157 @@
+#ifndef _JSON_POINTER_H_
+#define _JSON_POINTER_H_
+
+#include "jsonstream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JSONNode;
+
+/**
+ * @class JSONPointer
+ * @brief Compiled RFC 6901 JSON Pointer, with "*" wildcards
+ *
+ * The pointer is split and unescaped (~1 is '/', ~0 is '~') once, array
+ * indexes are converted once, so one JSONPointer can be evaluated against any
+ * number of documents. A "*" token matches every member of an object or every
+ * element of an array; a member literally named "*" is matched by it as well.
+ *
+ * Evaluation never modifies the document: missing members and out of range
+ * indexes simply don't match (unlike JSONNode::operator[], which adds them).
+ * Lazy documents only get the nodes along the path parsed.
+ *
+ * @example
+ * JSONPointer emails("/rows/0/email");
+ * const JSONNode *email = emails.find(doc);
+ * emails.forEach(doc, [](const JSONNode &email) { ... });
+ */
+class JSONPointer
+{
+public:
+    /// One reference token of the pointer
+    struct Token
+    {
+        std::string name;    ///< Unescaped member name
+        int64_t index = -1;  ///< Array index, -1 if the token isn't one ("-" never matches)
+        bool wildcard = false;
+    };
+
+private:
+    std::vector<Token> d_tokens;
+
+    void walk(const JSONNode &node, size_t depth, const std::function<bool(const JSONNode &)> &visit, bool &stop) const;
+
+public:
+    /**
+     * @brief Compiles a pointer
+     * @param pointer "" for the whole document, otherwise "/token/token..."
+     * @throws std::runtime_error if pointer doesn't start with '/' or has an invalid ~ escape
+     */
+    explicit JSONPointer(std::string_view pointer);
+
+    /**
+     * @brief First matching node in document order
+     * @return The node, or nullptr if nothing matches
+     */
+    const JSONNode *find(const JSONNode &root) const;
+
+    /**
+     * @brief Calls visit for every matching node, in document order
+     */
+    void forEach(const JSONNode &root, const std::function<void(const JSONNode &)> &visit) const;
+
+    /**
+     * @brief All matching nodes, in document order
+     */
+    std::vector<const JSONNode *> findAll(const JSONNode &root) const;
+
+    const std::vector<Token> &tokens() const { return d_tokens; }
+
+    /// Whether the pointer has "*" tokens and so may match more than one node
+    bool hasWildcard() const;
+
+    /// Whether token matches the object member name
+    static bool matches(const Token &token, std::string_view name) { return token.wildcard || token.name == name; }
+
+    /// Whether token matches the array index
+    static bool matches(const Token &token, int64_t index) { return token.wildcard || token.index == index; }
+};
+
+/**
+ * @class JSONPathMatcher
+ * @brief Evaluates JSON pointers while a JSONPushParser parses
+ *
+ * Only the values matching one of the pointers are built as nodes, the rest of
+ * the input is checked and dropped, so large documents and streams can be
+ * queried without building their DOM. Every top-level value of the stream is
+ * matched separately (NDJSON).
+ *
+ * @example
+ * JSONPathMatcher matcher;
+ * matcher.add(JSONPointer("/rows/0"), [](JSONNode &&row) { ... });
+ * JSONPushParser parser(matcher);
+ * parser.feed(chunk);
+ * ...
+ * parser.finish();
+ */
+class JSONPathMatcher : public JSONHandler
+{
+    /// Open array or object
+    struct Frame
+    {
+        uint64_t prefix;    ///< Paths that go on below this container
+        uint64_t exact;     ///< Paths matching this container itself
+        bool isObject;
+        bool building;      ///< A node is being built for it (it or an ancestor matched)
+        int64_t index = -1; ///< Current element (arrays)
+        std::string key;    ///< Current member name (objects)
+    };
+
+    struct Path
+    {
+        JSONPointer pointer;
+        std::function<void(JSONNode &&)> onMatch;
+    };
+
+    std::vector<Path> d_paths;
+    std::vector<Frame> d_frames;
+    std::vector<JSONNode> d_nodes; ///< Nodes under construction, one per building frame
+
+    /// Paths of the value starting now (those ending at it in exact, the rest in prefix)
+    void startValue(uint64_t &prefix, uint64_t &exact);
+    /// Whether the scalar starting now is needed, a match or part of one
+    bool startScalar(uint64_t &exact);
+    void open(bool isObject);
+    void close();
+    void complete(JSONNode &&node, uint64_t exact);
+
+public:
+    /// Most paths one matcher can evaluate
+    static constexpr size_t MAX_PATHS = 64;
+
+    /**
+     * @brief Adds a pointer to evaluate
+     * @param pointer Path to match
+     * @param onMatch Called with each matching value, as soon as it is complete
+     * @throws std::runtime_error if MAX_PATHS are added already
+     */
+    void add(JSONPointer pointer, std::function<void(JSONNode &&)> onMatch);
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(std::string_view name) override;
+    void stringValue(std::string_view value) override;
+    void integerValue(int64_t value) override;
+    void doubleValue(double value) override;
+    void boolValue(bool value) override;
+    void nullValue() override;
+};
+
+#endif
@@ -0,0 +1,556 @@
+#include "jsonstream.h"
+#include "jsonparser.h"
+#include "jsonstructural.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+/// Handler building the nodes passed on by JSONPushParser(onValue)
+class JSONPushParser::ElementBuilder : public JSONHandler
+{
+    std::function<void(JSONNode &&)> d_onValue;
+    std::vector<JSONNode> d_open;    ///< Containers being built, innermost last
+    std::vector<std::string> d_keys; ///< Name of the member being read, per open object
+    size_t d_depth = 0;              ///< Nesting depth, counting an unwrapped top-level array
+    bool d_unwrapped = false;        ///< The top-level value is an array, its elements are passed on
+
+    void add(JSONNode &&node)
+    {
+        if (d_open.empty())
+        {
+            d_onValue(std::move(node));
+            return;
+        }
+        JSONNode &parent = d_open.back();
+        if (parent.isArray())
+            parent.d_array->push_back(std::move(node));
+        else
+            parent.member(d_keys.back()) = std::move(node);
+    }
+
+    void open(JSONType type)
+    {
+        if (d_depth++ == 0 && type == JSONType::ARRAY)
+        {
+            d_unwrapped = true;
+            return;
+        }
+        d_open.emplace_back(type);
+        if (type == JSONType::OBJECT)
+            d_keys.emplace_back();
+    }
+
+    void close()
+    {
+        if (--d_depth == 0 && d_unwrapped)
+        {
+            d_unwrapped = false;
+            return;
+        }
+        JSONNode node = std::move(d_open.back());
+        d_open.pop_back();
+        if (node.isObject())
+            d_keys.pop_back();
+        add(std::move(node));
+    }
+
+public:
+    explicit ElementBuilder(std::function<void(JSONNode &&)> onValue) : d_onValue(std::move(onValue)) {}
+
+    void beginObject() override { open(JSONType::OBJECT); }
+    void endObject() override { close(); }
+    void beginArray() override { open(JSONType::ARRAY); }
+    void endArray() override { close(); }
+
+    void key(std::string_view name) override { d_keys.back().assign(name.data(), name.size()); }
+
+    void stringValue(std::string_view value) override
+    {
+        JSONNode node;
+        node.d_type = JSONType::STRING;
+        node.setString(value);
+        add(std::move(node));
+    }
+    void integerValue(int64_t value) override { add(JSONNode(value)); }
+    void doubleValue(double value) override { add(JSONNode(value)); }
+    void boolValue(bool value) override { add(JSONNode(value)); }
+    void nullValue() override { add(JSONNode()); }
+};
+
+JSONPushParser::JSONPushParser(JSONHandler &handler) : d_handler(handler) {}
+
+JSONPushParser::JSONPushParser(std::function<void(JSONNode &&)> onValue)
+    : d_builder(std::make_unique<ElementBuilder>(std::move(onValue))), d_handler(*d_builder) {}
+
+JSONPushParser::~JSONPushParser() = default;
+
+void JSONPushParser::fail(uint64_t offset, const char *message) const
+{
+    throw std::runtime_error("JSON parse error at offset " + std::to_string(offset) + ": " + message);
+}
+
+namespace
+{
+    bool isWhiteSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    /// Checks text against the JSON number grammar
+    bool isNumber(std::string_view text)
+    {
+        size_t i = 0, n = text.size();
+        auto digits = [&]
+        {
+            size_t start = i;
+            while (i < n && text[i] >= '0' && text[i] <= '9')
+                i++;
+            return i > start;
+        };
+
+        if (i < n && text[i] == '-')
+            i++;
+        if (i < n && text[i] == '0')
+            i++;
+        else if (!digits())
+            return false;
+        if (i < n && text[i] == '.')
+        {
+            i++;
+            if (!digits())
+                return false;
+        }
+        if (i < n && (text[i] == 'e' || text[i] == 'E'))
+        {
+            i++;
+            if (i < n && (text[i] == '+' || text[i] == '-'))
+                i++;
+            if (!digits())
+                return false;
+        }
+        return i == n;
+    }
+}
+
+void JSONPushParser::feed(std::string_view chunk)
+{
+    const char *data = chunk.data();
+    size_t size = chunk.size();
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        switch (d_state)
+        {
+        case State::STRING:
+            pos = readString(data, pos, size);
+            continue;
+        case State::ESCAPE:
+            pos = readEscape(data, pos);
+            continue;
+        case State::UNICODE:
+            pos = readUnicode(data, pos, size);
+            continue;
+        case State::NUMBER:
+            pos = readNumber(data, pos, size);
+            continue;
+        case State::LITERAL:
+            pos = readLiteral(data, pos, size);
+            continue;
+        default:
+            break;
+        }
+
+        char c = data[pos];
+        if (isWhiteSpace(c))
+        {
+            pos++;
+            continue;
+        }
+
+        switch (d_state)
+        {
+        case State::FIRST_VALUE:
+            if (c == ']')
+            {
+                d_open.pop_back();
+                d_handler.endArray();
+                endValue();
+                pos++;
+                break;
+            }
+            pos = beginValue(data, pos, size);
+            break;
+
+        case State::VALUE:
+            pos = beginValue(data, pos, size);
+            break;
+
+        case State::FIRST_KEY:
+            if (c == '}')
+            {
+                d_open.pop_back();
+                d_handler.endObject();
+                endValue();
+                pos++;
+                break;
+            }
+            [[fallthrough]];
+        case State::KEY:
+            if (c != '"')
+                fail(d_offset + pos, "expected object key");
+            d_token.clear();
+            d_stringIsKey = true;
+            d_state = State::STRING;
+            pos++;
+            break;
+
+        case State::COLON:
+            if (c != ':')
+                fail(d_offset + pos, "expected ':' after object key");
+            d_state = State::VALUE;
+            pos++;
+            break;
+
+        case State::AFTER_VALUE:
+        {
+            bool inObject = d_open.back() == '{';
+            if (c == ',')
+            {
+                d_state = inObject ? State::KEY : State::VALUE;
+            }
+            else if (c == (inObject ? '}' : ']'))
+            {
+                d_open.pop_back();
+                if (inObject)
+                    d_handler.endObject();
+                else
+                    d_handler.endArray();
+                endValue();
+            }
+            else
+            {
+                fail(d_offset + pos, inObject ? "expected ',' or '}' in object" : "expected ',' or ']' in array");
+            }
+            pos++;
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+    d_offset += size;
+}
+
+void JSONPushParser::finish()
+{
+    switch (d_state)
+    {
+    case State::NUMBER:
+        endNumber(d_offset);
+        break;
+    case State::STRING:
+    case State::ESCAPE:
+    case State::UNICODE:
+        fail(d_offset, "unterminated string");
+    case State::LITERAL:
+        fail(d_offset, "invalid literal");
+    default:
+        break;
+    }
+    if (!d_open.empty())
+        fail(d_offset, "unterminated array or object");
+}
+
+size_t JSONPushParser::beginValue(const char *data, size_t pos, size_t size)
+{
+    switch (data[pos])
+    {
+    case '{':
+    case '[':
+        if (d_open.size() >= MAX_DEPTH)
+            fail(d_offset + pos, "maximum nesting depth exceeded");
+        d_open.push_back(data[pos]);
+        if (data[pos] == '{')
+        {
+            d_handler.beginObject();
+            d_state = State::FIRST_KEY;
+        }
+        else
+        {
+            d_handler.beginArray();
+            d_state = State::FIRST_VALUE;
+        }
+        return pos + 1;
+    case '"':
+        d_token.clear();
+        d_stringIsKey = false;
+        d_state = State::STRING;
+        return pos + 1;
+    case 't':
+        d_literal = "true";
+        break;
+    case 'f':
+        d_literal = "false";
+        break;
+    case 'n':
+        d_literal = "null";
+        break;
+    default:
+        d_token.clear();
+        d_state = State::NUMBER;
+        return readNumber(data, pos, size);
+    }
+    d_token.clear();
+    d_state = State::LITERAL;
+    return readLiteral(data, pos, size);
+}
+
+size_t JSONPushParser::readString(const char *data, size_t pos, size_t size)
+{
+    // a high surrogate escape must be followed by the low one right away
+    if (d_highSurrogate && data[pos] != '\\')
+        fail(d_offset + pos, "unpaired surrogate in \\u escape");
+
+    size_t run = pos;
+    while (pos < size)
+    {
+        unsigned char c = static_cast<unsigned char>(data[pos]);
+        if (c < 0x20 || c == '"' || c == '\\')
+            break;
+        pos++;
+    }
+    d_token.append(data + run, pos - run);
+    if (pos == size)
+        return pos;
+
+    switch (data[pos])
+    {
+    case '"':
+        endString(d_offset + pos);
+        return pos + 1;
+    case '\\':
+        d_state = State::ESCAPE;
+        return pos + 1;
+    default:
+        fail(d_offset + pos, "control character in string");
+    }
+}
+
+size_t JSONPushParser::readEscape(const char *data, size_t pos)
+{
+    char c = data[pos];
+    if (d_highSurrogate && c != 'u')
+        fail(d_offset + pos, "unpaired surrogate in \\u escape");
+
+    d_state = State::STRING;
+    switch (c)
+    {
+    case '"':
+    case '\\':
+    case '/':
+        d_token += c;
+        break;
+    case 'b':
+        d_token += '\b';
+        break;
+    case 'f':
+        d_token += '\f';
+        break;
+    case 'n':
+        d_token += '\n';
+        break;
+    case 'r':
+        d_token += '\r';
+        break;
+    case 't':
+        d_token += '\t';
+        break;
+    case 'u':
+        d_code = 0;
+        d_hexDigits = 0;
+        d_state = State::UNICODE;
+        break;
+    default:
+        fail(d_offset + pos, "invalid escape sequence");
+    }
+    return pos + 1;
+}
+
+size_t JSONPushParser::readUnicode(const char *data, size_t pos, size_t size)
+{
+    while (pos < size && d_hexDigits < 4)
+    {
+        int v = hexValue(data[pos]);
+        if (v < 0)
+            fail(d_offset + pos, "invalid \\u escape");
+        d_code = (d_code << 4) | static_cast<uint32_t>(v);
+        d_hexDigits++;
+        pos++;
+    }
+    if (d_hexDigits < 4)
+        return pos;
+
+    d_state = State::STRING;
+    if (d_highSurrogate)
+    {
+        if (d_code < 0xDC00 || d_code > 0xDFFF)
+            fail(d_offset + pos, "invalid low surrogate in \\u escape");
+        appendUTF8(0x10000 + ((d_highSurrogate - 0xD800) << 10) + (d_code - 0xDC00));
+        d_highSurrogate = 0;
+    }
+    else if (d_code >= 0xD800 && d_code <= 0xDBFF)
+    {
+        d_highSurrogate = d_code;
+    }
+    else if (d_code >= 0xDC00 && d_code <= 0xDFFF)
+    {
+        fail(d_offset + pos, "unpaired surrogate in \\u escape");
+    }
+    else
+    {
+        appendUTF8(d_code);
+    }
+    return pos;
+}
+
+size_t JSONPushParser::readNumber(const char *data, size_t pos, size_t size)
+{
+    size_t run = pos;
+    while (pos < size)
+    {
+        char c = data[pos];
+        if ((c < '0' || c > '9') && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E')
+            break;
+        pos++;
+    }
+    d_token.append(data + run, pos - run);
+    // the number only ends at the first byte that can't be part of it
+    if (pos < size)
+        endNumber(d_offset + pos);
+    return pos;
+}
+
+size_t JSONPushParser::readLiteral(const char *data, size_t pos, size_t size)
+{
+    size_t length = std::strlen(d_literal);
+    while (pos < size && d_token.size() < length)
+    {
+        if (data[pos] != d_literal[d_token.size()])
+            fail(d_offset + pos, "invalid literal");
+        d_token += data[pos++];
+    }
+    if (d_token.size() < length)
+        return pos;
+
+    if (d_literal[0] == 'n')
+        d_handler.nullValue();
+    else
+        d_handler.boolValue(d_literal[0] == 't');
+    endValue();
+    return pos;
+}
+
+void JSONPushParser::appendUTF8(uint32_t code)
+{
+    if (code < 0x80)
+    {
+        d_token += static_cast<char>(code);
+    }
+    else if (code < 0x800)
+    {
+        d_token += static_cast<char>(0xC0 | (code >> 6));
+        d_token += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000)
+    {
+        d_token += static_cast<char>(0xE0 | (code >> 12));
+        d_token += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        d_token += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else
+    {
+        d_token += static_cast<char>(0xF0 | (code >> 18));
+        d_token += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        d_token += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        d_token += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+void JSONPushParser::endString(uint64_t offset)
+{
+    // checked once complete, sequences may be split across chunks; escapes always
+    // decode to whole sequences so they can't hide invalid input bytes
+    const char *end = d_token.data() + d_token.size();
+    for (const char *p = d_token.data(); p < end;)
+    {
+        if (static_cast<unsigned char>(*p) < 0x80)
+        {
+            p++;
+            continue;
+        }
+        size_t length = utf8SequenceLength(p, end);
+        if (!length)
+            fail(offset, "invalid UTF-8 in string");
+        p += length;
+    }
+
+    if (d_stringIsKey)
+    {
+        d_handler.key(d_token);
+        d_state = State::COLON;
+        return;
+    }
+    d_handler.stringValue(d_token);
+    endValue();
+}
+
+void JSONPushParser::endNumber(uint64_t offset)
+{
+    const char *start = d_token.data();
+    const char *end = start + d_token.size();
+    if (!isNumber(d_token))
+        fail(offset - d_token.size(), "invalid number");
+
+    // integers are kept exact as int64, unless they overflow it (or are -0)
+    if (d_token.find_first_of(".eE") == std::string::npos)
+    {
+        int64_t integer = 0;
+        auto result = std::from_chars(start, end, integer);
+        if (result.ec == std::errc() && !(integer == 0 && *start == '-'))
+        {
+            d_handler.integerValue(integer);
+            endValue();
+            return;
+        }
+    }
+
+    double value = 0;
+    auto result = std::from_chars(start, end, value);
+    if (result.ec == std::errc::result_out_of_range)
+    {
+        // overflow / underflow: fall back to strtod for +-HUGE_VAL / 0
+        value = std::strtod(d_token.c_str(), nullptr);
+    }
+    d_handler.doubleValue(value);
+    endValue();
+}
+
+void JSONPushParser::endValue()
+{
+    d_state = d_open.empty() ? State::VALUE : State::AFTER_VALUE;
+}
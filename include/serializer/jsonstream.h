@@ -0,0 +1,148 @@
+#ifndef _JSON_STREAM_H_
+#define _JSON_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JSONNode;
+
+/**
+ * @class JSONHandler
+ * @brief Receives the SAX events of a JSONPushParser
+ *
+ * Every callback does nothing by default, override the ones you need. Strings
+ * passed in are only valid during the call.
+ */
+class JSONHandler
+{
+public:
+    virtual ~JSONHandler() = default;
+
+    virtual void beginObject() {}
+    virtual void endObject() {}
+    virtual void beginArray() {}
+    virtual void endArray() {}
+
+    /// Object member name, the next event is its value
+    virtual void key(std::string_view) {}
+
+    virtual void stringValue(std::string_view) {}
+    /// Numbers without fraction or exponent that fit in an int64
+    virtual void integerValue(int64_t) {}
+    virtual void doubleValue(double) {}
+    virtual void boolValue(bool) {}
+    virtual void nullValue() {}
+};
+
+/**
+ * @class JSONPushParser
+ * @brief Incremental JSON parser fed with arbitrary chunks of text
+ *
+ * The input is a sequence of JSON values separated by optional whitespace, so
+ * a single document, newline delimited JSON and concatenated values are all
+ * accepted. Chunks may split the text anywhere, even inside strings, escapes
+ * or numbers. Memory use is bounded by the nesting depth and the longest
+ * string or number, not by the size of the input.
+ *
+ * It either forwards SAX events to a JSONHandler, or builds node trees and
+ * passes on every completed value. In that mode a top-level array is not
+ * built as a whole: each of its elements is passed on as soon as it is
+ * complete, so a huge array file needs the memory of one element only.
+ *
+ * Syntax is checked exactly like JSONNode::parse does (string escapes, UTF-8,
+ * number grammar, nesting limit).
+ *
+ * @example
+ * JSONPushParser parser([](JSONNode &&row) { process(row); });
+ * while (size_t n = read(fd, buffer, sizeof(buffer)))
+ *     parser.feed(std::string_view(buffer, n));
+ * parser.finish();
+ */
+class JSONPushParser
+{
+    class ElementBuilder;
+
+    /// What the next byte is expected to be
+    enum class State : uint8_t
+    {
+        VALUE,       ///< Any value, or the end of the input at the top level
+        FIRST_VALUE, ///< Just after '[': a value or ']'
+        FIRST_KEY,   ///< Just after '{': a key or '}'
+        KEY,         ///< After ',' in an object: a key
+        COLON,       ///< After a key
+        AFTER_VALUE, ///< ',' or the closing bracket of the container
+        STRING,      ///< Inside a string
+        ESCAPE,      ///< After a backslash in a string
+        UNICODE,     ///< Inside the 4 hex digits of a \u escape
+        NUMBER,      ///< Inside a number
+        LITERAL      ///< Inside true, false or null
+    };
+
+    std::unique_ptr<ElementBuilder> d_builder; ///< Set when passing on nodes
+    JSONHandler &d_handler;
+
+    State d_state = State::VALUE;
+    std::vector<char> d_open;  ///< Open brackets, innermost last
+    std::string d_token;       ///< String, number or literal read so far
+    bool d_stringIsKey = false; ///< The string being read is an object key
+    uint32_t d_code = 0;       ///< \u escape digits read so far
+    uint32_t d_highSurrogate = 0; ///< Pending high surrogate of a \u pair
+    int d_hexDigits = 0;       ///< Number of \u digits read
+    const char *d_literal = nullptr; ///< true, false or null being matched
+    uint64_t d_offset = 0;     ///< Input offset of the start of the current chunk
+
+    /// Nesting limit, same as JSONNode::parse
+    static constexpr size_t MAX_DEPTH = 512;
+
+    [[noreturn]] void fail(uint64_t offset, const char *message) const;
+
+    size_t beginValue(const char *data, size_t pos, size_t size);
+    size_t readString(const char *data, size_t pos, size_t size);
+    size_t readEscape(const char *data, size_t pos);
+    size_t readUnicode(const char *data, size_t pos, size_t size);
+    size_t readNumber(const char *data, size_t pos, size_t size);
+    size_t readLiteral(const char *data, size_t pos, size_t size);
+    void endString(uint64_t offset);
+    void endNumber(uint64_t offset);
+    void endValue();
+    void appendUTF8(uint32_t code);
+
+public:
+    /**
+     * @brief Parser forwarding SAX events
+     * @param handler Receives the events, must outlive the parser
+     */
+    explicit JSONPushParser(JSONHandler &handler);
+
+    /**
+     * @brief Parser passing on completed values
+     * @param onValue Called with every top-level value, or with every element
+     *                when the top-level value is an array
+     */
+    explicit JSONPushParser(std::function<void(JSONNode &&)> onValue);
+
+    JSONPushParser(const JSONPushParser &) = delete;
+    JSONPushParser &operator=(const JSONPushParser &) = delete;
+
+    ~JSONPushParser();
+
+    /**
+     * @brief Parses the next chunk of input
+     * @throws std::runtime_error on syntax errors, with the byte offset in the whole input.
+     *         The parser can't be used any more after an error.
+     */
+    void feed(std::string_view chunk);
+
+    /**
+     * @brief Marks the end of the input
+     * @throws std::runtime_error if the input ends inside a value
+     */
+    void finish();
+};
+
+#endif
@@ -0,0 +1,561 @@
+#include "jsonstructural.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define JSON_STRUCTURAL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t BLOCK_SIZE = 64;
+
+    /// Classification of one 64 byte block, bit i describes byte i
+    struct BlockMasks
+    {
+        uint64_t quote;
+        uint64_t backslash;
+        uint64_t structural; ///< { } [ ] : ,
+        uint64_t whitespace; ///< space, \t, \n, \r
+        uint64_t nonAscii;
+    };
+
+    /**
+     * Scalar classifier, also used for the last partial block of every kernel.
+     * Bytes at or past size are classified as whitespace.
+     */
+    inline void classifyScalar(const char *p, size_t size, BlockMasks &m)
+    {
+        m = BlockMasks{0, 0, 0, ~uint64_t(0), 0};
+        for (size_t i = 0; i < size; i++)
+        {
+            unsigned char c = static_cast<unsigned char>(p[i]);
+            uint64_t bit = uint64_t(1) << i;
+            bool whitespace = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+            if (!whitespace)
+                m.whitespace &= ~bit;
+            if (c == '"')
+                m.quote |= bit;
+            else if (c == '\\')
+                m.backslash |= bit;
+            else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',')
+                m.structural |= bit;
+            else if (c >= 0x80)
+                m.nonAscii |= bit;
+        }
+    }
+
+#ifdef JSON_STRUCTURAL_X86
+    struct SSE2Classifier
+    {
+        static inline void classify(const char *p, BlockMasks &m)
+        {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i lowerBit = _mm_set1_epi8(0x20);
+            const __m128i openBrace = _mm_set1_epi8('{');
+            const __m128i closeBrace = _mm_set1_epi8('}');
+            const __m128i colon = _mm_set1_epi8(':');
+            const __m128i comma = _mm_set1_epi8(',');
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i newline = _mm_set1_epi8('\n');
+            const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+            m = BlockMasks{0, 0, 0, 0, 0};
+            for (int i = 0; i < 4; i++)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+                auto bits = [i](__m128i x)
+                { return uint64_t(uint32_t(_mm_movemask_epi8(x))) << (16 * i); };
+
+                // '[' and ']' become '{' and '}' once the 0x20 bit is set
+                __m128i folded = _mm_or_si128(v, lowerBit);
+                __m128i structural = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(folded, openBrace), _mm_cmpeq_epi8(folded, closeBrace)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+                __m128i whitespace = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, carriageReturn)));
+
+                m.quote |= bits(_mm_cmpeq_epi8(v, quote));
+                m.backslash |= bits(_mm_cmpeq_epi8(v, backslash));
+                m.structural |= bits(structural);
+                m.whitespace |= bits(whitespace);
+                m.nonAscii |= bits(v);
+            }
+        }
+    };
+
+    struct AVX2Classifier
+    {
+        __attribute__((target("avx2"))) static inline void classify(const char *p, BlockMasks &m)
+        {
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i lowerBit = _mm256_set1_epi8(0x20);
+            const __m256i openBrace = _mm256_set1_epi8('{');
+            const __m256i closeBrace = _mm256_set1_epi8('}');
+            const __m256i colon = _mm256_set1_epi8(':');
+            const __m256i comma = _mm256_set1_epi8(',');
+            const __m256i space = _mm256_set1_epi8(' ');
+            const __m256i tab = _mm256_set1_epi8('\t');
+            const __m256i newline = _mm256_set1_epi8('\n');
+            const __m256i carriageReturn = _mm256_set1_epi8('\r');
+
+            m = BlockMasks{0, 0, 0, 0, 0};
+            for (int i = 0; i < 2; i++)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32 * i));
+                auto bits = [i](__m256i x) __attribute__((target("avx2")))
+                { return uint64_t(uint32_t(_mm256_movemask_epi8(x))) << (32 * i); };
+
+                __m256i folded = _mm256_or_si256(v, lowerBit);
+                __m256i structural = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(folded, openBrace), _mm256_cmpeq_epi8(folded, closeBrace)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+                __m256i whitespace = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, newline), _mm256_cmpeq_epi8(v, carriageReturn)));
+
+                m.quote |= bits(_mm256_cmpeq_epi8(v, quote));
+                m.backslash |= bits(_mm256_cmpeq_epi8(v, backslash));
+                m.structural |= bits(structural);
+                m.whitespace |= bits(whitespace);
+                m.nonAscii |= bits(v);
+            }
+        }
+    };
+#else
+    struct ScalarClassifier
+    {
+        static inline void classify(const char *p, BlockMasks &m)
+        {
+            classifyScalar(p, BLOCK_SIZE, m);
+        }
+    };
+#endif
+
+    /// Bit i of the result is the xor of bits 0..i of x
+    inline uint64_t prefixXor(uint64_t x)
+    {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    [[noreturn]] void invalidUTF8(const char *data, const char *at)
+    {
+        throw std::runtime_error("JSON parse error at offset " + std::to_string(at - data) + ": invalid UTF-8");
+    }
+
+    /// Throws for the first invalid sequence of the document, called once a vector check failed
+    [[noreturn]] void locateInvalidUTF8(const char *data, size_t size)
+    {
+        const char *end = data + size;
+        for (const char *p = data; p < end;)
+        {
+            size_t length = utf8SequenceLength(p, end);
+            if (!length)
+                invalidUTF8(data, p);
+            p += length;
+        }
+        throw std::logic_error("UTF-8 check failed on valid input");
+    }
+
+    /**
+     * Sequence by sequence UTF-8 check of the blocks with non-ASCII bytes.
+     * check() gets the offset of a 64 byte block and its bytes (a padded copy
+     * for the last, partial block).
+     */
+    class ScalarUTF8
+    {
+    public:
+        ScalarUTF8(const char *data, size_t size) : data_(data), end_(data + size), pos_(data) {}
+
+        void check(size_t offset, const char *)
+        {
+            const char *p = std::max(pos_, data_ + offset);
+            const char *blockEnd = std::min(data_ + offset + BLOCK_SIZE, end_);
+            while (p < blockEnd)
+            {
+                if (static_cast<unsigned char>(*p) < 0x80)
+                {
+                    p++;
+                    continue;
+                }
+                size_t length = utf8SequenceLength(p, end_);
+                if (!length)
+                    invalidUTF8(data_, p);
+                p += length; // may run into the next block
+            }
+            pos_ = p;
+        }
+
+        void ascii() {}
+        void finish() {}
+
+    private:
+        const char *data_;
+        const char *end_;
+        const char *pos_; // everything before is validated
+    };
+
+#ifdef JSON_STRUCTURAL_X86
+    /*
+     * Vector UTF-8 check (Keiser and Lemire, "Validating UTF-8 In Less Than One
+     * Instruction Per Byte"). Every byte is looked up by the high nibble of the
+     * byte before it, that byte's low nibble and its own high nibble; the three
+     * flag sets only share a bit for an invalid pair. Positions two and three bytes
+     * after a 3 and 4 byte lead must be continuations, which the pair tables can't
+     * see, so that is checked with saturating subtractions. Errors accumulate over
+     * the document and are only looked at in finish().
+     */
+    namespace utf8
+    {
+        constexpr uint8_t TOO_SHORT = 1 << 0;  // lead byte followed by a lead byte or ASCII
+        constexpr uint8_t TOO_LONG = 1 << 1;   // ASCII followed by a continuation
+        constexpr uint8_t OVERLONG_3 = 1 << 2; // E0 80..9F
+        constexpr uint8_t TOO_LARGE = 1 << 3;  // F4 90..BF, F5..FF
+        constexpr uint8_t SURROGATE = 1 << 4;  // ED A0..BF
+        constexpr uint8_t OVERLONG_2 = 1 << 5; // C0, C1
+        constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+        constexpr uint8_t OVERLONG_4 = 1 << 6; // F0 80..8F
+        constexpr uint8_t TWO_CONTS = 1 << 7;  // continuation after a continuation, fine if a lead requires it
+        constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+        // by the high nibble of the first byte of a pair
+        constexpr uint8_t FIRST_HIGH[16] = {
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+            TOO_SHORT | OVERLONG_2,
+            TOO_SHORT,
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+
+        // by the low nibble of the first byte
+        constexpr uint8_t FIRST_LOW[16] = {
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            CARRY | OVERLONG_2,
+            CARRY,
+            CARRY,
+            CARRY | TOO_LARGE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000};
+
+        // by the high nibble of the second byte
+        constexpr uint8_t SECOND_HIGH[16] = {
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+
+        /// Largest byte that ends a chunk without starting an unfinished sequence, by position
+        constexpr uint8_t COMPLETE_MAX[32] = {
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF};
+    }
+
+    /// The vector check over 16 byte chunks, needs SSSE3 for the nibble lookups
+    class SSSE3UTF8
+    {
+    public:
+        __attribute__((target("ssse3"))) SSSE3UTF8(const char *data, size_t size)
+            : data_(data), size_(size), error_(_mm_setzero_si128()), prev_(_mm_setzero_si128()), incomplete_(_mm_setzero_si128()) {}
+
+        __attribute__((target("ssse3"))) inline void check(size_t, const char *block)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+                __m128i prev1 = _mm_alignr_epi8(input, prev_, 15);
+                __m128i prev2 = _mm_alignr_epi8(input, prev_, 14);
+                __m128i prev3 = _mm_alignr_epi8(input, prev_, 13);
+
+                __m128i special = _mm_and_si128(
+                    _mm_and_si128(lookup(utf8::FIRST_HIGH, highNibble(prev1)), lookup(utf8::FIRST_LOW, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+                    lookup(utf8::SECOND_HIGH, highNibble(input)));
+                // high bit set where the byte is the 3rd of a 3 or 4 byte sequence, or the 4th of a 4 byte one
+                __m128i required = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(char(0xE0 - 0x80))),
+                                                _mm_subs_epu8(prev3, _mm_set1_epi8(char(0xF0 - 0x80))));
+                error_ = _mm_or_si128(error_, _mm_xor_si128(special, _mm_and_si128(required, _mm_set1_epi8(char(0x80)))));
+                prev_ = input;
+            }
+            incomplete_ = _mm_subs_epu8(prev_, _mm_loadu_si128(reinterpret_cast<const __m128i *>(utf8::COMPLETE_MAX + 16)));
+        }
+
+        /// A block without non-ASCII bytes, only an unfinished sequence before it can fail
+        __attribute__((target("ssse3"))) inline void ascii()
+        {
+            error_ = _mm_or_si128(error_, incomplete_);
+            prev_ = incomplete_ = _mm_setzero_si128();
+        }
+
+        __attribute__((target("ssse3"))) inline void finish()
+        {
+            ascii();
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(error_, _mm_setzero_si128())) != 0xFFFF)
+                locateInvalidUTF8(data_, size_);
+        }
+
+    private:
+        const char *data_;
+        size_t size_;
+        __m128i error_;
+        __m128i prev_; // last chunk checked
+        __m128i incomplete_;
+
+        __attribute__((target("ssse3"))) static inline __m128i highNibble(__m128i v)
+        {
+            return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+        }
+
+        __attribute__((target("ssse3"))) static inline __m128i lookup(const uint8_t (&table)[16], __m128i nibbles)
+        {
+            return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table)), nibbles);
+        }
+    };
+
+    /// The vector check over 32 byte chunks
+    class AVX2UTF8
+    {
+    public:
+        __attribute__((target("avx2"))) AVX2UTF8(const char *data, size_t size)
+            : data_(data), size_(size), error_(_mm256_setzero_si256()), prev_(_mm256_setzero_si256()), incomplete_(_mm256_setzero_si256()) {}
+
+        __attribute__((target("avx2"))) inline void check(size_t, const char *block)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32 * i));
+                // the 16 bytes before each lane: upper lane of prev_ and lower lane of input
+                __m256i before = _mm256_permute2x128_si256(prev_, input, 0x21);
+                __m256i prev1 = _mm256_alignr_epi8(input, before, 15);
+                __m256i prev2 = _mm256_alignr_epi8(input, before, 14);
+                __m256i prev3 = _mm256_alignr_epi8(input, before, 13);
+
+                __m256i special = _mm256_and_si256(
+                    _mm256_and_si256(lookup(utf8::FIRST_HIGH, highNibble(prev1)), lookup(utf8::FIRST_LOW, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+                    lookup(utf8::SECOND_HIGH, highNibble(input)));
+                __m256i required = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(char(0xE0 - 0x80))),
+                                                   _mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xF0 - 0x80))));
+                error_ = _mm256_or_si256(error_, _mm256_xor_si256(special, _mm256_and_si256(required, _mm256_set1_epi8(char(0x80)))));
+                prev_ = input;
+            }
+            incomplete_ = _mm256_subs_epu8(prev_, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(utf8::COMPLETE_MAX)));
+        }
+
+        __attribute__((target("avx2"))) inline void ascii()
+        {
+            error_ = _mm256_or_si256(error_, incomplete_);
+            prev_ = incomplete_ = _mm256_setzero_si256();
+        }
+
+        __attribute__((target("avx2"))) inline void finish()
+        {
+            ascii();
+            if (!_mm256_testz_si256(error_, error_))
+                locateInvalidUTF8(data_, size_);
+        }
+
+    private:
+        const char *data_;
+        size_t size_;
+        __m256i error_;
+        __m256i prev_;
+        __m256i incomplete_;
+
+        __attribute__((target("avx2"))) static inline __m256i highNibble(__m256i v)
+        {
+            return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+        }
+
+        __attribute__((target("avx2"))) static inline __m256i lookup(const uint8_t (&table)[16], __m256i nibbles)
+        {
+            return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table))), nibbles);
+        }
+    };
+#endif
+
+    /**
+     * Shared block loop, inlined into every kernel so the classifier inlines too.
+     * State carried between blocks: whether the block starts escaped, inside a
+     * string or inside a number/literal.
+     */
+    template <typename Classifier, typename UTF8>
+    __attribute__((always_inline)) inline void indexBlocks(const char *data, size_t size, std::vector<uint32_t> &index)
+    {
+        constexpr uint64_t EVEN_BITS = 0x5555555555555555ULL;
+
+        UTF8 utf8(data, size);
+        uint64_t prevEscaped = 0;   // 1 if the first byte of the block is escaped
+        uint64_t prevInString = 0;  // all ones if the block starts inside a string
+        uint64_t prevScalar = 0;    // 1 if the previous byte belongs to a number/literal
+
+        index.clear();
+        index.resize(size / 4 + BLOCK_SIZE);
+        size_t count = 0;
+
+        for (size_t offset = 0; offset < size; offset += BLOCK_SIZE)
+        {
+            const char *block = data + offset;
+            char tail[BLOCK_SIZE]; // the last, partial block padded with spaces
+            BlockMasks m;
+            if (size - offset >= BLOCK_SIZE)
+                Classifier::classify(block, m);
+            else
+            {
+                classifyScalar(block, size - offset, m);
+                std::fill(std::copy(block, data + size, tail), tail + BLOCK_SIZE, ' ');
+                block = tail;
+            }
+
+            // UTF-8, pure ASCII blocks need no work
+            if (m.nonAscii)
+                utf8.check(offset, block);
+            else
+                utf8.ascii();
+
+            // Characters escaped by an odd run of backslashes
+            uint64_t backslash = m.backslash & ~prevEscaped;
+            uint64_t followsEscape = (backslash << 1) | prevEscaped;
+            uint64_t oddStarts = backslash & ~EVEN_BITS & ~followsEscape;
+            unsigned long long evenSequences;
+            prevEscaped = __builtin_uaddll_overflow(oddStarts, backslash, &evenSequences);
+            uint64_t escaped = (EVEN_BITS ^ (uint64_t(evenSequences) << 1)) & followsEscape;
+
+            // In-string mask covers the opening quote and the contents, not the closing quote
+            uint64_t quote = m.quote & ~escaped;
+            uint64_t inString = prefixXor(quote) ^ prevInString;
+            prevInString = uint64_t(int64_t(inString) >> 63);
+
+            uint64_t scalar = ~(m.structural | m.whitespace | inString | quote);
+            uint64_t scalarStart = scalar & ~((scalar << 1) | prevScalar);
+            prevScalar = scalar >> 63;
+
+            uint64_t tokens = (m.structural & ~inString) | (quote & inString) | scalarStart;
+            if (count + BLOCK_SIZE > index.size())
+                index.resize(std::max(index.size() * 2, count + BLOCK_SIZE));
+            uint32_t *out = index.data() + count;
+            count += __builtin_popcountll(tokens);
+            while (tokens)
+            {
+                *out++ = static_cast<uint32_t>(offset + __builtin_ctzll(tokens));
+                tokens &= tokens - 1;
+            }
+        }
+        utf8.finish();
+        index.resize(count);
+    }
+
+#ifdef JSON_STRUCTURAL_X86
+    void indexSSE2(const char *data, size_t size, std::vector<uint32_t> &index)
+    {
+        indexBlocks<SSE2Classifier, ScalarUTF8>(data, size, index);
+    }
+
+    __attribute__((target("ssse3"))) void indexSSSE3(const char *data, size_t size, std::vector<uint32_t> &index)
+    {
+        indexBlocks<SSE2Classifier, SSSE3UTF8>(data, size, index);
+    }
+
+    __attribute__((target("avx2"))) void indexAVX2(const char *data, size_t size, std::vector<uint32_t> &index)
+    {
+        indexBlocks<AVX2Classifier, AVX2UTF8>(data, size, index);
+    }
+#else
+    void indexScalar(const char *data, size_t size, std::vector<uint32_t> &index)
+    {
+        indexBlocks<ScalarClassifier, ScalarUTF8>(data, size, index);
+    }
+#endif
+
+    struct Kernel
+    {
+        void (*run)(const char *, size_t, std::vector<uint32_t> &);
+        const char *name;
+    };
+
+    const Kernel &selectKernel()
+    {
+        static const Kernel kernel = []
+        {
+#ifdef JSON_STRUCTURAL_X86
+            if (__builtin_cpu_supports("avx2"))
+                return Kernel{indexAVX2, "avx2"};
+            if (__builtin_cpu_supports("ssse3"))
+                return Kernel{indexSSSE3, "ssse3"};
+            return Kernel{indexSSE2, "sse2"};
+#else
+            return Kernel{indexScalar, "scalar"};
+#endif
+        }();
+        return kernel;
+    }
+}
+
+void buildStructuralIndex(const char *data, size_t size, std::vector<uint32_t> &index)
+{
+    selectKernel().run(data, size, index);
+}
+
+const char *structuralIndexKernel()
+{
+    return selectKernel().name;
+}
+
+size_t utf8SequenceLength(const char *p, const char *end)
+{
+    const unsigned char *s = reinterpret_cast<const unsigned char *>(p);
+    size_t available = end - p;
+    if (available == 0)
+        return 0;
+
+    unsigned char c = s[0];
+    if (c < 0x80)
+        return 1;
+
+    auto continuation = [&](size_t i)
+    { return i < available && (s[i] & 0xC0) == 0x80; };
+
+    if (c >= 0xC2 && c <= 0xDF)
+        return continuation(1) ? 2 : 0;
+
+    // the second byte range excludes overlong forms, surrogates and > U+10FFFF
+    unsigned char low = 0x80, high = 0xBF;
+    if (c >= 0xE0 && c <= 0xEF)
+    {
+        if (c == 0xE0)
+            low = 0xA0;
+        else if (c == 0xED)
+            high = 0x9F;
+        return available >= 3 && s[1] >= low && s[1] <= high && continuation(2) ? 3 : 0;
+    }
+    if (c >= 0xF0 && c <= 0xF4)
+    {
+        if (c == 0xF0)
+            low = 0x90;
+        else if (c == 0xF4)
+            high = 0x8F;
+        return available >= 4 && s[1] >= low && s[1] <= high && continuation(2) && continuation(3) ? 4 : 0;
+    }
+    return 0;
+}
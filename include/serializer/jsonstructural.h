@@ -0,0 +1,52 @@
+#ifndef _JSON_STRUCTURAL_H_
+#define _JSON_STRUCTURAL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file jsonstructural.h
+ * @brief Stage one of the two stage JSON parse: the structural index
+ *
+ * The input is classified 64 bytes at a time into bitmasks (quotes, backslashes,
+ * structural characters, whitespace). Escaped quotes are removed with the odd
+ * backslash sequence trick and a prefix xor over the quote mask gives the
+ * in-string mask, so string contents never produce tokens. UTF-8 is validated
+ * on the way, 16 or 32 bytes at a time with nibble lookup tables; blocks that
+ * are pure ASCII skip the check entirely.
+ *
+ * The resulting index holds the offset of every token start outside strings:
+ * structural characters ({ } [ ] : ,), opening quotes and the first byte of
+ * numbers and literals. Stage two (JSONParser) uses it to jump over whitespace.
+ *
+ * On x86-64 the kernel is picked once at runtime: AVX2 when the CPU has it,
+ * otherwise the SSE2 classifier with an SSSE3 UTF-8 check, or SSE2 alone (which
+ * every x86-64 CPU has) with a scalar one. Other targets use a scalar loop.
+ */
+
+/**
+ * @brief Builds the structural index of a JSON document
+ * @param data Start of the document
+ * @param size Document size in bytes, must fit in 32 bits
+ * @param index Receives the token offsets in increasing order (cleared first)
+ * @throws std::runtime_error on invalid UTF-8, with the byte offset of the error
+ */
+void buildStructuralIndex(const char *data, size_t size, std::vector<uint32_t> &index);
+
+/**
+ * @brief Name of the classifier selected for this CPU
+ * @return "avx2", "ssse3", "sse2" or "scalar"
+ */
+const char *structuralIndexKernel();
+
+/**
+ * @brief Length of the UTF-8 sequence starting at p
+ *
+ * Rejects overlong forms, surrogates and code points above U+10FFFF.
+ *
+ * @return Sequence length (1 to 4), or 0 if the bytes are not valid UTF-8
+ */
+size_t utf8SequenceLength(const char *p, const char *end);
+
+#endif
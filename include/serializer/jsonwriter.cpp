@@ -0,0 +1,335 @@
+#include "jsonwriter.h"
+#include "jsonparser.h"
+
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+JSONWriter::JSONWriter(std::string &out, int indent)
+    : d_out(out), d_stream(nullptr), d_indent(indent) {}
+
+JSONWriter::JSONWriter(std::ostream &out, int indent)
+    : d_out(d_buffer), d_stream(&out), d_indent(indent)
+{
+    d_buffer.reserve(FLUSH_THRESHOLD);
+}
+
+JSONWriter::~JSONWriter()
+{
+    // a stream that throws has already failed the caller's write, don't terminate while unwinding
+    try
+    {
+        flush();
+    }
+    catch (...)
+    {
+    }
+}
+
+void JSONWriter::flush()
+{
+    if (d_stream && !d_buffer.empty())
+    {
+        d_stream->write(d_buffer.data(), static_cast<std::streamsize>(d_buffer.size()));
+        d_buffer.clear();
+    }
+}
+
+void JSONWriter::newLine()
+{
+    if (d_indent <= 0)
+        return;
+    d_out += '\n';
+    d_out.append(d_scopes.size() * d_indent, ' ');
+}
+
+void JSONWriter::beforeValue()
+{
+    if (d_afterKey)
+    {
+        d_afterKey = false;
+        return;
+    }
+    if (d_scopes.empty())
+        return;
+
+    Scope &scope = d_scopes.back();
+    if (scope.isObject)
+        throw std::runtime_error("JSONWriter: object member needs a key before its value");
+    if (!scope.empty)
+        d_out += ',';
+    scope.empty = false;
+    newLine();
+}
+
+void JSONWriter::afterValue()
+{
+    if (d_stream && d_buffer.size() >= FLUSH_THRESHOLD)
+        flush();
+}
+
+void JSONWriter::open(char bracket, bool isObject)
+{
+    beforeValue();
+    d_out += bracket;
+    d_scopes.push_back(Scope{isObject, true});
+}
+
+void JSONWriter::close(char bracket, bool isObject)
+{
+    if (d_scopes.empty() || d_scopes.back().isObject != isObject)
+        throw std::runtime_error(isObject ? "JSONWriter: endObject without open object"
+                                          : "JSONWriter: endArray without open array");
+    if (d_afterKey)
+        throw std::runtime_error("JSONWriter: key without value");
+
+    bool empty = d_scopes.back().empty;
+    d_scopes.pop_back();
+    if (!empty)
+        newLine();
+    d_out += bracket;
+    afterValue();
+}
+
+JSONWriter &JSONWriter::beginObject()
+{
+    open('{', true);
+    return *this;
+}
+
+JSONWriter &JSONWriter::endObject()
+{
+    close('}', true);
+    return *this;
+}
+
+JSONWriter &JSONWriter::beginArray()
+{
+    open('[', false);
+    return *this;
+}
+
+JSONWriter &JSONWriter::endArray()
+{
+    close(']', false);
+    return *this;
+}
+
+JSONWriter &JSONWriter::key(std::string_view name)
+{
+    if (d_scopes.empty() || !d_scopes.back().isObject || d_afterKey)
+        throw std::runtime_error("JSONWriter: key is only allowed directly inside an object");
+
+    Scope &scope = d_scopes.back();
+    if (!scope.empty)
+        d_out += ',';
+    scope.empty = false;
+    newLine();
+    appendQuoted(d_out, name);
+    d_out += ':';
+    d_afterKey = true;
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(std::string_view value)
+{
+    beforeValue();
+    appendQuoted(d_out, value);
+    afterValue();
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(const char *value)
+{
+    return this->value(std::string_view(value));
+}
+
+JSONWriter &JSONWriter::value(const std::string &value)
+{
+    return this->value(std::string_view(value));
+}
+
+JSONWriter &JSONWriter::value(double value)
+{
+    // JSON has no NaN or infinity
+    if (!std::isfinite(value))
+        return this->value(nullptr);
+
+    // shortest text that parses back to the same double
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    beforeValue();
+    d_out.append(buffer, result.ptr - buffer);
+    afterValue();
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(int64_t value)
+{
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    beforeValue();
+    d_out.append(buffer, result.ptr - buffer);
+    afterValue();
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(uint64_t value)
+{
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    beforeValue();
+    d_out.append(buffer, result.ptr - buffer);
+    afterValue();
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(bool value)
+{
+    beforeValue();
+    d_out += value ? "true" : "false";
+    afterValue();
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(std::nullptr_t)
+{
+    beforeValue();
+    d_out += "null";
+    afterValue();
+    return *this;
+}
+
+namespace
+{
+    /// Checks text against the JSON number grammar
+    bool isNumber(std::string_view text)
+    {
+        size_t i = 0, n = text.size();
+        auto digits = [&]
+        {
+            size_t start = i;
+            while (i < n && text[i] >= '0' && text[i] <= '9')
+                i++;
+            return i > start;
+        };
+
+        if (i < n && text[i] == '-')
+            i++;
+        if (i < n && text[i] == '0')
+            i++;
+        else if (!digits())
+            return false;
+        if (i < n && text[i] == '.')
+        {
+            i++;
+            if (!digits())
+                return false;
+        }
+        if (i < n && (text[i] == 'e' || text[i] == 'E'))
+        {
+            i++;
+            if (i < n && (text[i] == '+' || text[i] == '-'))
+                i++;
+            if (!digits())
+                return false;
+        }
+        return i == n;
+    }
+}
+
+JSONWriter &JSONWriter::numberValue(std::string_view text)
+{
+    if (!isNumber(text))
+        return value(text);
+
+    beforeValue();
+    d_out.append(text.data(), text.size());
+    afterValue();
+    return *this;
+}
+
+JSONWriter &JSONWriter::write(const JSONNode &node)
+{
+    switch (node.d_type)
+    {
+    case JSONType::BOOL:
+        return value(node.d_bool);
+
+    case JSONType::NULLT:
+        return value(nullptr);
+
+    case JSONType::NUMBER:
+        if (node.d_flags & JSONNode::INTEGER_NUMBER)
+            return value(node.d_integer);
+        return value(node.d_number);
+
+    case JSONType::STRING:
+        return value(node.stringView());
+
+    case JSONType::ARRAY:
+        beginArray();
+        for (const auto &element : node.arrayStorage())
+        {
+            write(element);
+        }
+        return endArray();
+
+    case JSONType::OBJECT:
+        beginObject();
+        for (const auto &member : node.objectStorage().members)
+        {
+            key(member.key.stringView());
+            write(member.value);
+        }
+        return endObject();
+    }
+    return *this;
+}
+
+void JSONWriter::appendQuoted(std::string &out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    const char *run = s.data();
+    const char *end = s.data() + s.size();
+    for (const char *p = run; p < end; p++)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        out.append(run, p - run);
+        run = p + 1;
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xF];
+        }
+    }
+    out.append(run, end - run);
+    out += '"';
+}
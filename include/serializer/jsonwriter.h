@@ -0,0 +1,139 @@
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+class JSONNode;
+
+/**
+ * @class JSONWriter
+ * @brief Streaming JSON writer with a SAX style API
+ *
+ * Text is appended straight into the sink, no temporary string is built per
+ * node. With a std::ostream sink the output is staged in a small buffer that
+ * is flushed whenever it fills up, by flush() and on destruction.
+ *
+ * @example
+ * std::string out;
+ * JSONWriter writer(out);
+ * writer.beginObject();
+ * writer.key("id").value(42);
+ * writer.key("tags").beginArray().value("a").value("b").endArray();
+ * writer.endObject();
+ *
+ * JSONWriter(std::cout, 4).write(node);   // pretty printed
+ */
+class JSONWriter
+{
+    /// Open object or array
+    struct Scope
+    {
+        bool isObject; ///< Object or array
+        bool empty;    ///< Nothing written in it yet
+    };
+
+    std::string d_buffer;    ///< Staging buffer for stream sinks
+    std::string &d_out;      ///< Where text is appended (d_buffer for stream sinks)
+    std::ostream *d_stream;  ///< Stream sink, nullptr when writing into a string
+    int d_indent;            ///< Spaces per level, 0 writes compact JSON
+    bool d_afterKey = false; ///< A key was written, its value is next
+    std::vector<Scope> d_scopes;
+
+    /// Staged bytes before a stream sink is written to
+    static constexpr size_t FLUSH_THRESHOLD = 16 * 1024;
+
+    void newLine();
+    void beforeValue();
+    void afterValue();
+    void open(char bracket, bool isObject);
+    void close(char bracket, bool isObject);
+
+public:
+    /**
+     * @brief Writer appending to a string
+     * @param out Destination, existing content is kept
+     * @param indent Spaces per nesting level, 0 for compact output
+     */
+    explicit JSONWriter(std::string &out, int indent = 0);
+
+    /**
+     * @brief Writer streaming to an output stream
+     * @param out Destination stream
+     * @param indent Spaces per nesting level, 0 for compact output
+     */
+    explicit JSONWriter(std::ostream &out, int indent = 0);
+
+    JSONWriter(const JSONWriter &) = delete;
+    JSONWriter &operator=(const JSONWriter &) = delete;
+
+    ~JSONWriter();
+
+    /// @throws std::runtime_error if a value is not allowed here
+    JSONWriter &beginObject();
+
+    /// @throws std::runtime_error if no object is open or a key has no value
+    JSONWriter &endObject();
+
+    /// @throws std::runtime_error if a value is not allowed here
+    JSONWriter &beginArray();
+
+    /// @throws std::runtime_error if no array is open
+    JSONWriter &endArray();
+
+    /**
+     * @brief Writes an object member name, the next call writes its value
+     * @throws std::runtime_error if not directly inside an object
+     */
+    JSONWriter &key(std::string_view name);
+
+    JSONWriter &value(std::string_view value);
+    JSONWriter &value(const char *value);
+    JSONWriter &value(const std::string &value);
+    /// Shortest round-trip form, NaN and infinity are written as null
+    JSONWriter &value(double value);
+    JSONWriter &value(int64_t value);
+    JSONWriter &value(uint64_t value);
+    JSONWriter &value(bool value);
+    JSONWriter &value(std::nullptr_t);
+
+    /// Any other integer type (int, unsigned, size_t, ...)
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    JSONWriter &value(T value)
+    {
+        if constexpr (std::is_signed_v<T>)
+            return this->value(static_cast<int64_t>(value));
+        else
+            return this->value(static_cast<uint64_t>(value));
+    }
+
+    /**
+     * @brief Writes a number given as text (e.g. a numeric SQL column) as is
+     *
+     * Text that is not a valid JSON number is written as a string instead.
+     */
+    JSONWriter &numberValue(std::string_view text);
+
+    /**
+     * @brief Writes a whole node tree as one value
+     */
+    JSONWriter &write(const JSONNode &node);
+
+    /**
+     * @brief Passes staged output to the stream sink (no-op for string sinks)
+     */
+    void flush();
+
+    /**
+     * @brief Appends s to out as a quoted JSON string, escaping quotes,
+     *        backslashes and control characters.
+     */
+    static void appendQuoted(std::string &out, std::string_view s);
+};
+
+#endif